@@ -0,0 +1,131 @@
+/** @file
+ *  Implementation of the BarDisplay classes. This file contains the
+ *  implementation of the classes that share one LED bar between several
+ *  state machines.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// Shared bars are only used by Regions, which the tiny profile leaves out
+#if !defined(USE_TINY_PROFILE)
+
+#include "BarDisplay.h"
+
+/* ------------------------------------------------------------------------
+ *  CompositeDisplay
+ */
+
+void CompositeDisplay::set(uint8_t first, uint8_t count, const uint8_t *leds)
+{
+    if (first >= BarDisplay::segments) {
+        return;
+    }
+
+    if (count > BarDisplay::segments - first) {
+        count = BarDisplay::segments - first;
+    }
+
+    // Only mark the frame as needing a redraw if something actually changed
+    if (memcmp(&frame[first], leds, count)) {
+        memcpy(&frame[first], leds, count);
+        dirty = true;
+    }
+}
+
+
+void CompositeDisplay::flush()
+{
+    if (dirty) {
+        output.setLeds(frame);
+        dirty = false;
+    }
+}
+
+
+/* ------------------------------------------------------------------------
+ *  SegmentDisplay
+ */
+
+SegmentDisplay::SegmentDisplay(CompositeDisplay &composite, uint8_t first, uint8_t count) :
+    composite(composite), first(first), count(count)
+{
+    // Keep the segment on the bar, as the drawing buffers are only as long
+    // as the bar
+    if (this -> first > BarDisplay::segments) {
+        this -> first = BarDisplay::segments;
+    }
+
+    if (this -> count > BarDisplay::segments - this -> first) {
+        this -> count = BarDisplay::segments - this -> first;
+    }
+}
+
+
+void SegmentDisplay::setLevel(float level)
+{
+    uint8_t leds[BarDisplay::segments];
+
+    // Scale the full bar level down to the size of the segment
+    float scaled = (level * count) / BarDisplay::segments;
+
+    for (uint8_t led = 0; led < count; ++led) {
+        if (scaled >= led + 1) {
+            leds[led] = 0xff;
+        } else if (scaled > led) {
+            leds[led] = (uint8_t)((scaled - led) * 0xff);
+        } else {
+            leds[led] = 0;
+        }
+    }
+
+    composite.set(first, count, leds);
+}
+
+
+void SegmentDisplay::setLeds(uint8_t *leds)
+{
+    uint8_t scaled[BarDisplay::segments];
+
+    // Each LED in the segment shows the brightest of the LEDs it covers
+    for (uint8_t led = 0; led < count; ++led) {
+        uint8_t start = (led * BarDisplay::segments) / count;
+        uint8_t end   = ((led + 1) * BarDisplay::segments) / count;
+
+        scaled[led] = 0;
+        for (uint8_t source = start; source < end; ++source) {
+            if (leds[source] > scaled[led]) {
+                scaled[led] = leds[source];
+            }
+        }
+    }
+
+    composite.set(first, count, scaled);
+}
+
+#endif
@@ -0,0 +1,171 @@
+/** @file
+ *  Definition of the BarDisplay classes. This file contains the definition
+ *  of the interface states use to draw on the LED bar, and of the classes
+ *  that share one bar between several state machines. The displays that
+ *  drive a bar are in GroveBarDisplay.h and MY9221Display.h.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef BarDisplay_H
+#define BarDisplay_H
+
+#include <Arduino.h>
+#include "Profile.h"
+#include "Snapshot.h"
+
+/** The interface states use to draw on the LED bar. This provides the same
+ *  functions as the Grove_LED_Bar class the states used to talk to directly,
+ *  so that a display may be backed either by a real bar, or by a segment of
+ *  a bar shared with other state machines. Levels are always given in terms
+ *  of a full bar of `segments` segments, and implementations scale them as
+ *  needed. The segment count is fixed at compile time so that everything
+ *  sized or scaled by it is worked out by the compiler; to use a different
+ *  bar, change `segments` here to match it.
+ */
+class BarDisplay
+{
+public:
+    static const uint8_t segments = 10; //!< The number of segments in a full bar
+    static const uint8_t steps    = 8;  //!< The number of steps each segment is split into by setSteps()
+
+    /** Light the bar up to the specified level.
+     *
+     * @param level The level to show, from 0 (all off) to `segments` (all on).
+     */
+    virtual void setLevel(float level) = 0;
+
+
+    /** Light the bar up to a level given in steps of a segment, so that
+     *  callers can draw partly lit segments without floating point. By
+     *  default the level is drawn with setLevel(); displays that work in
+     *  steps themselves draw it directly.
+     *
+     * @param level The level to show, from 0 (all off) to `segments * steps`
+     *              (all on).
+     */
+    virtual void setSteps(uint16_t level) {
+        setLevel((float)level / steps);
+    }
+
+
+    /** Set the brightness of every segment in the bar in one go.
+     *
+     * @param leds An array of `segments` brightness values, 0 is off and
+     *             0xff is full brightness.
+     */
+    virtual void setLeds(uint8_t *leds) = 0;
+
+#if !defined(USE_TINY_PROFILE)
+    /** Save or restore any runtime context the display keeps. Most displays
+     *  keep none.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    virtual void snapshot(Snapshot &snapshot) {
+        (void)snapshot;
+    }
+#endif
+};
+
+
+/** A frame shared by several SegmentDisplays. Each segment draws into its
+ *  own part of the frame, and the whole frame is sent to the output display
+ *  in one go when flush() is called, so that however many segments change
+ *  in an update, the bar is only written once.
+ */
+class CompositeDisplay
+{
+public:
+    /** Create a new CompositeDisplay object.
+     *
+     * @param output The display the composited frame is drawn on.
+     * @return A new CompositeDisplay object.
+     */
+    CompositeDisplay(BarDisplay &output) : output(output), dirty(true)
+        { memset(frame, 0, sizeof(frame)); }
+
+
+    /** Set the brightness of a range of segments in the frame.
+     *
+     * @param first The first segment to set.
+     * @param count The number of segments to set.
+     * @param leds  An array of `count` brightness values.
+     */
+    void set(uint8_t first, uint8_t count, const uint8_t *leds);
+
+
+    /** Send the frame to the output display, if it has changed since the
+     *  last flush.
+     */
+    void flush();
+
+
+    /** Save or restore the frame, and whether it needs to be sent.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot) {
+        snapshot.field(dirty);
+        snapshot.field(frame);
+    }
+
+private:
+    BarDisplay &output;                     //!< The display the frame is drawn on
+    bool dirty;                             //!< Has the frame changed since the last flush?
+    uint8_t frame[BarDisplay::segments];    //!< The brightness of each segment
+};
+
+
+/** A display that draws on a range of segments of a shared bar. Levels and
+ *  LED patterns for a full bar are scaled down to fit in the segment.
+ */
+class SegmentDisplay : public BarDisplay
+{
+public:
+    /** Create a new SegmentDisplay object.
+     *
+     * @param composite The composite frame this segment draws into.
+     * @param first     The first segment of the shared bar to use.
+     * @param count     The number of segments of the shared bar to use. If
+     *                  the segment would run past the end of the bar, it is
+     *                  cut short.
+     * @return A new SegmentDisplay object.
+     */
+    SegmentDisplay(CompositeDisplay &composite, uint8_t first, uint8_t count);
+
+    void setLevel(float level);
+
+    void setLeds(uint8_t *leds);
+
+private:
+    CompositeDisplay &composite; //!< The composite frame this segment draws into
+    uint8_t first;               //!< The first segment of the shared bar to use
+    uint8_t count;               //!< The number of segments of the shared bar to use
+};
+
+#endif
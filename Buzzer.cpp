@@ -0,0 +1,190 @@
+/** @file
+ *  Implementation of the Buzzer class. This file contains the
+ *  implementation of the class used to play alert melodies on a piezo buzzer.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no buzzer
+#if !defined(USE_TINY_PROFILE)
+
+#include "Buzzer.h"
+#include <avr/pgmspace.h>
+
+// The notes are up around G6 and C7, where small piezo buzzers are loudest.
+static const Buzzer::Note finished_melody[] PROGMEM = {
+    { 1568, 150 }, { 0, 50 }, { 2093, 150 }, { 0, 50 },
+    { 1568, 150 }, { 0, 50 }, { 2093, 400 }
+};
+
+// Timer1 counts at F_CPU / 8, and the pin toggles on each compare match.
+// Silences are counted out in 25ms compare periods, to keep the interrupt
+// rate down during long gaps between repeats.
+static const uint32_t timer_rate = F_CPU / 8;
+static const millis_t silence_period = 25;
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+
+// The buzzer compare matches should be passed to, set by play()
+static Buzzer *compare_buzzer = NULL;
+
+ISR(TIMER1_COMPA_vect)
+{
+    if (compare_buzzer) {
+        compare_buzzer -> advance();
+    }
+}
+#endif
+
+
+void Buzzer::setup()
+{
+    pinMode(buzzer_pin, OUTPUT);
+    digitalWrite(buzzer_pin, LOW);
+}
+
+
+void Buzzer::play(Melody melody, uint8_t repeats, millis_t repeat_gap)
+{
+    stop();
+
+    switch (melody) {
+        case MELODY_FINISHED:
+            notes  = finished_melody;
+            length = sizeof(finished_melody) / sizeof(Note);
+            break;
+    }
+
+    position = 0;
+    this -> repeats    = repeats;
+    this -> repeat_gap = repeat_gap;
+    playing = true;
+
+#if defined(__AVR__)
+    compare_buzzer = this;
+
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS11);
+    next_note();
+    TIMSK1 |= _BV(OCIE1A);
+#endif
+}
+
+
+void Buzzer::stop()
+{
+#if defined(__AVR__)
+    // Stop the timer and disconnect the pin, which is left driven low
+    TIMSK1 &= ~_BV(OCIE1A);
+    TCCR1A  = 0;
+    TCCR1B  = 0;
+#endif
+    playing = false;
+}
+
+
+void Buzzer::advance()
+{
+    if (--remaining) {
+        return;
+    }
+
+    next_note();
+}
+
+
+void Buzzer::next_note()
+{
+    // At the end of the melody, either wait to repeat it or stop
+    if (position == length) {
+        if (!repeats) {
+            stop();
+            return;
+        }
+
+        --repeats;
+        position = 0;
+        start_tone(0, repeat_gap);
+        return;
+    }
+
+    uint16_t frequency = pgm_read_word(&notes[position].frequency);
+    uint16_t duration  = pgm_read_word(&notes[position].duration);
+    ++position;
+
+    start_tone(frequency, duration);
+}
+
+
+void Buzzer::start_tone(uint16_t frequency, millis_t duration)
+{
+    uint16_t period;
+
+    if (frequency) {
+        // Two toggles per cycle of the tone
+        period    = timer_rate / 2 / frequency;
+        remaining = (uint32_t)frequency * duration / 500;
+    } else {
+        period    = timer_rate / 1000 * silence_period;
+        remaining = duration / silence_period;
+    }
+
+    if (!remaining) {
+        remaining = 1;
+    }
+
+#if defined(__AVR__)
+    if (frequency) {
+        TCCR1A = _BV(COM1A0);
+    } else {
+        TCCR1A = 0;
+    }
+    OCR1A = period - 1;
+    TCNT1 = 0;
+#else
+    (void)period;
+#endif
+}
+
+
+void Buzzer::snapshot(Snapshot &snapshot)
+{
+    noInterrupts();
+    snapshot.field(notes);
+    snapshot.field(length);
+    snapshot.field(position);
+    snapshot.field(repeats);
+    snapshot.field(repeat_gap);
+    snapshot.field(remaining);
+    snapshot.field(playing);
+    interrupts();
+}
+
+#endif
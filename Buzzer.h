@@ -0,0 +1,153 @@
+/** @file
+ *  Definition of the Buzzer class. This file contains the definition
+ *  of the class used to play alert melodies on a piezo buzzer.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Buzzer_H
+#define Buzzer_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "Snapshot.h"
+
+/** A class to play melodies on a piezo buzzer without blocking the main
+ *  loop. Timer1 runs in CTC mode with output compare A toggling the buzzer
+ *  pin, so each note is a hardware generated square wave. The compare
+ *  interrupt counts down the length of the note, and moves on to the next
+ *  note in the melody (held in program memory) when it runs out. A melody
+ *  can be repeated a number of times, with a silent gap between repeats.
+ *
+ * @note The buzzer must be on OC1A, which is digital pin 9 on an Uno. This
+ *       takes over Timer1, so it can't be used with the Servo library.
+ *
+ * @note On non-AVR (host) builds no sound is made, and nothing ever finishes
+ *       playing until it is stopped.
+ */
+class Buzzer
+{
+public:
+    /** A single note in a melody, as stored in program memory.
+     */
+    struct Note {
+        uint16_t frequency;       //!< The note frequency in Hz, or 0 for a rest
+        uint16_t duration;        //!< How long the note lasts, in milliseconds
+    };
+
+    /** The melodies that can be played.
+     */
+    enum Melody {
+        MELODY_FINISHED,          //!< A rising chime to say the cycle has finished.
+    };
+
+    /** Create a new Buzzer object.
+     *
+     * @param buzzer_pin The digital pin the buzzer is connected to. This must
+     *                   be the pin for OC1A.
+     * @return A new Buzzer object.
+     */
+    Buzzer(uint8_t buzzer_pin) :
+        buzzer_pin(buzzer_pin), notes(NULL), length(0), position(0),
+        repeats(0), repeat_gap(0), remaining(0), playing(false)
+        { /* fnord */ }
+
+
+    /** Set up the buzzer pin, and make sure it's quiet. This should be
+     *  called once from the global setup() function.
+     */
+    void setup();
+
+
+    /** Start playing a melody, replacing anything already playing.
+     *
+     * @param melody     The melody to play.
+     * @param repeats    How many more times to play the melody after the
+     *                   first time.
+     * @param repeat_gap How long to wait between repeats, in milliseconds.
+     */
+    void play(Melody melody, uint8_t repeats = 0, millis_t repeat_gap = 0);
+
+
+    /** Stop playing, and silence the buzzer. This is safe to call when
+     *  nothing is playing.
+     */
+    void stop();
+
+
+    /** Is a melody playing? This includes the gaps between repeats.
+     *
+     * @return true if a melody is playing, false if not.
+     */
+    bool is_playing()
+    {
+        return playing;
+    }
+
+
+    /** Count down the current note by one compare match, and move on to the
+     *  next note when it is over. This is called from the compare interrupt
+     *  on AVR builds, and must be kept short.
+     */
+    void advance();
+
+
+    /** Save or restore the melody being played and how far it has got. The
+     *  timer registers aren't included, as they belong to the board.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    /** Start the next note, the gap before a repeat, or stop if the melody
+     *  is over.
+     */
+    void next_note();
+
+
+    /** Set the timer up to make a tone, or to count out a silence.
+     *
+     * @param frequency The frequency of the tone in Hz, or 0 for silence.
+     * @param duration  How long the tone or silence lasts, in milliseconds.
+     */
+    void start_tone(uint16_t frequency, millis_t duration);
+
+    uint8_t buzzer_pin;           //!< The digital pin the buzzer is connected to
+
+    // The melody being played, set up by play() before the interrupt is enabled
+    const Note *notes;            //!< The notes of the melody in program memory
+    uint8_t length;               //!< How many notes there are in the melody
+    uint8_t position;             //!< The next note to play
+    uint8_t repeats;              //!< How many repeats are still to be played
+    millis_t repeat_gap;          //!< How long to wait between repeats, in milliseconds
+
+    uint32_t remaining;           //!< Compare matches left before the current note ends
+    volatile bool playing;        //!< Is a melody playing?
+};
+
+#endif
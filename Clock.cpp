@@ -0,0 +1,132 @@
+/** @file
+ *  Implementation of the Clock class. This file contains the implementation
+ *  of the calibrated timebase used for the long intervals the timer deals with.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Clock.h"
+#include "EepromWriter.h"
+
+int                Clock::eeprom_address = 0;
+Clock::Calibration Clock::calibration    = { 0, 0 };
+millis_t           Clock::last_raw       = 0;
+millis_t           Clock::corrected      = 0;
+int32_t            Clock::error          = 0;
+bool               Clock::synced         = false;
+millis_t           Clock::sync_raw       = 0;
+uint32_t           Clock::sync_reference = 0;
+
+
+void Clock::setup(int address)
+{
+    eeprom_address = address;
+    bool valid = EepromWriter::get(eeprom_address, calibration);
+
+    // Anything implausible is treated as uncalibrated
+    if (!valid || calibration.magic != calibration_magic || calibration.ppm > max_ppm || calibration.ppm < -max_ppm) {
+        calibration.magic = calibration_magic;
+        calibration.ppm   = 0;
+    }
+
+    last_raw  = ::millis();
+    corrected = last_raw;
+}
+
+
+millis_t Clock::millis()
+{
+    millis_t now   = ::millis();
+    millis_t delta = now - last_raw;
+    last_raw = now;
+
+    // Apply the correction in steps small enough that delta * ppm can't
+    // overflow. Normally there's only one step, as this is called often.
+    while (delta) {
+        millis_t step = (delta > max_step) ? max_step : delta;
+        delta -= step;
+
+        error += (int32_t)step * calibration.ppm;
+        int32_t whole = error / million;
+        error -= whole * million;
+
+        corrected += step + whole;
+    }
+
+    return corrected;
+}
+
+
+void Clock::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(last_raw);
+    snapshot.field(corrected);
+    snapshot.field(error);
+    snapshot.field(calibration);
+    snapshot.field(synced);
+    snapshot.field(sync_raw);
+    snapshot.field(sync_reference);
+}
+
+
+bool Clock::sync(uint32_t reference)
+{
+    millis_t now = ::millis();
+
+    if (!synced) {
+        synced = true;
+        sync_raw = now;
+        sync_reference = reference;
+        return false;
+    }
+
+    uint32_t span = reference - sync_reference;
+    if (span < min_sync_span) {
+        return false;
+    }
+
+    // ppm = (reference elapsed - local elapsed) * 10^6 / local elapsed; the
+    // product needs 64 bits, but this only happens once per sync.
+    int64_t local = (int64_t)(millis_t)(now - sync_raw);
+
+    // millis() wraps every 2^32ms (about 49.7 days), and units are synced
+    // for longer than that. The reference span says how many whole wraps
+    // there must have been, as the oscillator is never out by the 50% it
+    // would take to be ambiguous.
+    local += (((int64_t)span * 1000 - local + (1LL << 31)) >> 32) << 32;
+
+    int64_t ppm   = (((int64_t)span * 1000 - local) * million) / local;
+
+    if (ppm > max_ppm || ppm < -max_ppm) {
+        return false;
+    }
+
+    calibration.ppm = (int32_t)ppm;
+    EepromWriter::put(eeprom_address, calibration);
+
+    return true;
+}
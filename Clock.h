@@ -0,0 +1,136 @@
+/** @file
+ *  Definition of the Clock class. This file contains the definition of a
+ *  calibrated timebase used for the long intervals the timer deals with.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Clock_H
+#define Clock_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "Snapshot.h"
+
+/** A calibrated replacement for millis(). The millis() count comes from the
+ *  board's oscillator, and boards using a ceramic resonator rather than a
+ *  crystal can be out by several minutes over a long cycle. This class keeps
+ *  a corrected count of milliseconds by applying a correction factor, in
+ *  parts per million, to the time that passes between calls, using integer
+ *  maths only.
+ *
+ *  The correction is measured by comparing millis() against a reference
+ *  time sent by a host over the serial console: the first sync sets the
+ *  starting point, and each later sync at least `min_sync_span` seconds
+ *  afterwards recalculates the correction over the whole span, so it gets
+ *  more accurate the longer the host keeps syncing. The correction is kept
+ *  in EEPROM so it only needs to be measured once per board.
+ *
+ * @note The boards this is used on run the MCU from the pins an external
+ *       32kHz crystal would need, so only serial sync is supported as a
+ *       reference.
+ *
+ * @note The corrected count is updated when millis() is called, so it must
+ *       only be used from the main loop, not from interrupts.
+ */
+class Clock
+{
+public:
+    /** Load the correction factor from EEPROM. This should be called once
+     *  from the global setup() function, before anything uses millis().
+     *
+     * @param eeprom_address The EEPROM address the correction is stored at.
+     *                       This needs sizeof(Clock::Calibration) +
+     *                       EepromWriter::overhead bytes.
+     */
+    static void setup(int eeprom_address);
+
+
+    /** Obtain the number of corrected milliseconds since the clock started.
+     *  Like the Arduino millis(), this wraps around after about 49 days, so
+     *  intervals should be calculated by subtraction.
+     *
+     * @return The corrected time in milliseconds.
+     */
+    static millis_t millis();
+
+
+    /** Synchronise the clock with a reference time. The reference can have
+     *  any starting point, as only differences between syncs are used.
+     *
+     * @param reference The reference time, in seconds.
+     * @return `true` if the correction was recalculated, `false` if this was
+     *         the first sync, or not long enough since the first sync.
+     */
+    static bool sync(uint32_t reference);
+
+
+    /** Save or restore the corrected count, the calibration in use and any
+     *  sync in progress. Restoring only makes sense if millis() has been
+     *  set back to what it was when the snapshot was saved, as it can be in
+     *  a simulation.
+     *
+     * @param snapshot The snapshot to save the count to or restore it from.
+     */
+    static void snapshot(Snapshot &snapshot);
+
+
+    /** Obtain the correction factor currently in use.
+     *
+     * @return The correction, in parts per million. Positive values mean
+     *         the board's oscillator is running slow.
+     */
+    static int32_t correction() {
+        return calibration.ppm;
+    }
+
+
+    /** The calibration stored in EEPROM.
+     */
+    struct Calibration {
+        uint8_t magic; //!< Set to calibration_magic when the calibration is valid
+        int32_t ppm;   //!< The correction, in parts per million
+    };
+
+private:
+    static const uint8_t       calibration_magic = 0x7c;    //!< Marker indicating the calibration is valid
+    static const uint32_t      min_sync_span     = 3600;    //!< Shortest span of syncs to calibrate over, in seconds
+    static const int32_t       max_ppm           = 20000;   //!< The largest plausible correction
+    static const millis_t      max_step          = 50000;   //!< Largest time step corrected at once, so products fit in 32 bits
+    static const int32_t       million           = 1000000L;
+
+    static int eeprom_address;        //!< The address of the calibration in EEPROM
+    static Calibration calibration;   //!< The calibration in use
+    static millis_t last_raw;         //!< The uncorrected millis() at the last update
+    static millis_t corrected;        //!< The corrected millis
+    static int32_t error;             //!< Accumulated correction not yet applied, in millionths of a millisecond
+    static bool synced;               //!< Has the first sync been seen?
+    static millis_t sync_raw;         //!< The uncorrected millis() at the first sync
+    static uint32_t sync_reference;   //!< The reference time at the first sync, in seconds
+};
+
+#endif
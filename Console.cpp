@@ -0,0 +1,284 @@
+/** @file
+ *  Implementation of the Console class. This file contains the implementation
+ *  of the class that handles commands sent to the controller over serial.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no console
+#if !defined(USE_TINY_PROFILE)
+
+#include <limits.h>
+#include "Console.h"
+#include "Clock.h"
+
+void Console::setup()
+{
+    Serial.begin(baud);
+}
+
+
+void Console::update()
+{
+    // Commands wait while a reply is being sent, so replies don't get mixed up
+    while (!report && Serial.available()) {
+        char next = Serial.read();
+
+        if (next == '\r' || next == '\n') {
+            if (length) {
+                line[length] = '\0';
+
+                // strtoul() saturates at the largest unsigned long, which is
+                // 32 bits on AVR; saturate there on hosts with a wider long
+                unsigned long value = strtoul(&line[1], NULL, 10);
+#if ULONG_MAX > 0xffffffffUL
+                if (value > 0xffffffffUL) {
+                    value = 0xffffffffUL;
+                }
+#endif
+                run(line[0], value);
+                length = 0;
+            }
+
+        // Overlong lines are dropped rather than run truncated
+        } else if (length < max_line - 1) {
+            line[length++] = next;
+        } else {
+            length = 0;
+        }
+    }
+
+    if (report) {
+        send_report();
+    }
+
+    if (trace && !report) {
+        send_trace();
+    }
+}
+
+
+void Console::run(char command, uint32_t value)
+{
+    switch (command) {
+        case 'S':
+            Clock::sync(value);
+            // fall through - the correction is reported as well
+        case 'C':
+            Serial.print('C');
+            Serial.println((long)Clock::correction());
+            break;
+
+        case 'T':
+            if (!scheduler) {
+                Serial.println("?");
+                break;
+            }
+            // fall through - the reply is sent like the others
+        case 'H':
+        case 'M':
+            report = command;
+            piece  = 0;
+            break;
+
+        case 'X':
+            if (trace) {
+                trace -> set_enabled(value != 0);
+            } else {
+                Serial.println("?");
+            }
+            break;
+
+        default:
+            Serial.println("?");
+    }
+}
+
+
+void Console::send_report()
+{
+    while (Serial.availableForWrite() >= max_piece) {
+        bool sent = false;
+
+        switch (report) {
+            case 'H': sent = send_health(piece);  break;
+            case 'M': sent = send_metrics(piece); break;
+            case 'T': sent = send_tasks(piece);   break;
+        }
+
+        if (!sent) {
+            report = 0;
+            return;
+        }
+        ++piece;
+    }
+}
+
+
+bool Console::send_health(uint8_t piece)
+{
+    const SwitchControl::Health &health = button.get_health();
+
+    // The first counter follows the H without a space
+    if (piece == 0) {
+        Serial.print('H');
+        Serial.print(health.presses);
+        return true;
+    }
+    --piece;
+
+    const uint16_t totals[] = { health.longpresses, health.glitches, health.bounces, health.worst_bounces };
+    if (piece < sizeof(totals) / sizeof(totals[0])) {
+        Serial.print(' ');
+        Serial.print(totals[piece]);
+        return true;
+    }
+    piece -= sizeof(totals) / sizeof(totals[0]);
+
+    if (piece < SwitchControl::health_buckets) {
+        Serial.print(' ');
+        Serial.print(health.bounce_time[piece]);
+        return true;
+    }
+    piece -= SwitchControl::health_buckets;
+
+    // The hold times end the line. The line's name was the first piece.
+    ++piece;
+    return send_line("", -1, health.hold_time, SwitchControl::health_buckets, piece);
+}
+
+
+bool Console::send_metrics(uint8_t piece)
+{
+    const Machine::Metrics &metrics = fsm.get_metrics();
+
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        if (send_line("MT", state, metrics.transitions[state], State::STATE_MAX, piece)) {
+            return true;
+        }
+    }
+
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        if (send_line("MD", state, metrics.dwell[state], Machine::dwell_buckets, piece)) {
+            return true;
+        }
+    }
+
+    return send_line("MR", -1, metrics.rejected, State::STATE_MAX, piece) ||
+           send_line("ML", -1, &metrics.limited, 1, piece) ||
+           send_line("MW", -1, fsm.get_worst_update(), State::STATE_MAX, piece);
+}
+
+
+bool Console::send_tasks(uint8_t piece)
+{
+    for (uint8_t task = 0; task < scheduler -> get_task_count(); ++task) {
+        const Scheduler::Stats &stats = scheduler -> get_stats(task);
+        const uint16_t counters[] = { stats.overruns, stats.deferred, stats.worst };
+
+        if (send_line("T", task, counters, sizeof(counters) / sizeof(counters[0]), piece)) {
+            return true;
+        }
+    }
+
+    const uint16_t ticks[] = { scheduler -> get_late_ticks(), scheduler -> get_worst_tick() };
+    if (send_line("TT", -1, ticks, sizeof(ticks) / sizeof(ticks[0]), piece)) {
+        return true;
+    }
+
+    // The boot time is too big for a counter, but fits in one piece
+    if (boot_time && piece == 0) {
+        Serial.print("TB ");
+        Serial.println(*boot_time);
+        return true;
+    }
+
+    return false;
+}
+
+
+void Console::send_trace()
+{
+    // The longest line is "X4294967295 3 255\r\n"
+    static const int max_trace_line = 19;
+
+    // The dropped count goes out first, as one more line, but only when
+    // there's room for it; until then the trace carries on counting
+    if (Serial.availableForWrite() >= max_trace_line) {
+        uint16_t dropped = trace -> take_dropped();
+        if (dropped) {
+            Serial.print("XD");
+            Serial.println(dropped);
+        }
+    }
+
+    Trace::Record record;
+    while (Serial.availableForWrite() >= max_trace_line && trace -> take(record)) {
+        Serial.print('X');
+        Serial.print(record.time);
+        Serial.print(' ');
+        Serial.print(record.kind);
+        Serial.print(' ');
+        Serial.println(record.value);
+    }
+}
+
+
+bool Console::send_line(const char *name, int8_t number, const uint16_t *counters, uint8_t count, uint8_t &piece)
+{
+    if (piece > count + 1) {
+        piece -= count + 2;
+        return false;
+    }
+
+    if (piece == 0) {
+        Serial.print(name);
+        if (number >= 0) {
+            Serial.print(number);
+        }
+    } else if (piece <= count) {
+        Serial.print(' ');
+        Serial.print(counters[piece - 1]);
+    } else {
+        Serial.println();
+    }
+
+    return true;
+}
+
+
+void Console::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(line);
+    snapshot.field(length);
+    snapshot.field(report);
+    snapshot.field(piece);
+}
+
+#endif
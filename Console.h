@@ -0,0 +1,198 @@
+/** @file
+ *  Definition of the Console class. This file contains the definition of
+ *  the class that handles commands sent to the controller over serial.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Console_H
+#define Console_H
+
+#include <Arduino.h>
+#include "SwitchControl.h"
+#include "FSM.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "Snapshot.h"
+
+/** A class to handle simple commands sent over the serial port. Commands
+ *  are single lines, starting with a letter that selects the command,
+ *  optionally followed by a number. Characters are read as they arrive
+ *  without blocking, and each complete line is acted on when its newline
+ *  is seen. The supported commands are:
+ *
+ *  - `S<seconds>` synchronises the calibrated clock with a reference time,
+ *    and replies with `C<ppm>`, the correction currently in use.
+ *  - `C` replies with `C<ppm>`, the correction currently in use.
+ *  - `H` replies with the switch health counters, as `H` followed by the
+ *    presses, long presses, glitches, bounces, worst bounce count, the
+ *    bounce time histogram and the hold time histogram, separated by spaces.
+ *  - `M` replies with the state machine metrics, as one `MT<from> ...` line
+ *    per state giving the transition counts to every state, one `MD<state> ...`
+ *    line per state giving the dwell time histogram, an `MR ...` line giving
+ *    the rejected transition counts for every state, and an `ML ...` line
+ *    giving how often a chain of transitions hit the limit. As all of these
+ *    are plain counts, a host can merge reports from several units by adding
+ *    the numbers together. Finally an `MW ...` line gives the worst case
+ *    update time for each state in microseconds; these merge by taking the
+ *    largest.
+ *  - `T` replies with the scheduler task statistics, as one `T<task> ...`
+ *    line per task giving its overruns, deferrals and worst run time in
+ *    microseconds, then a `TT <late> <worst>` line giving how many ticks
+ *    went over the tick budget and the longest tick in microseconds, and a
+ *    `TB <time>` line giving how long after reset, in milliseconds, setup()
+ *    finished and the switch started being read.
+ *  - `X<n>` turns tracing on if n is not 0, or off if it is. Tracing starts
+ *    with a record of the bar's current level. While tracing is on, each
+ *    trace record is sent as `X<time> <kind> <value>`, where the kind is a
+ *    Trace::Kind value, and `XD<count>` is sent if records had to be
+ *    dropped. Records are only sent when there is room in the serial
+ *    buffer, so tracing never makes the console block.
+ *
+ *  The `H`, `M` and `T` replies are too long to send in one go without
+ *  blocking for a long time at low baud rates, so they are sent a piece at
+ *  a time, from update(), whenever there is room in the serial buffer.
+ *  While one is being sent, further commands wait to be read and trace
+ *  records wait to be sent, so nothing gets mixed up with it. Counters
+ *  that change while a reply is being sent are sent as they are when
+ *  their piece is.
+ */
+class Console
+{
+public:
+    /** Create a new Console object.
+     *
+     * @param button A reference to the switch to report the health of.
+     * @param fsm    A reference to the state machine to report the metrics of.
+     * @param baud   The serial port speed to use.
+     * @param scheduler An optional pointer to the scheduler to report the
+     *               task statistics of.
+     * @param trace  An optional pointer to the trace to send records from.
+     * @param boot_time An optional pointer to a variable holding the time
+     *               setup() finished at, in milliseconds since reset.
+     * @return A new Console object.
+     */
+    Console(SwitchControl &button, Machine &fsm, unsigned long baud = 9600, Scheduler *scheduler = NULL, Trace *trace = NULL,
+            const millis_t *boot_time = NULL) :
+        button(button), fsm(fsm), baud(baud), scheduler(scheduler), trace(trace), boot_time(boot_time), length(0),
+        report(0), piece(0)
+        { /* fnord */ }
+
+
+    /** Start the serial port. This should be called once from the global
+     *  setup() function.
+     */
+    void setup();
+
+
+    /** Read any characters waiting on the serial port, and run any commands
+     *  they complete.
+     */
+    void update();
+
+
+    /** Save or restore the command line being read and the reply being sent.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t max_line  = 16; //!< The longest command line accepted
+    static const int     max_piece = 15; //!< The longest piece of a reply, "TB 4294967295\r\n"
+
+    /** Run a command.
+     *
+     * @param command The letter selecting the command.
+     * @param value   The number following the letter, or 0 if there was none.
+     */
+    void run(char command, uint32_t value);
+
+    /** Send as many pieces of the reply being sent as will fit in the
+     *  serial buffer without blocking.
+     */
+    void send_report();
+
+    /** Send one piece of the switch health counters reply over serial.
+     *
+     * @param piece The piece to send, counting from 0.
+     * @return `true` if the piece was sent, `false` if the reply has no
+     *         more pieces.
+     */
+    bool send_health(uint8_t piece);
+
+    /** Send one piece of the state machine metrics reply over serial.
+     *
+     * @param piece The piece to send, counting from 0.
+     * @return `true` if the piece was sent, `false` if the reply has no
+     *         more pieces.
+     */
+    bool send_metrics(uint8_t piece);
+
+    /** Send one piece of the scheduler task statistics reply over serial.
+     *
+     * @param piece The piece to send, counting from 0.
+     * @return `true` if the piece was sent, `false` if the reply has no
+     *         more pieces.
+     */
+    bool send_tasks(uint8_t piece);
+
+    /** Send as many waiting trace records over serial as will fit in the
+     *  serial buffer without blocking.
+     */
+    void send_trace();
+
+    /** Send one piece of a line of counters over serial. The first piece
+     *  is the line's name and number, each counter is a piece of its own,
+     *  preceded by a space, and the last piece ends the line. If the piece
+     *  is past the end of the line, it is made relative to the end of the
+     *  line instead, so that a reply made of several lines can try each
+     *  line in turn.
+     *
+     * @param name     The name to start the line with.
+     * @param number   A number to follow the name, or -1 for none.
+     * @param counters The counters to send.
+     * @param count    The number of counters in the line.
+     * @param piece    The piece to send. Reduced by the number of pieces in
+     *                 the line if it is past the end of the line.
+     * @return `true` if the piece was sent, `false` if it was past the end.
+     */
+    bool send_line(const char *name, int8_t number, const uint16_t *counters, uint8_t count, uint8_t &piece);
+
+    SwitchControl &button;     //!< A reference to the switch to report the health of
+    Machine &fsm;              //!< A reference to the state machine to report the metrics of
+    unsigned long baud;        //!< The serial port speed
+    Scheduler *scheduler;      //!< A pointer to the scheduler to report on, or NULL if there isn't one
+    Trace *trace;              //!< A pointer to the trace to send, or NULL if there isn't one
+    const millis_t *boot_time; //!< A pointer to the time setup() finished, or NULL if it isn't known
+    char line[max_line];       //!< The command line being read
+    uint8_t length;            //!< How many characters are in the line
+    char report;               //!< The command whose reply is being sent, or 0 if there isn't one
+    uint8_t piece;             //!< The next piece of the reply to send
+};
+
+#endif
@@ -0,0 +1,171 @@
+/** @file
+ *  Implementation of the CurrentSensor class. This file contains the
+ *  implementation of the cycle sensor that monitors the current drawn by a
+ *  laundry machine using a current transformer.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no cycle sensor
+#if !defined(USE_TINY_PROFILE)
+
+#include "CurrentSensor.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+
+// The sensor that ADC conversions should be passed to. Only one sensor can
+// use the ADC at a time, so this is set by the most recent setup() call.
+static CurrentSensor *adc_sensor = NULL;
+
+ISR(ADC_vect)
+{
+    if (adc_sensor) {
+        adc_sensor -> add_sample(ADC);
+    }
+}
+#endif
+
+
+void CurrentSensor::setup()
+{
+#if defined(__AVR__)
+    uint8_t channel = (analog_pin >= A0) ? analog_pin - A0 : analog_pin;
+
+    adc_sensor = this;
+
+    ADMUX  = _BV(REFS0) | (channel & 0x07); // AVcc reference, right adjusted
+    ADCSRB = 0;                             // free running trigger
+    DIDR0 |= _BV(channel & 0x07);           // no digital input buffer on the pin
+
+    // Enable the ADC in auto-trigger mode with the interrupt enabled, using a
+    // /128 prescaler (9.6kHz sample rate at 16MHz), and start converting.
+    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+#endif
+}
+
+
+void CurrentSensor::add_sample(uint16_t sample)
+{
+    // Track the DC bias with a slow low-pass filter, and remove it
+    int16_t centred = (int16_t)sample - (int16_t)(bias >> bias_shift);
+    bias += centred;
+
+    window_sum += (uint32_t)((int32_t)centred * centred);
+
+    // When the window is full, slide it into the group of recent windows
+    if (++window_samples == (1 << window_shift)) {
+        sliding_sum += window_sum - window_sums[window_index];
+        window_sums[window_index] = window_sum;
+        window_index = (window_index + 1) & (windows - 1);
+
+        if (windows_filled < windows) {
+            ++windows_filled;
+        }
+
+        window_sum     = 0;
+        window_samples = 0;
+        window_ready   = true;
+    }
+}
+
+
+void CurrentSensor::update()
+{
+    if (!window_ready) {
+        return;
+    }
+
+    // Take a consistent copy of the values shared with the interrupt
+    noInterrupts();
+    uint32_t sum    = sliding_sum;
+    uint8_t  filled = windows_filled;
+    window_ready    = false;
+    interrupts();
+
+    // Wait until there's a full set of windows before trusting the RMS
+    if (filled < windows) {
+        return;
+    }
+
+    current_rms = isqrt(sum >> (window_shift + windows_shift));
+
+    // Use hysteresis to avoid flapping around a single threshold
+    if (current_rms >= on_threshold) {
+        active = true;
+    } else if (current_rms < off_threshold) {
+        active = false;
+    }
+
+    set_active(active);
+}
+
+
+uint16_t CurrentSensor::isqrt(uint32_t value)
+{
+    uint32_t result = 0;
+    uint32_t bit    = 1UL << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit) {
+        if (value >= result + bit) {
+            value  -= result + bit;
+            result  = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint16_t)result;
+}
+
+
+void CurrentSensor::snapshot(Snapshot &snapshot)
+{
+    CycleSensor::snapshot(snapshot);
+    snapshot.field(active);
+    snapshot.field(current_rms);
+    snapshot.field(bias);
+    snapshot.field(window_sum);
+    snapshot.field(window_samples);
+    snapshot.field(window_sums);
+    snapshot.field(window_index);
+    snapshot.field(windows_filled);
+
+    noInterrupts();
+    snapshot.field(sliding_sum);
+    snapshot.field(window_ready);
+    interrupts();
+}
+
+#endif
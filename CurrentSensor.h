@@ -0,0 +1,145 @@
+/** @file
+ *  Definition of the CurrentSensor class. This file contains the definition
+ *  of a cycle sensor that monitors the current drawn by a laundry machine
+ *  using a current transformer connected to an analog input.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef CurrentSensor_H
+#define CurrentSensor_H
+
+#include <Arduino.h>
+#include "CycleSensor.h"
+#include "Snapshot.h"
+
+/** A cycle sensor that watches the current drawn by the machine through a
+ *  current transformer. The transformer output should be biased to half the
+ *  ADC reference, and is sampled by the ADC in free-running mode, with each
+ *  conversion handled in the ADC interrupt. The interrupt removes the DC bias
+ *  and accumulates squared samples into fixed-size windows, and the RMS
+ *  current is calculated in fixed point over a sliding group of the most
+ *  recent windows. The machine is considered active when the RMS rises above
+ *  the on threshold, and idle when it drops below the off threshold.
+ *
+ * @note As the ADC is left free-running, analogRead() can not be used by
+ *       anything else while this sensor is in use.
+ *
+ * @note On non-AVR (host) builds no interrupt is installed, and samples
+ *       should be fed to the sensor with add_sample(), for example from a
+ *       recorded waveform file.
+ */
+class CurrentSensor : public CycleSensor
+{
+public:
+    /** Create a new CurrentSensor object.
+     *
+     * @param analog_pin    The analog pin the current transformer is connected to.
+     * @param on_threshold  The RMS level, in ADC counts, above which the machine
+     *                      is considered to be running.
+     * @param off_threshold The RMS level, in ADC counts, below which the machine
+     *                      is considered to be idle. This should be lower than
+     *                      on_threshold to provide some hysteresis.
+     * @param idle_time     How long, in milliseconds, the machine must be idle
+     *                      after running before the cycle is finished.
+     * @return A new CurrentSensor object.
+     */
+    CurrentSensor(uint8_t analog_pin, uint16_t on_threshold = 30, uint16_t off_threshold = 15, millis_t idle_time = 180000) :
+        CycleSensor(idle_time), analog_pin(analog_pin),
+        on_threshold(on_threshold), off_threshold(off_threshold),
+        active(false), current_rms(0),
+        bias(512L << bias_shift), window_sum(0), window_samples(0),
+        window_index(0), windows_filled(0), sliding_sum(0), window_ready(false)
+        { memset(window_sums, 0, sizeof(window_sums)); }
+
+
+    /** Configure the ADC to continuously sample the current transformer, and
+     *  enable the ADC conversion complete interrupt.
+     */
+    void setup();
+
+
+    /** Check for completed sample windows, recalculate the RMS current, and
+     *  update the active/idle status of the machine.
+     */
+    void update();
+
+
+    /** Add a sample to the current window. This is called from the ADC
+     *  interrupt on AVR builds, and must be kept short.
+     *
+     * @param sample The raw ADC reading, in the range 0 to 1023.
+     */
+    void add_sample(uint16_t sample);
+
+
+    /** Obtain the most recently calculated RMS current.
+     *
+     * @return The RMS current, in ADC counts.
+     */
+    uint16_t rms() {
+        return current_rms;
+    }
+
+
+    /** Save or restore the cycle state and the RMS calculation.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t window_shift  = 8;  //!< Each window holds 2^window_shift samples
+    static const uint8_t windows_shift = 3;  //!< The RMS is calculated over 2^windows_shift windows
+    static const uint8_t windows       = 1 << windows_shift;
+    static const uint8_t bias_shift    = 12; //!< Fixed point fraction bits in the DC bias tracker
+
+    /** Calculate the integer square root of a value.
+     *
+     * @param value The value to calculate the square root of.
+     * @return The largest integer whose square is less than or equal to value.
+     */
+    static uint16_t isqrt(uint32_t value);
+
+    uint8_t  analog_pin;    //!< The analog pin the current transformer is connected to
+    uint16_t on_threshold;  //!< RMS level above which the machine is running
+    uint16_t off_threshold; //!< RMS level below which the machine is idle
+    bool     active;        //!< Is the machine currently considered to be running?
+    uint16_t current_rms;   //!< The most recently calculated RMS, in ADC counts
+
+    // Values updated in the ADC interrupt
+    int32_t  bias;                     //!< The DC bias of the signal, in fixed point
+    uint32_t window_sum;               //!< The sum of squared samples in the current window
+    uint16_t window_samples;           //!< How many samples are in the current window
+    uint32_t window_sums[windows];     //!< The sums of squared samples for recent windows
+    uint8_t  window_index;             //!< The slot in window_sums the next window is stored in
+    uint8_t  windows_filled;           //!< How many slots in window_sums hold real windows
+    volatile uint32_t sliding_sum;     //!< The sum of squared samples over all recent windows
+    volatile bool     window_ready;    //!< Set when a window completes, cleared in update()
+};
+
+#endif
@@ -0,0 +1,131 @@
+/** @file
+ *  Implementation of the CyclePredictor class. This file contains the
+ *  implementation of the class that learns how long the machine's programs
+ *  really take, and which program is used most often.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no cycle predictor
+#if !defined(USE_TINY_PROFILE)
+
+#include "CyclePredictor.h"
+#include "EepromWriter.h"
+
+void CyclePredictor::setup()
+{
+    bool valid = EepromWriter::get(eeprom_address, stats);
+
+    // If the EEPROM has never held statistics, start from nothing. This only
+    // happens once, after that only changed bytes are written.
+    if (!valid || stats.magic != stats_magic) {
+        memset(&stats, 0, sizeof(stats));
+        stats.magic = stats_magic;
+        stats.preferred = 1;
+
+        EepromWriter::put(eeprom_address, stats);
+    }
+}
+
+
+void CyclePredictor::select(uint8_t bars)
+{
+    if (bars < 1 || bars > max_programs) {
+        return;
+    }
+
+    program = bars;
+
+    // Boyer-Moore majority vote: the preferred program survives as long as
+    // it is selected more often than everything else.
+    if (bars == stats.preferred) {
+        if (stats.votes < 0xff) {
+            ++stats.votes;
+        }
+    } else if (stats.votes) {
+        --stats.votes;
+    } else {
+        stats.preferred = bars;
+        stats.votes = 1;
+    }
+
+    EepromWriter::put(eeprom_address, stats);
+}
+
+
+void CyclePredictor::record(millis_t duration)
+{
+    if (!program || duration < 4 * quarter_minute) {
+        return;
+    }
+
+    uint32_t quarters = duration / quarter_minute;
+    if (quarters > 0xffff) {
+        quarters = 0xffff;
+    }
+
+    // The first duration seen is taken as-is, after that it's an
+    // exponentially weighted mean
+    uint16_t &mean = stats.mean[program - 1];
+    if (!mean) {
+        mean = quarters;
+    } else {
+        mean += ((int32_t)quarters - (int32_t)mean) / (1 << weight_shift);
+    }
+
+    EepromWriter::put(eeprom_address, stats);
+
+    // Only record one duration per selection
+    program = 0;
+}
+
+
+millis_t CyclePredictor::predicted()
+{
+    if (!program) {
+        return 0;
+    }
+
+    return stats.mean[program - 1] * quarter_minute;
+}
+
+
+uint8_t CyclePredictor::preferred()
+{
+    return stats.preferred;
+}
+
+
+void CyclePredictor::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(program);
+    snapshot.field(stats);
+}
+
+#endif
@@ -0,0 +1,138 @@
+/** @file
+ *  Definition of the CyclePredictor class. This file contains the definition
+ *  of a class that learns how long the machine's programs really take, and
+ *  which program is used most often.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef CyclePredictor_H
+#define CyclePredictor_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "BarDisplay.h"
+#include "Snapshot.h"
+
+/** A class to learn how long each program really takes. Programs are
+ *  identified by the number of bars selected in the ProgramState, and for
+ *  each one an exponentially weighted mean of the observed durations is
+ *  kept. Durations are only observed when a cycle sensor detects the end
+ *  of a cycle, as the time at which a user cancels the timer says nothing
+ *  reliable about how long the program takes. The class also tracks which
+ *  program is used most often, using a majority vote that needs only a
+ *  single counter, so that it can be offered as the default.
+ *
+ *  All updates are O(1), and the statistics are kept in EEPROM so that they
+ *  survive power cycles. Only the bytes that change are written, to keep
+ *  EEPROM wear down.
+ */
+class CyclePredictor
+{
+public:
+    /** Create a new CyclePredictor object.
+     *
+     * @param eeprom_address The EEPROM address the statistics are stored at.
+     *                       This needs sizeof(CyclePredictor::Stats) +
+     *                       EepromWriter::overhead bytes.
+     * @return A new CyclePredictor object.
+     */
+    CyclePredictor(int eeprom_address) :
+        eeprom_address(eeprom_address), program(0)
+        { /* fnord */ }
+
+
+    /** Load the statistics from EEPROM. If the EEPROM does not contain valid
+     *  statistics, everything starts from scratch. This should be called
+     *  once from the global setup() function.
+     */
+    void setup();
+
+
+    /** Record that a program has been selected. This should be called when
+     *  the timer is started, and sets the program that any duration passed
+     *  to record() will be attributed to.
+     *
+     * @param bars The number of bars selected by the user.
+     */
+    void select(uint8_t bars);
+
+
+    /** Record the actual duration of the selected program. Durations shorter
+     *  than a minute are ignored, as they are more likely to be a false start
+     *  than a real cycle.
+     *
+     * @param duration The time the program actually took, in milliseconds.
+     */
+    void record(millis_t duration);
+
+
+    /** Obtain the predicted duration of the selected program.
+     *
+     * @return The predicted duration in milliseconds, or 0 if nothing has
+     *         been recorded for the program yet.
+     */
+    millis_t predicted();
+
+
+    /** Obtain the program the user selects most often.
+     *
+     * @return The number of bars in the most frequently used program, or 1
+     *         if no programs have been selected yet.
+     */
+    uint8_t preferred();
+
+
+    static const uint8_t max_programs = BarDisplay::segments; //!< How many programs can be tracked, one per bar length
+
+    /** The statistics stored in EEPROM.
+     */
+    struct Stats {
+        uint8_t  magic;                 //!< Set to stats_magic when the statistics are valid
+        uint8_t  preferred;             //!< The current majority vote winner, in bars
+        uint8_t  votes;                 //!< The majority vote counter for the preferred program
+        uint16_t mean[max_programs];    //!< The mean duration of each program, in quarter minutes
+    };
+
+
+    /** Save or restore the selected program and the copy of the statistics.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t       stats_magic    = 0xC5;  //!< Marker indicating the stats are valid
+    static const uint8_t       weight_shift   = 2;     //!< New durations are weighted by 1/2^weight_shift
+    static const millis_t      quarter_minute = 15000; //!< Milliseconds in a quarter minute
+
+    int eeprom_address; //!< The address of the statistics in EEPROM
+    uint8_t program;    //!< The currently selected program, in bars, or 0 if none has been selected
+    Stats stats;        //!< A copy of the statistics stored in EEPROM
+};
+
+#endif
@@ -0,0 +1,62 @@
+/** @file
+ *  Implementation of the CycleSensor base class. This file contains the
+ *  implementation of the idle tracking shared by all cycle sensors.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no cycle sensor
+#if !defined(USE_TINY_PROFILE)
+
+#include "CycleSensor.h"
+
+void CycleSensor::set_active(bool active)
+{
+    if (active) {
+        // Any activity (re)starts the idle timer; the cycle can't be over yet.
+        started    = true;
+        finished   = false;
+        idle_start = millis();
+
+    // Only count idle time once the machine has been seen running, otherwise
+    // a timer started before the machine would finish immediately.
+    } else if (started && (millis_t)(millis() - idle_start) > idle_time) {
+        finished = true;
+    }
+}
+
+
+void CycleSensor::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(started);
+    snapshot.field(finished);
+    snapshot.field(idle_start);
+}
+
+#endif
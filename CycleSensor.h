@@ -0,0 +1,150 @@
+/** @file
+ *  Definition of the CycleSensor base class. This file contains the base
+ *  class for sensors that can detect when a laundry machine has actually
+ *  finished its cycle, rather than relying on the time set by the user.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef CycleSensor_H
+#define CycleSensor_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "Snapshot.h"
+
+/** The base class for cycle completion sensors. This implements the
+ *  bookkeeping common to all sensors: a cycle is considered to have started
+ *  once the sensor has seen the machine running, and to have finished once
+ *  the machine has then been idle for longer than the idle time. Derived
+ *  sensors should override update() to take their measurements and report
+ *  whether the machine appears to be active via set_active().
+ */
+class CycleSensor
+{
+public:
+    /** The phases of a cycle that sensors may be able to distinguish.
+     */
+    enum Phase {
+        PHASE_UNKNOWN, //!< The sensor can't tell what the machine is doing.
+        PHASE_IDLE,    //!< The machine is not doing anything.
+        PHASE_AGITATE, //!< The machine is washing, rinsing, or tumbling.
+        PHASE_SPIN     //!< The machine is spinning.
+    };
+
+    /** Create a new cycle sensor.
+     *
+     * @param idle_time How long, in milliseconds, the machine must appear idle
+     *                  after running before the cycle is considered finished.
+     *                  This needs to be longer than any pause in the machine's
+     *                  cycle (soaking, draining, and so on).
+     * @return A new CycleSensor object.
+     */
+    CycleSensor(millis_t idle_time) :
+        idle_time(idle_time), started(false), finished(false), idle_start(0)
+        { /* fnord */ };
+
+
+    /** Initialise the hardware used by the sensor. This should be called once
+     *  from the global setup() function.
+     */
+    virtual void setup() { };
+
+
+    /** Prepare the sensor to watch a new cycle. This discards any previous
+     *  started or finished indication, and should be called whenever a new
+     *  timer is started.
+     */
+    virtual void reset() {
+        started    = false;
+        finished   = false;
+        idle_start = millis();
+    }
+
+
+    /** Process any new measurements taken by the sensor. This should be
+     *  called regularly while the sensor is in use, and implementations
+     *  must call set_active() whenever they have a new measurement.
+     */
+    virtual void update() = 0;
+
+
+    /** Determine whether the sensor has seen the machine running since the
+     *  last reset().
+     *
+     * @return `true` if the machine has been seen running, `false` otherwise.
+     */
+    bool cycle_started() {
+        return started;
+    }
+
+
+    /** Determine whether the machine has finished its cycle. This will only
+     *  return true if the machine has been seen running, and then been idle
+     *  for longer than the idle time.
+     *
+     * @return `true` if the cycle has finished, `false` otherwise.
+     */
+    bool cycle_finished() {
+        return finished;
+    }
+
+
+    /** Obtain the phase of the cycle the machine appears to be in. Sensors
+     *  that can not distinguish phases will always return PHASE_UNKNOWN.
+     *
+     * @return The current phase of the machine's cycle.
+     */
+    virtual Phase phase() {
+        return PHASE_UNKNOWN;
+    }
+
+
+    /** Save or restore whether the cycle has started and finished. Sensors
+     *  with filters of their own add them to this.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    virtual void snapshot(Snapshot &snapshot);
+
+protected:
+    /** Record whether the machine appears to be active based on the latest
+     *  measurement taken by the sensor.
+     *
+     * @param active `true` if the machine appears to be running, `false` if
+     *               it appears to be idle.
+     */
+    void set_active(bool active);
+
+private:
+    millis_t idle_time;       //!< How long the machine must be idle after running to finish the cycle, in millis
+    bool started;             //!< Has the machine been seen running since the last reset?
+    bool finished;            //!< Has the machine been idle for long enough after running?
+    millis_t idle_start;      //!< The time at which the machine was last seen running, in millis
+};
+
+#endif
@@ -0,0 +1,254 @@
+/** @file
+ *  Implementation of the EepromWriter class. This file contains the
+ *  implementation of a class that writes records to EEPROM in the background.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <EEPROM.h>
+#include "Profile.h"
+#include "EepromWriter.h"
+
+uint8_t                   EepromWriter::buffer[EepromWriter::buffer_size];
+EepromWriter::Job         EepromWriter::jobs[EepromWriter::max_jobs];
+uint8_t                   EepromWriter::job_head  = 0;
+volatile uint8_t          EepromWriter::job_count = 0;
+uint8_t                   EepromWriter::step      = 0;
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+
+// The tiny profile only reads EEPROM, so it leaves the interrupt out; then
+// nothing refers to the write queue, and the linker drops it too
+#if !defined(USE_TINY_PROFILE)
+// Fires whenever the EEPROM is ready for a write, while it's enabled
+ISR(EE_READY_vect)
+{
+    EepromWriter::write_next();
+}
+#endif
+#endif
+
+
+bool EepromWriter::load(int address, void *data, uint8_t length)
+{
+    uint8_t *bytes = (uint8_t *)data;
+
+#if defined(__AVR__)
+    // Hold the interrupt off, so the record can't change while it's read
+    uint8_t writing = EECR & _BV(EERIE);
+    EECR &= ~_BV(EERIE);
+#endif
+
+    for (uint8_t index = 0; index < length; ++index) {
+        bytes[index] = EEPROM.read(address + index);
+    }
+
+    bool valid = EEPROM.read(address + length + 1) == commit_marker &&
+                 EEPROM.read(address + length) == checksum(bytes, length);
+
+#if defined(__AVR__)
+    EECR |= writing;
+#endif
+
+    return valid;
+}
+
+
+bool EepromWriter::submit(int address, const void *data, uint8_t length)
+{
+    if (!length || length > buffer_size) {
+        return false;
+    }
+
+    noInterrupts();
+
+    // Find room for the copy after the newest record. The copies are used
+    // as a ring, but each one is kept in a single piece.
+    uint8_t offset = 0;
+    bool room = (job_count < max_jobs);
+    if (room && job_count) {
+        const Job &oldest = jobs[job_head];
+        const Job &newest = jobs[(job_head + job_count - 1) % max_jobs];
+        uint8_t end = newest.offset + newest.length;
+
+        if (end > oldest.offset) {
+            if (end + length <= buffer_size) {
+                offset = end;
+            } else if (length > oldest.offset) {
+                room = false;
+            }
+        } else if (end + length <= oldest.offset) {
+            offset = end;
+        } else {
+            room = false;
+        }
+    }
+
+    if (room) {
+        Job &job = jobs[(job_head + job_count) % max_jobs];
+        job.address  = address;
+        job.offset   = offset;
+        job.length   = length;
+        memcpy(&buffer[offset], data, length);
+        job.checksum = checksum(&buffer[offset], length);
+        ++job_count;
+    }
+
+    interrupts();
+
+    if (room) {
+        start();
+    }
+
+    return room;
+}
+
+
+void EepromWriter::flush()
+{
+    while (is_busy()) {
+#if !defined(__AVR__)
+        write_next();
+#endif
+    }
+}
+
+
+void EepromWriter::write_next()
+{
+    while (job_count) {
+        int address;
+        uint8_t value;
+
+        // A record that's already committed with the same contents doesn't
+        // need its marker cleared and set again
+        if ((step == 0 && is_committed(jobs[job_head])) ||
+            !job_byte(jobs[job_head], step, address, value)) {
+            job_head = (job_head + 1) % max_jobs;
+            --job_count;
+            step = 0;
+            continue;
+        }
+        ++step;
+
+        // Only one byte is written per interrupt, as the next can't start
+        // until this one is done. Unchanged bytes cost nothing, so go on.
+        if (EEPROM.read(address) != value) {
+#if defined(__AVR__)
+            // EEPROM.write() clears EERIE, which would stop the interrupt
+            // after this byte, so start the write here with it left on.
+            // EEPE must be set within four cycles of EEMPE.
+            EEAR = address;
+            EEDR = value;
+            EECR = _BV(EERIE) | _BV(EEMPE);
+            EECR |= _BV(EEPE);
+#else
+            EEPROM.write(address, value);
+#endif
+            return;
+        }
+    }
+
+#if defined(__AVR__)
+    // Nothing left to write, so stop the interrupt until the next submit()
+    EECR &= ~_BV(EERIE);
+#endif
+}
+
+
+uint8_t EepromWriter::checksum(const uint8_t *data, uint8_t length)
+{
+    // Rotate and add, so that swapped bytes are caught as well as changed ones
+    uint8_t sum = length;
+    for (uint8_t index = 0; index < length; ++index) {
+        sum = ((sum << 1) | (sum >> 7)) + data[index];
+    }
+
+    return sum;
+}
+
+
+bool EepromWriter::is_committed(const Job &job)
+{
+    if (EEPROM.read(job.address + job.length + 1) != commit_marker ||
+        EEPROM.read(job.address + job.length) != job.checksum) {
+        return false;
+    }
+
+    for (uint8_t index = 0; index < job.length; ++index) {
+        if (EEPROM.read(job.address + index) != buffer[job.offset + index]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool EepromWriter::job_byte(const Job &job, uint8_t step, int &address, uint8_t &value)
+{
+    if (step == 0) {
+        address = job.address + job.length + 1;
+        value   = invalid_marker;
+    } else if (step <= job.length) {
+        address = job.address + step - 1;
+        value   = buffer[job.offset + step - 1];
+    } else if (step == job.length + 1) {
+        address = job.address + job.length;
+        value   = job.checksum;
+    } else if (step == job.length + 2) {
+        address = job.address + job.length + 1;
+        value   = commit_marker;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+
+void EepromWriter::start()
+{
+#if defined(__AVR__)
+    EECR |= _BV(EERIE);
+#else
+    flush();
+#endif
+}
+
+
+void EepromWriter::snapshot(Snapshot &snapshot)
+{
+    noInterrupts();
+    snapshot.field(buffer);
+    snapshot.field(jobs);
+    snapshot.field(job_head);
+    snapshot.field(job_count);
+    snapshot.field(step);
+    interrupts();
+}
@@ -0,0 +1,189 @@
+/** @file
+ *  Definition of the EepromWriter class. This file contains the definition
+ *  of a class that writes records to EEPROM in the background.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef EepromWriter_H
+#define EepromWriter_H
+
+#include <Arduino.h>
+#include "Snapshot.h"
+
+/** A class to write records to EEPROM without blocking the main loop. Each
+ *  EEPROM byte takes about 3.3ms to write, so even a small record written
+ *  with EEPROM.put() holds everything else up for tens of milliseconds.
+ *  Instead, records are copied into a queue and submit() returns straight
+ *  away. The EEPROM ready interrupt then writes the queued bytes one at a
+ *  time, skipping any that already hold the right value.
+ *
+ *  Records are committed atomically: each is followed in EEPROM by a
+ *  checksum and a commit marker. The marker is cleared before the record
+ *  is changed, and set again once the record and checksum have been
+ *  written, so a record interrupted by a power cut is seen as invalid by
+ *  load(), rather than being half old and half new. This needs `overhead`
+ *  bytes of EEPROM after each record.
+ *
+ * @note On non-AVR (host) builds there is no interrupt, and submit() writes
+ *       the record before returning.
+ */
+class EepromWriter
+{
+public:
+    static const uint8_t overhead = 2; //!< Extra EEPROM bytes needed after each record
+
+    /** Load a record from EEPROM. Queued writes are held off while the
+     *  record is read, so it can't change part way through.
+     *
+     * @param address The EEPROM address of the record.
+     * @param data    Where to store the record.
+     * @param length  The length of the record, in bytes.
+     * @return `true` if the record was committed and its checksum matches,
+     *         `false` if it was never written, or the write was interrupted.
+     */
+    static bool load(int address, void *data, uint8_t length);
+
+
+    /** Queue a record to be written to EEPROM. The record is copied, so it
+     *  can be changed as soon as this returns.
+     *
+     * @param address The EEPROM address of the record.
+     * @param data    The record to write.
+     * @param length  The length of the record, in bytes.
+     * @return `true` if the record was queued, `false` if there isn't room
+     *         in the queue for it at the moment.
+     */
+    static bool submit(int address, const void *data, uint8_t length);
+
+
+    /** Load a record from EEPROM, in the style of EEPROM.get().
+     *
+     * @param address The EEPROM address of the record.
+     * @param record  Where to store the record.
+     * @return `true` if the record is valid, `false` if not.
+     */
+    template <class T> static bool get(int address, T &record) {
+        return load(address, &record, sizeof(T));
+    }
+
+
+    /** Queue a record to be written to EEPROM, in the style of EEPROM.put().
+     *
+     * @param address The EEPROM address of the record.
+     * @param record  The record to write.
+     * @return `true` if the record was queued, `false` if not.
+     */
+    template <class T> static bool put(int address, const T &record) {
+        return submit(address, &record, sizeof(T));
+    }
+
+
+    /** Are there records still waiting to be written?
+     *
+     * @return `true` if the queue is not empty, `false` if everything has
+     *         been written.
+     */
+    static bool is_busy() {
+        return job_count != 0;
+    }
+
+
+    /** Wait until everything in the queue has been written. This blocks, so
+     *  should only be used when there's nothing else to do, such as before
+     *  a deliberate reset.
+     */
+    static void flush();
+
+
+    /** Write the next changed byte in the queue, if there is one. This is
+     *  called from the EEPROM ready interrupt on AVR builds.
+     */
+    static void write_next();
+
+
+    /** Save or restore the write queue. The EEPROM contents aren't included,
+     *  as they belong to the board rather than the sketch.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    static void snapshot(Snapshot &snapshot);
+
+private:
+    /** A record waiting to be written.
+     */
+    struct Job {
+        int address;       //!< The EEPROM address of the record
+        uint8_t offset;    //!< Where the copy of the record starts in the buffer
+        uint8_t length;    //!< The length of the record, in bytes
+        uint8_t checksum;  //!< The checksum of the record
+    };
+
+    static const uint8_t max_jobs       = 6;     //!< How many records can be queued
+    static const uint8_t buffer_size    = 96;    //!< Space for queued record copies, in bytes
+    static const uint8_t commit_marker  = 0xa5;  //!< Marker value for a committed record
+    static const uint8_t invalid_marker = 0x00;  //!< Marker value while a record is being changed
+
+    /** Calculate the checksum for a record.
+     *
+     * @param data   The record.
+     * @param length The length of the record, in bytes.
+     * @return The checksum.
+     */
+    static uint8_t checksum(const uint8_t *data, uint8_t length);
+
+    /** Check whether a job's record is already committed in EEPROM.
+     *
+     * @param job The job to check.
+     * @return `true` if EEPROM already holds the record, committed.
+     */
+    static bool is_committed(const Job &job);
+
+    /** Work out which EEPROM byte to write for a step through a job. The
+     *  steps are the invalid marker, the record bytes, the checksum, and
+     *  finally the commit marker.
+     *
+     * @param job     The job to look at.
+     * @param step    The step through the job.
+     * @param address Set to the EEPROM address to write.
+     * @param value   Set to the value to write.
+     * @return `true` if there is a byte to write, `false` if the job is done.
+     */
+    static bool job_byte(const Job &job, uint8_t step, int &address, uint8_t &value);
+
+    /** Start writing the queue, if it isn't already being written.
+     */
+    static void start();
+
+    static uint8_t buffer[buffer_size];  //!< Copies of the queued records
+    static Job jobs[max_jobs];           //!< The queued records, oldest first
+    static uint8_t job_head;             //!< The oldest queued record
+    static volatile uint8_t job_count;   //!< How many records are queued
+    static uint8_t step;                 //!< How far through the oldest record writing has got
+};
+
+#endif
@@ -33,8 +33,29 @@
 void Machine::update(SwitchControl::Event event)
 {
     // If the FSM is in a sane state, with a known state impl, run the state's update.
+    microsteps = 0;
+
+    // STATE_NONE from update() just means no change, so it isn't passed on.
     if (current_state != State::StateID::STATE_NONE && states[current_state] ) {
-        set_state(states[current_state] -> update(event));
+#if !defined(USE_TINY_PROFILE)
+        State::StateID from = current_state;
+        micros_t start = micros();
+#endif
+
+        State::StateID newstate = states[current_state] -> update(event);
+
+        if (newstate != State::StateID::STATE_NONE) {
+            run(newstate, event);
+        }
+
+#if !defined(USE_TINY_PROFILE)
+        // The update, and any transitions and enter()s it led to, are
+        // charged to the state the machine was in when it started
+        micros_t elapsed = micros() - start;
+        if (elapsed > worst_update[from]) {
+            worst_update[from] = (elapsed < 0xffff) ? elapsed : 0xffff;
+        }
+#endif
     }
 }
 
@@ -46,25 +67,131 @@ void Machine::add_state(State *state)
 }
 
 
-void Machine::set_state(State::StateID newstate)
+void Machine::set_led(SwitchLed &led)
+{
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        if (states[state]) {
+            states[state] -> set_led(led);
+        }
+    }
+}
+
+
+void Machine::set_state(State::StateID newstate, SwitchControl::Event event)
+{
+    microsteps = 0;
+    run(newstate, event);
+}
+
+
+void Machine::run(State::StateID newstate, SwitchControl::Event event)
 {
-    if (newstate != current_state &&              // nothing to do if already in the right state
-        newstate != State::StateID::STATE_NONE && // ignore attempts to go into no-state
-        newstate <  State::StateID::STATE_MAX &&  // only allow states in the known range
-        states[newstate]) {                       // and the state must have an implementation
+    do {
+        State::StateID previous = current_state;
+
+        if (microsteps == max_microsteps) {
+#if !defined(USE_TINY_PROFILE)
+            count(metrics.limited);
+#endif
+            return;
+        }
+
+        newstate = transition(newstate, event);
+        if (current_state == previous) {
+            return;
+        }
+        ++microsteps;
+
+        // The event has been dealt with by the first transition, anything
+        // after that is an eventless transition from the new state.
+        event = SwitchControl::EVENT_NONE;
+        if (newstate == State::StateID::STATE_NONE) {
+            newstate = states[current_state] -> update(event);
+        }
+    } while (newstate != State::StateID::STATE_NONE);
+}
+
+
+State::StateID Machine::transition(State::StateID newstate, SwitchControl::Event event)
+{
+    if (newstate == current_state) {                // nothing to do if already in the right state
+        return State::StateID::STATE_NONE;
+    }
+
+    if (newstate == State::StateID::STATE_NONE ||   // ignore attempts to go into no-state
+        newstate >= State::StateID::STATE_MAX ||    // only allow states in the known range
+        !states[newstate]) {                        // and the state must have an implementation
+#if !defined(USE_TINY_PROFILE)
+        count(metrics.rejected[current_state]);
+#endif
+        return State::StateID::STATE_NONE;
+    }
+
+#if !defined(USE_TINY_PROFILE)
+    // Record how long the old state lasted, and how we got out of it
+    if (current_state != State::StateID::STATE_NONE) {
+        count(metrics.dwell[current_state][dwell_bucket(states[current_state] -> state_time())]);
+    }
+    count(metrics.transitions[current_state][newstate]);
+#endif
 
-        current_state = newstate;
-        states[current_state] -> enter();
+    current_state = newstate;
+#if !defined(USE_TINY_PROFILE)
+    if (trace) {
+        trace -> record(Trace::TRACE_STATE, current_state);
+    }
+#endif
+
+    return states[current_state] -> enter(event);
+}
+
+
+#if !defined(USE_TINY_PROFILE)
+void Machine::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(current_state);
+    snapshot.field(microsteps);
+    snapshot.field(metrics);
+    snapshot.field(worst_update);
+
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        if (states[state]) {
+            states[state] -> snapshot(snapshot);
+        }
     }
 }
 
 
+uint8_t Machine::dwell_bucket(millis_t time)
+{
+    uint8_t bucket = 0;
+
+    // Buckets go up in powers of four seconds, to cover both the short
+    // states and the multi-hour timer in a handful of buckets
+    time /= 1000;
+    while (time && bucket < dwell_buckets - 1) {
+        time >>= 2;
+        ++bucket;
+    }
+
+    return bucket;
+}
+#endif
+
+
 /* ------------------------------------------------------------------------
  *  Base State
  */
 
 State::StateID State::update(SwitchControl::Event event)
 {
+    // States like STATE_OFF can last for months, so stop the state time
+    // wrapping round to look short after about 49.7 days.
+    millis_t now = Clock::millis();
+    if ((millis_t)(now - state_start_time) > max_state_time) {
+        state_start_time = now - max_state_time;
+    }
+
     // Longpresses always go to the off state, from any state.
     if (event == SwitchControl::EVENT_LONGPRESS) {
         return STATE_OFF;
@@ -75,17 +202,27 @@ State::StateID State::update(SwitchControl::Event event)
 }
 
 
+#if !defined(USE_TINY_PROFILE)
+void State::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(state_start_time);
+}
+#endif
+
+
 /* ------------------------------------------------------------------------
  *  STATE_OFF
  */
 
-void OffState::enter()
+State::StateID OffState::enter(SwitchControl::Event event)
 {
-    State::enter();
+    State::enter(event);
 
     // Turn off the bar and button LEDs
-    led_bar.setLevel(0);
-    button.set_led_state(false);
+    led_bar.setSteps(0);
+    led -> set_led_state(false);
+
+    return STATE_NONE;
 }
 
 State::StateID OffState::update(SwitchControl::Event event)
@@ -96,7 +233,7 @@ State::StateID OffState::update(SwitchControl::Event event)
     }
 
     // Wakeup from off on button press
-    if (event == SwitchControl::EVENT_PRESSED) {
+    if (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_DOUBLEPRESS) {
         return STATE_STARTUP;
     }
 
@@ -108,12 +245,15 @@ State::StateID OffState::update(SwitchControl::Event event)
  *  STATE_STARTUP
  */
 
-void StartupState::enter()
+State::StateID StartupState::enter(SwitchControl::Event event)
 {
-    State::enter();
+    State::enter(event);
 
     // Turn on the button LED
-    button.set_led_state(true);
+    led -> set_led_state(true);
+
+    // The self-test is only shown once, after that go straight to programming
+    return self_test ? STATE_NONE : STATE_PROGRAM;
 }
 
 State::StateID StartupState::update(SwitchControl::Event event)
@@ -123,29 +263,96 @@ State::StateID StartupState::update(SwitchControl::Event event)
         return newstate;
     }
 
+    // A press skips the rest of the self-test, and is passed on so that
+    // it counts towards the programmed time (or restarts the last program).
+    if (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_DOUBLEPRESS) {
+        self_test = false;
+        return STATE_PROGRAM;
+    }
+
     // fill in the LED bar based on the state time, with a bit of fudge on
-    // the timer at the end so it shows all 10 for more than an instant
-    if (state_time() >= 1500) {
+    // the timer at the end so it shows the full bar for more than an instant
+    if (state_time() >= test_time) {
+        self_test = false;
         return STATE_PROGRAM;
     } else {
-        led_bar.setLevel((state_time() + 10) / 100);
+        led_bar.setSteps((state_time() + fill_step / 10) / fill_step * BarDisplay::steps);
     }
 
     return STATE_NONE;
 }
 
 
+#if !defined(USE_TINY_PROFILE)
+void StartupState::snapshot(Snapshot &snapshot)
+{
+    State::snapshot(snapshot);
+    snapshot.field(self_test);
+}
+#endif
+
+
 /* ------------------------------------------------------------------------
  *  STATE_PROGRAM
  */
 
-void ProgramState::enter()
+State::StateID ProgramState::enter(SwitchControl::Event event)
 {
-    State::enter();
+    State::enter(event);
 
-    // There will always be a minimum of one bar turned on
-    led_bar.setLevel(1);
+    // There will always be a minimum of one bar turned on, and if we know
+    // which program the user normally picks, start with that.
+#if defined(USE_TINY_PROFILE)
     program_time = 1;
+#else
+    program_time = predictor ? predictor -> preferred() : 1;
+#endif
+    pressed = false;
+    flashing = false;
+
+#if !defined(USE_TINY_PROFILE)
+    // Forget about any turns made while the encoder wasn't being used
+    if (encoder) {
+        encoder -> discard();
+    }
+#endif
+    last_turn = millis() - timeout;
+
+#if !defined(USE_TINY_PROFILE)
+    // A double press that skipped the startup restarts the last program,
+    // if there is one; otherwise a press that skipped the startup counts
+    // as the first increment.
+    if (event == SwitchControl::EVENT_DOUBLEPRESS && history && history -> get()) {
+        program_time = history -> get();
+        start_timer();
+        return STATE_TIMER;
+    }
+#endif
+    if (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_DOUBLEPRESS) {
+        pressed = true;
+        if (++program_time > BarDisplay::segments) {
+            program_time = 1;
+        }
+    }
+
+    led_bar.setSteps(program_time * BarDisplay::steps);
+
+    return STATE_NONE;
+}
+
+void ProgramState::start_timer()
+{
+    *total_time = (millis_t)program_time * bar_time * 1000;
+
+#if !defined(USE_TINY_PROFILE)
+    if (predictor) {
+        predictor -> select(program_time);
+    }
+
+    if (history) {
+        history -> record(program_time);
+    }
+#endif
 }
 
 State::StateID ProgramState::update(SwitchControl::Event event)
@@ -155,50 +362,121 @@ State::StateID ProgramState::update(SwitchControl::Event event)
         return newstate;
     }
 
-    // If the user has pressed the button, increment the set time, with wrap
-    if (event == SwitchControl::EVENT_PRESSED) {
+#if !defined(USE_TINY_PROFILE)
+    // A double press before anything else restarts the last program
+    if (event == SwitchControl::EVENT_DOUBLEPRESS && !pressed && history && history -> get()) {
+        program_time = history -> get();
+        start_timer();
+        return STATE_TIMER;
+    }
+#endif
+
+    // If the user has pressed (or is holding) the button, increment the set
+    // time, with wrap
+    if (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_REPEAT || event == SwitchControl::EVENT_DOUBLEPRESS) {
+        pressed = true;
         ++program_time;
-        if (program_time > 10) {
+        if (program_time > BarDisplay::segments) {
             program_time = 1;
         }
 
-        led_bar.setLevel(program_time);
+        led_bar.setSteps(program_time * BarDisplay::steps);
     }
 
-    // If the user hasn't pressed and released the button for a period,
-    // look at flashing the LEDS or even starting the timer.
-    unsigned long released = button.time_since_released();
-     if (button.time_since_pressed() > hold_time && released > hold_time) {
-
-        // Flash the LEDs on and off to indicate impending timer set
-        if (((released - hold_time) / 250) % 2) {
-            led_bar.setLevel(0);
-        } else {
-            led_bar.setLevel(program_time);
+#if !defined(USE_TINY_PROFILE)
+    // Turning the encoder moves the set time by one bar per detent, with wrap
+    int8_t turned = encoder ? encoder -> read() : 0;
+    if (turned) {
+        int16_t bars = (int16_t)program_time + turned;
+        while (bars > BarDisplay::segments) {
+            bars -= BarDisplay::segments;
+        }
+        while (bars < 1) {
+            bars += BarDisplay::segments;
         }
 
+        pressed = true;
+        program_time = bars;
+        last_turn = millis();
+        led_bar.setSteps(program_time * BarDisplay::steps);
+    }
+#endif
+
+    // If the user hasn't pressed and released the button (or turned the
+    // encoder) for a period, look at flashing the LEDS or even starting the
+    // timer. The button may be held for a while to auto-repeat, so it must
+    // also be released.
+    millis_t released = button.time_since_released();
+    if ((millis_t)(millis() - last_turn) < released) {
+        released = millis() - last_turn;
+    }
+    if (!button.is_pressed() && button.time_since_pressed() > hold_time && released > hold_time) {
+
         // If the user hasn't pressed anything for over the timeout time, set
-        // the total time for the timer, and indicate the move to the new state
+        // the total time for the timer, and indicate the move to the new state.
+        // This is checked before flashing, as the timer redraws the bar in
+        // the same tick, and a frame costs as much as the rest of the tick.
         if (released > timeout) {
-            *total_time = program_time * (bar_time * 1000);
+            start_timer();
             return STATE_TIMER;
         }
+
+        // Flash the LEDs on and off to indicate impending timer set. The
+        // switch LED blinks in step with the bar, by itself.
+        if (!flashing) {
+            flashing = true;
+            led -> set_led_effect(LedEffects::EFFECT_BLINK);
+        }
+        if (((released - hold_time) / 250) % 2) {
+            led_bar.setSteps(0);
+        } else {
+            led_bar.setSteps(program_time * BarDisplay::steps);
+        }
+
+    // Any input stops the flashing until the user settles again
+    } else if (flashing) {
+        flashing = false;
+        led -> set_led_state(true);
     }
 
     return STATE_NONE;
 }
 
 
+#if !defined(USE_TINY_PROFILE)
+void ProgramState::snapshot(Snapshot &snapshot)
+{
+    State::snapshot(snapshot);
+    snapshot.field(program_time);
+    snapshot.field(pressed);
+    snapshot.field(last_turn);
+    snapshot.field(flashing);
+}
+#endif
+
+
 /* ------------------------------------------------------------------------
  *  STATE_TIMER
  */
 
-void TimerState::enter()
+State::StateID TimerState::enter(SwitchControl::Event event)
 {
-    State::enter();
+    State::enter(event);
+
+    // Make the first update draw the bar. A last update time of 0 would
+    // put that off for up to half a second just after millis() wraps. The
+    // machine runs that update straight after this, so drawing an empty bar
+    // here would only send a frame that is replaced in the same tick.
+    last_update = millis() - 1000;
+    led -> set_led_state(true);
+
+#if !defined(USE_TINY_PROFILE)
+    if (sensor) {
+        sensor -> reset();
+    }
+#endif
 
-    last_update = 0;
-    led_bar.setLevel(0);
+    return STATE_NONE;
 }
 
 State::StateID TimerState::update(SwitchControl::Event event)
@@ -209,13 +487,64 @@ State::StateID TimerState::update(SwitchControl::Event event)
     }
 
     // Only update the bar every half second or so; even that's probably overkill
-    if((unsigned long)(millis() - last_update) > 500) {
+    if((state_millis_t)(millis() - last_update) > 500) {
         last_update = millis();
 
-        led_bar.setLevel((float)state_time() / ((float)(*total_time) / 10.0f));
+        // Fill the bar over the time the timer will really run for. Without
+        // a sensor that's the set time; with one, the sensor should end the
+        // cycle after about as long as the program usually takes, if known.
+        millis_t expected = *total_time;
+#if !defined(USE_TINY_PROFILE)
+        if (sensor && predictor) {
+            millis_t predicted = predictor -> predicted();
+            if (predicted && predicted < expected) {
+                expected = predicted;
+            }
+        }
+#endif
+
+        // The level is worked out in steps of a segment with integer maths,
+        // as parts without floating point hardware have to do it in software.
+        // Long timers are scaled down until the product fits in 32 bits.
+        millis_t elapsed = state_time();
+        uint16_t level = BarDisplay::segments * BarDisplay::steps;
+        if (elapsed < expected) {
+            while (expected > 0xffffffffUL / level) {
+                expected >>= 1;
+                elapsed  >>= 1;
+            }
+            level = elapsed * level / expected;
+        }
+
+#if !defined(USE_TINY_PROFILE)
+        // A machine that is spinning is nearly done, whatever the clock says,
+        // so show all but the last segment
+        if (sensor && sensor -> phase() == CycleSensor::PHASE_SPIN && level < (BarDisplay::segments - 1) * BarDisplay::steps) {
+            level = (BarDisplay::segments - 1) * BarDisplay::steps;
+        }
+#endif
+
+        led_bar.setSteps(level);
     }
 
-    // If we've been in the state long enough, switch to the wait state.
+#if !defined(USE_TINY_PROFILE)
+    // If the sensor has seen the machine running and then go idle, the cycle
+    // is over, however long is left on the timer.
+    if (sensor) {
+        sensor -> update();
+
+        if (sensor -> cycle_started() && sensor -> cycle_finished()) {
+            if (predictor) {
+                predictor -> record(state_time());
+            }
+            return STATE_WAIT;
+        }
+    }
+#endif
+
+    // If we've been in the state long enough, switch to the wait state. This
+    // applies even when a sensor has seen the machine running, so a sensor
+    // that is picking up noise can't keep the timer going forever.
     if (state_time() > *total_time) {
         return STATE_WAIT;
     }
@@ -224,6 +553,15 @@ State::StateID TimerState::update(SwitchControl::Event event)
 }
 
 
+#if !defined(USE_TINY_PROFILE)
+void TimerState::snapshot(Snapshot &snapshot)
+{
+    State::snapshot(snapshot);
+    snapshot.field(last_update);
+}
+#endif
+
+
 /* ------------------------------------------------------------------------
  *  STATE_WAIT
  */
@@ -234,10 +572,10 @@ State::StateID TimerState::update(SwitchControl::Event event)
 // don't want to touch the sweep_led and _dir vars in the process.
 void WaitState::sweep_leds(int led, int dir)
 {
-    uint8_t leds[10];
+    uint8_t leds[BarDisplay::segments];
     uint8_t level = 0xff;
 
-    memset(leds, 0, 10);
+    memset(leds, 0, sizeof(leds));
 
     // We actually want to go in the opposite direction to the sweep dir,
     // as we're going to be building the 'trail' behind the head
@@ -254,13 +592,13 @@ void WaitState::sweep_leds(int led, int dir)
         led += dir;
 
         // Note that we need to explicitly handle out of bounds when doing
-        // bounce here, as the += dir above can move the led to -1 or 10.
+        // bounce here, as the += dir above can move the led off either end.
         if (led <= 0) {
             led = 0;
             dir = 1;
         }
-        if (led >= 9) {
-            led = 9;
+        if (led >= BarDisplay::segments - 1) {
+            led = BarDisplay::segments - 1;
             dir = -1;
         }
 
@@ -271,14 +609,25 @@ void WaitState::sweep_leds(int led, int dir)
     led_bar.setLeds(leds);
 }
 
-void WaitState::enter()
+State::StateID WaitState::enter(SwitchControl::Event event)
 {
-    State::enter();
+    State::enter(event);
 
     last_update = millis();
     sweep_led = 0;
     sweep_dir = 1;
     sweep_leds(0, 1);
+
+    // Let the switch LED breathe to draw attention to the finished cycle
+    led -> set_led_effect(LedEffects::EFFECT_BREATHE);
+
+#if !defined(USE_TINY_PROFILE)
+    if (buzzer) {
+        buzzer -> play(Buzzer::MELODY_FINISHED, alert_repeats, alert_gap);
+    }
+#endif
+
+    return STATE_NONE;
 }
 
 
@@ -289,17 +638,24 @@ State::StateID WaitState::update(SwitchControl::Event event)
         return newstate;
     }
 
-    if (event == SwitchControl::EVENT_PRESSED) {
+#if !defined(USE_TINY_PROFILE)
+    // Any touch of the button acknowledges the alert
+    if (buzzer && event != SwitchControl::EVENT_NONE) {
+        buzzer -> stop();
+    }
+#endif
+
+    if (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_DOUBLEPRESS) {
         return STATE_STARTUP;
     }
 
     // Update the sweep every 10th of a second
-    if ((unsigned long)(millis() - last_update) > 100) {
+    if ((state_millis_t)(millis() - last_update) > 100) {
         last_update = millis();
 
         // Move to the next LED, 'bouncing' off the ends
         sweep_led += sweep_dir;
-        if (sweep_led == 9) {
+        if (sweep_led == BarDisplay::segments - 1) {
             sweep_dir = -1;
         }
         if (sweep_led == 0) {
@@ -311,3 +667,14 @@ State::StateID WaitState::update(SwitchControl::Event event)
 
     return STATE_NONE;
 }
+
+
+#if !defined(USE_TINY_PROFILE)
+void WaitState::snapshot(Snapshot &snapshot)
+{
+    State::snapshot(snapshot);
+    snapshot.field(last_update);
+    snapshot.field(sweep_led);
+    snapshot.field(sweep_dir);
+}
+#endif
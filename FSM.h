@@ -31,13 +31,35 @@
 #ifndef FSM_H
 #define FSM_H
 
-#include <Grove_LED_Bar.h>
+#include "BarDisplay.h"
 #include "SwitchControl.h"
+#include "Clock.h"
+#include "CycleSensor.h"
+#include "CyclePredictor.h"
+#include "ProgramHistory.h"
+#include "RotaryEncoder.h"
+#include "Buzzer.h"
+#include "Trace.h"
+
+#if defined(USE_TINY_PROFILE)
+#include "MY9221Display.h"
+
+/** The display the states draw on. The tiny profile only ever has the one
+ *  bar driver, so the states call it directly rather than through the
+ *  virtual functions in BarDisplay.
+ */
+typedef MY9221Display StateDisplay;
+#else
+typedef BarDisplay StateDisplay;
+#endif
 
 /** The base class for states in the Finite State Machine. This implements
  *  the core functionality common to all states, and each state derived
  *  from it should override the enter() and update() functions to implement
  *  state-specific behaviours.
+ *
+ * @note The tiny profile leaves the optional peripherals out, so the states
+ *       ignore any they are given when it is defined.
  */
 class State
 {
@@ -61,20 +83,31 @@ public:
      *
      * @param state_id  The ID of the state being created.
      * @param button    A refrence to a button peripheral control object.
-     * @param led_bar   A reference to a LED bar control object.
+     * @param led_bar   A reference to a LED bar display object.
      * @return A new State object.
      */
-    State(StateID state_id, SwitchControl &button, Grove_LED_Bar &led_bar) :
-        state_id(state_id), button(button), led_bar(led_bar)
+    State(StateID state_id, SwitchControl &button, StateDisplay &led_bar) :
+        state_id(state_id), button(button), led(&button), led_bar(led_bar)
         { /* fnord */ };
 
 
     /** Actions to take when entering a state. Generally derived states should call
      *  this function in the base state to ensure that the state timer is set, and
-     *  then perform additional state-specific setup.
+     *  then perform additional state-specific setup. A state that knows on entry
+     *  that the machine should move straight on to another state can return
+     *  that state, and the machine will move on without waiting for the next
+     *  update.
+     *
+     *  @param event The event that caused the state machine to move into this
+     *               state, or EVENT_NONE if the move was not caused by an event.
+     *  @return The next state to move to in the FSM, or STATE_NONE to stay in
+     *          this state.
      */
-    virtual void enter() {
-        state_start_time = millis();
+    virtual StateID enter(SwitchControl::Event event) {
+        (void)event;
+        state_start_time = Clock::millis();
+
+        return STATE_NONE;
     }
 
 
@@ -91,12 +124,23 @@ public:
     virtual StateID update(SwitchControl::Event event);
 
 
-    /** Obtain the time that the state has been active.
+#if !defined(USE_TINY_PROFILE)
+    /** Save or restore the state's runtime context. Derived states with
+     *  context of their own should call this, then add their own fields.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    virtual void snapshot(Snapshot &snapshot);
+#endif
+
+
+    /** Obtain the time that the state has been active. This uses the
+     *  calibrated clock, so it stays accurate over long timer runs.
      *
      * @return The amount of time the state has been active, in milliseconds.
      */
-    unsigned long state_time() {
-        return millis() - state_start_time;
+    millis_t state_time() {
+        return Clock::millis() - state_start_time;
     };
 
 
@@ -108,12 +152,25 @@ public:
         return state_id;
     }
 
+
+    /** Set the LED the state shows its status on, in place of the switch's
+     *  own illumination LED, so that several machines can share the switch.
+     *
+     * @param led The LED to show the status on.
+     */
+    void set_led(SwitchLed &led) {
+        this -> led = &led;
+    }
+
 protected:
     SwitchControl &button;  //!< A reference to the button peripheral control object
-    Grove_LED_Bar &led_bar; //!< A reference to the LED bar control object
+    SwitchLed *led;         //!< The LED the state shows its status on, normally the button's own
+    StateDisplay &led_bar;    //!< A reference to the LED bar display object
+
+    static const millis_t max_state_time = 0x40000000UL; //!< The longest state_time() will report, about 12 days
 
     StateID state_id;               //!< The ID for the state
-    unsigned long state_start_time; //!< The time at which the state started, in millis
+    millis_t state_start_time;      //!< The time at which the state started, in millis
 };
 
 
@@ -124,110 +181,207 @@ protected:
 class OffState : public State
 {
 public:
-    OffState(SwitchControl &button, Grove_LED_Bar &led_bar) : State(STATE_OFF, button, led_bar)
+    OffState(SwitchControl &button, StateDisplay &led_bar) : State(STATE_OFF, button, led_bar)
         { /* fnord */ }
 
-    void enter();
+    StateID enter(SwitchControl::Event event);
 
     StateID update(SwitchControl::Event event);
 };
 
 /** Derived class implementating the STATE_STARTUP state. This turns on the
- *  control button LED, and fills in the LED bar one element at at time as a
- *  self-test. Once the bar has been filled, the update() function tells the
- *  state machine to move to the STATE_PROGRAM state.
+ *  control button LED, and the first time the state is entered after a cold
+ *  power-on it fills in the LED bar one element at at time as a self-test.
+ *  Once the bar has been filled, or straight away if no self-test is needed,
+ *  the update() function tells the state machine to move to the
+ *  STATE_PROGRAM state. Pressing the button during the self-test skips the
+ *  rest of it, and the press is passed on to the STATE_PROGRAM state.
  */
 class StartupState : public State
 {
 public:
-    StartupState(SwitchControl &button, Grove_LED_Bar &led_bar) : State(STATE_STARTUP, button, led_bar)
+    StartupState(SwitchControl &button, StateDisplay &led_bar) : State(STATE_STARTUP, button, led_bar),
+        self_test(true)
         { /* fnord */ }
 
-    void enter();
+    StateID enter(SwitchControl::Event event);
 
     StateID update(SwitchControl::Event event);
+
+#if !defined(USE_TINY_PROFILE)
+    void snapshot(Snapshot &snapshot);
+#endif
+
+
+    /** Set whether the self-test should be shown the next time the state is
+     *  entered. This is set by default, and cleared once the self-test has
+     *  been shown.
+     *
+     * @param enable `true` to show the self-test, `false` to skip it.
+     */
+    void set_self_test(bool enable) {
+        self_test = enable;
+    }
+
+private:
+    static const millis_t test_time = 1500;                         //!< How long the self-test lasts, in milliseconds
+    static const millis_t fill_step = 1000 / BarDisplay::segments; //!< How long the self-test takes to light each segment
+
+    bool self_test; //!< Should the self-test be shown when the state is next entered?
 };
 
 
 /** Derived class implementing the STATE_PROGRAM state. In this state, button
  *  presses by the user increase the number of lit bars in the LED bar, with
  *  each lit bar corresponding to a period of time the system should spend in
- *  the STATE_TIMER state (as determined by the 'bar_time' variable). If the
+ *  the STATE_TIMER state (as determined by the 'bar_time' variable). Holding
+ *  the button down keeps adding bars, faster the longer it is held. If the
  *  bar is filled, pressing the button again makes it wrap around to one bar.
  *  If the user does not press the button for more than `hold_time` milli,
  *  the selected bar elements flash on and off to indicate that the timer will
  *  be set soon, and after `timeout` milis the update() function tells the
- *  state machine to move to the STATE_TIMER state.
+ *  state machine to move to the STATE_TIMER state. If a cycle predictor is
+ *  available, the program the user selects most often is offered first.
+ *  If a program history is available, a double press as the first input
+ *  (including a double press that woke the system up) restarts the most
+ *  recently used program straight away. If a rotary encoder is available,
+ *  turning it also adds or removes bars, one per detent.
  */
 class ProgramState : public State
 {
 public:
     /** Create a new ProgramState object. Along with the TimerState constructor,
      *  this state constructor requires additional arguments - in particular, it
-     *  must be given a pointer to an unsigned long that can be shared with the
+     *  must be given a pointer to a millis_t that can be shared with the
      *  TimerState to pass the time the user has selected from the ProgramState
      *  to the TimerState.
      *
      * @param button     A refrence to a button peripheral control object.
-     * @param led_bar    A reference to a LED bar control object.
+     * @param led_bar    A reference to a LED bar display object.
      * @param total_time A pointer to a variable used to share the selected time
      *                   with the TimerState state.
+     * @param predictor  An optional pointer to a predictor used to pick the
+     *                   default program, and told which program is selected.
+     * @param history    An optional pointer to the history of recently used
+     *                   programs, used to restart the last program.
+     * @param encoder    An optional pointer to a rotary encoder that can be
+     *                   used to set the program instead of the button.
      * @param bar_time   How much time, in seconds, each bar adds to the time.
+     * @param hold_time  How long after the last input, in milliseconds, the
+     *                   selected bars start flashing.
+     * @param timeout    How long after the last input, in milliseconds, the
+     *                   timer is started.
      */
-    ProgramState(SwitchControl &button, Grove_LED_Bar &led_bar, unsigned long *total_time, unsigned long bar_time = 1800) : State(STATE_PROGRAM, button, led_bar),
-        total_time(total_time), bar_time(bar_time), program_time(0)
+    ProgramState(SwitchControl &button, StateDisplay &led_bar, millis_t *total_time, CyclePredictor *predictor = NULL, ProgramHistory *history = NULL,
+                 RotaryEncoder *encoder = NULL, uint32_t bar_time = 1800, millis_t hold_time = 2000, millis_t timeout = 4500) : State(STATE_PROGRAM, button, led_bar),
+        total_time(total_time), predictor(predictor), history(history), encoder(encoder), bar_time(bar_time), hold_time(hold_time), timeout(timeout), program_time(0), pressed(false), last_turn(0), flashing(false)
         { /* fnord */ }
 
-    void enter();
+    StateID enter(SwitchControl::Event event);
 
     StateID update(SwitchControl::Event event);
-private:
-    static const unsigned long hold_time = 2000; //!< Delay from last release before flashing the selected bars
-    static const unsigned long timeout   = 4500; //!< Delay from last release before switching to timer state
 
-    unsigned long *total_time;  //!< A pointer to a variable used to share the selected time with the TimerState state.
-    unsigned long bar_time;     //!< How much time, in seconds, each bar adds to the time.
-    unsigned long program_time; //!< How many bars the user has selected as the programmed time
+#if !defined(USE_TINY_PROFILE)
+    void snapshot(Snapshot &snapshot);
+#endif
+private:
+    /** Set the total time for the timer from the selected program, and
+     *  record the program in the predictor and history, if available.
+     */
+    void start_timer();
+
+    millis_t *total_time;       //!< A pointer to a variable used to share the selected time with the TimerState state.
+    CyclePredictor *predictor;  //!< A pointer to the cycle predictor, or NULL if there is no predictor
+    ProgramHistory *history;    //!< A pointer to the program history, or NULL if there is no history
+    RotaryEncoder *encoder;     //!< A pointer to the rotary encoder, or NULL if there is no encoder
+    uint32_t bar_time;          //!< How much time, in seconds, each bar adds to the time.
+    millis_t hold_time;         //!< Delay from last release before flashing the selected bars
+    millis_t timeout;           //!< Delay from last release before switching to timer state
+    uint8_t program_time;       //!< How many bars the user has selected as the programmed time
+    bool pressed;               //!< Has the user pressed the button since the state was entered?
+    millis_t last_turn;         //!< The last time the encoder was turned, in millis
+    bool flashing;              //!< Is the timer about to be set, with the LEDs flashing?
 };
 
 
+/** Derived class implementing the STATE_TIMER state. This fills the LED bar
+ *  as the time set in the STATE_PROGRAM state passes, and moves to the
+ *  STATE_WAIT state when the time is up. If a cycle sensor is available, and
+ *  it has seen the machine running, the state will also move to STATE_WAIT
+ *  as soon as the machine goes idle, if that is before the set time. The set
+ *  time is always the longest the timer runs for, whatever the sensor says.
+ *  Sensors that can tell when the machine is spinning also push the bar on
+ *  to show that the cycle is nearly over. If there is a cycle predictor, the
+ *  real duration is recorded whenever the sensor sees the end of the cycle,
+ *  and once it has learned how long the selected program really takes, the
+ *  bar fills over that time instead, as that is when the sensor is expected
+ *  to end the cycle. Without a sensor the bar always fills over the set time.
+ */
 class TimerState : public State
 {
 public:
     /** Create a new TimerState object. Along with the ProgramState constructor,
      *  this state constructor requires additional arguments - in particular, it
-     *  must be given a pointer to an unsigned long that can be shared with the
+     *  must be given a pointer to a millis_t that can be shared with the
      *  ProgramState to pass the time the user has selected from the ProgramState
      *  to the TimerState.
      *
      * @param button     A refrence to a button peripheral control object.
-     * @param led_bar    A reference to a LED bar control object.
+     * @param led_bar    A reference to a LED bar display object.
      * @param total_time A pointer to a variable containing the time set by the
      *                   ProgramState, in millis
+     * @param sensor     An optional pointer to a sensor that can detect when
+     *                   the machine has finished its cycle.
+     * @param predictor  An optional pointer to a predictor that learns how long
+     *                   programs really take.
      */
-    TimerState(SwitchControl &button, Grove_LED_Bar &led_bar, unsigned long *total_time) : State(STATE_TIMER, button, led_bar),
-        total_time(total_time), last_update(0)
+    TimerState(SwitchControl &button, StateDisplay &led_bar, millis_t *total_time, CycleSensor *sensor = NULL, CyclePredictor *predictor = NULL) : State(STATE_TIMER, button, led_bar),
+        total_time(total_time), sensor(sensor), predictor(predictor), last_update(0)
         { /* fnord */ }
 
-    void enter();
+    StateID enter(SwitchControl::Event event);
 
     StateID update(SwitchControl::Event event);
+
+#if !defined(USE_TINY_PROFILE)
+    void snapshot(Snapshot &snapshot);
+#endif
 private:
-    unsigned long *total_time; //!< A pointer to a variable containing the time set by the ProgramState, in millis
-    unsigned long last_update; //!< The last time the display was updated, in millis
+    millis_t *total_time;       //!< A pointer to a variable containing the time set by the ProgramState, in millis
+    CycleSensor *sensor;        //!< A pointer to the cycle sensor, or NULL if there is no sensor
+    CyclePredictor *predictor;  //!< A pointer to the cycle predictor, or NULL if there is no predictor
+    state_millis_t last_update; //!< The last time the display was updated, in millis
 };
 
 
+/** The state the system waits in after the timer finishes, animating the
+ *  LED bar until the user notices. If a buzzer is available, an alert is
+ *  also played when the state is entered, and repeated a few times until
+ *  the button is touched.
+ */
 class WaitState : public State
 {
 public:
-    WaitState(SwitchControl &button, Grove_LED_Bar &led_bar) : State(STATE_WAIT, button, led_bar)
+    /** Create a new WaitState object.
+     *
+     * @param button       A reference to the button control object.
+     * @param led_bar      A reference to the LED bar display.
+     * @param buzzer       An optional pointer to a buzzer to play the alert on.
+     * @param alert_repeats How many times the alert is repeated after the first.
+     * @param alert_gap    The time between alert repeats, in milliseconds.
+     */
+    WaitState(SwitchControl &button, StateDisplay &led_bar, Buzzer *buzzer = NULL, uint8_t alert_repeats = 4, millis_t alert_gap = 60000) : State(STATE_WAIT, button, led_bar),
+        buzzer(buzzer), alert_repeats(alert_repeats), alert_gap(alert_gap)
         { /* fnord */ }
 
-    void enter();
+    StateID enter(SwitchControl::Event event);
 
     StateID update(SwitchControl::Event event);
 
+#if !defined(USE_TINY_PROFILE)
+    void snapshot(Snapshot &snapshot);
+#endif
+
 private:
     /** Display a LED with a fading 'trail' on the LED bar. This sets the led
      *  at the specified position to full brightness, and then builds a trail
@@ -237,13 +391,17 @@ private:
      * @note This function relies on a modified version of the Grove_LED_Bar
      *       library that includes the `setLeds()` function.
      *
-     * @param led The LED to set to full brightness, range 0 to 9
+     * @param led The LED to set to full brightness, range 0 to
+     *            BarDisplay::segments - 1
      * @param dir The direction the brightest LED is 'moving', should be -1 or 1
      */
     void sweep_leds(int led, int dir);
 
-    unsigned long last_update;  //!< The last time the display was updated, in millis
-    int sweep_led;              //!< Which LED is currently the 'head' of the sweep (0 to 9)
+    Buzzer *buzzer;             //!< A pointer to the alert buzzer, or NULL if there is no buzzer
+    uint8_t alert_repeats;      //!< How many times the alert is repeated after the first
+    millis_t alert_gap;         //!< The time between alert repeats, in milliseconds
+    state_millis_t last_update; //!< The last time the display was updated, in millis
+    int sweep_led;              //!< Which LED is currently the 'head' of the sweep (0 to BarDisplay::segments - 1)
     int sweep_dir;              //!< Which direction the sweep is currently going (-1 or 1)
 };
 
@@ -253,18 +411,50 @@ private:
  *  track of possible states and which state is current, and relies on the
  *  state implementation update() functions to determine which state the
  *  machine should move to.
+ *
+ *  The machine also keeps usage metrics: how many times each transition
+ *  between states has happened, a histogram of how long each state was
+ *  active for, and how many requested transitions were rejected in each
+ *  state. All counters saturate rather than wrap, so metrics from several
+ *  machines can be merged by adding them together. The tiny profile has
+ *  no room for them, so leaves them out.
+ *
+ *  Transitions run to completion: if entering a state leads straight on to
+ *  another state, either because enter() returns one or because the new
+ *  state's update() makes a transition without needing an event, the
+ *  machine follows the whole chain in a single update(), up to a limit of
+ *  `max_microsteps` transitions.
  */
 class Machine
 {
 public:
+    static const uint8_t dwell_buckets  = 8; //!< The number of buckets in each dwell time histogram
+    static const uint8_t max_microsteps = State::STATE_MAX; //!< The most transitions followed in one update
+
+    /** Usage metrics for the state machine.
+     */
+    struct Metrics {
+        uint16_t transitions[State::STATE_MAX][State::STATE_MAX]; //!< Transition counts, indexed by [from][to]
+        uint16_t dwell[State::STATE_MAX][dwell_buckets];          //!< Dwell times: bucket 0 is under 1s, bucket N is up to 4^N s, the last is anything longer
+        uint16_t rejected[State::STATE_MAX];                      //!< Rejected set_state() calls, indexed by the state the machine was in
+        uint16_t limited;                                         //!< Times a chain of transitions hit max_microsteps
+    };
+
     /** Create a new, empty finite state machine. Before the state machine
      *  can be used for anything useful, states must be added using the
      *  add_state() function, and the initial state selected using set_state().
      *
+     * @param trace An optional pointer to a trace to record state changes in.
+     *              The tiny profile has no trace, or metrics, to keep.
      * @return A new state machine object.
      */
-    Machine() : current_state(State::StateID::STATE_NONE)
-        { /* fnord */ };
+#if defined(USE_TINY_PROFILE)
+    Machine() : current_state(State::StateID::STATE_NONE), microsteps(0)
+        { memset(states, 0, sizeof(states)); };
+#else
+    Machine(Trace *trace = NULL) : current_state(State::StateID::STATE_NONE), microsteps(0), trace(trace)
+        { memset(states, 0, sizeof(states)); memset(&metrics, 0, sizeof(metrics)); memset(worst_update, 0, sizeof(worst_update)); };
+#endif
 
     /** Add a new state implementation to the state machine. If a state
      *  implementation with the same ID is already in the FSM, it will
@@ -275,8 +465,17 @@ public:
     void add_state(State *state);
 
 
+    /** Make every state added so far show its status on a different LED
+     *  from the switch's own. See State::set_led().
+     *
+     * @param led The LED the states should show their status on.
+     */
+    void set_led(SwitchLed &led);
+
+
     /** Update the state machine. This will invoke the update function for the
-     *  current state, and potentially move the state machine into a new state.
+     *  current state, and potentially move the state machine into a new state,
+     *  following any further transitions that result straight away.
      *
      * @param event The last event generated by the button peripheral.
      */
@@ -286,14 +485,117 @@ public:
     /** Update the current state of the state machine, if needed. This will
      *  move the state machine into the specified state, if it is not already
      *  in that state, and the specified state is a valid, implemented state.
+     *  Attempts to move to STATE_NONE, or a state that is out of range or has
+     *  no implementation, are counted in the rejected metrics. As with
+     *  update(), any further transitions that result are followed straight
+     *  away.
      *
      * @param newstate The ID of the new state to move the machine to.
+     * @param event    The event that caused the move, passed on to the new
+     *                 state's enter() function.
+     */
+    void set_state(State::StateID newstate, SwitchControl::Event event = SwitchControl::EVENT_NONE);
+
+
+    /** Obtain the ID of the current state of the state machine.
+     *
+     * @return The ID of the current state, or STATE_NONE if no state has
+     *         been selected yet.
+     */
+    State::StateID get_state() {
+        return current_state;
+    }
+
+
+#if !defined(USE_TINY_PROFILE)
+    /** Obtain the usage metrics for the state machine.
+     *
+     * @return A reference to the metrics.
+     */
+    const Metrics &get_metrics() {
+        return metrics;
+    }
+#endif
+
+
+    /** Obtain the number of transitions made by the most recent update()
+     *  or set_state() call, for profiling.
+     *
+     * @return The number of transitions made.
+     */
+    uint8_t get_microsteps() {
+        return microsteps;
+    }
+
+
+#if !defined(USE_TINY_PROFILE)
+    /** Obtain the worst case update times. Each is the longest an update()
+     *  starting in that state has taken, including any transitions and
+     *  enter() calls it led to, so a rare slow path shows up even though
+     *  the average is fast.
+     *
+     * @return An array of the longest update time for each state, in
+     *         microseconds, saturating at 0xffff.
+     */
+    const uint16_t *get_worst_update() {
+        return worst_update;
+    }
+
+
+    /** Save or restore the runtime context of the machine and every state
+     *  in it, and the metrics.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
      */
-    void set_state(State::StateID newstate);
+    void snapshot(Snapshot &snapshot);
+#endif
 
 private:
+    /** Follow a chain of transitions, starting with a move to the specified
+     *  state, until a state is reached that wants to stay put.
+     *
+     * @param newstate The ID of the first state to move the machine to.
+     * @param event    The event that caused the first move.
+     */
+    void run(State::StateID newstate, SwitchControl::Event event);
+
+    /** Make a single transition, if the specified state is valid.
+     *
+     * @param newstate The ID of the new state to move the machine to.
+     * @param event    The event that caused the move.
+     * @return The state the new state's enter() function wants to move on to,
+     *         or STATE_NONE. STATE_NONE is also returned if the transition
+     *         was not made.
+     */
+    State::StateID transition(State::StateID newstate, SwitchControl::Event event);
+
+#if !defined(USE_TINY_PROFILE)
+    /** Increment a metrics counter, unless it is already at its maximum.
+     *
+     * @param counter The counter to increment.
+     */
+    static void count(uint16_t &counter) {
+        if (counter < 0xffff) {
+            ++counter;
+        }
+    }
+
+    /** Work out which dwell time histogram bucket a time should go in.
+     *
+     * @param time The time spent in a state, in milliseconds.
+     * @return The bucket the time belongs in.
+     */
+    static uint8_t dwell_bucket(millis_t time);
+#endif
+
     State::StateID current_state;             //!< The ID of the current state of the machine
     State *states[State::StateID::STATE_MAX]; //!< Storage for pointers to implementation objects for each state
+    uint8_t microsteps;                       //!< Transitions made by the most recent update
+#if !defined(USE_TINY_PROFILE)
+    Metrics metrics;                          //!< Usage metrics for the machine
+    uint16_t worst_update[State::STATE_MAX];  //!< The longest update() seen in each state, in microseconds
+    Trace *trace;                             //!< A pointer to the trace to record state changes in, or NULL
+#endif
 };
 
 
@@ -0,0 +1,91 @@
+/** @file
+ *  Definition of the GroveBarDisplay class. This file contains the definition
+ *  of a BarDisplay that draws on a Grove LED bar through the Grove_LED_Bar
+ *  library.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef GroveBarDisplay_H
+#define GroveBarDisplay_H
+
+#include <Arduino.h>
+#include <Grove_LED_Bar.h>
+#include "BarDisplay.h"
+
+/** A display that draws directly on a Grove LED bar. The bar is not set up
+ *  until the first time something is drawn on it, so that setup() doesn't
+ *  need to wait for it.
+ *
+ * @note This relies on a modified version of the Grove_LED_Bar library that
+ *       includes the `setLeds()` function.
+ *
+ * @note The sketch sets the bar up as an `LED_BAR_10`, so
+ *       `BarDisplay::segments` must be ten to use it.
+ */
+class GroveBarDisplay : public BarDisplay
+{
+public:
+    /** Create a new GroveBarDisplay object.
+     *
+     * @param bar A reference to the LED bar control object to draw on.
+     * @return A new GroveBarDisplay object.
+     */
+    GroveBarDisplay(Grove_LED_Bar &bar) : bar(bar), started(false)
+        { /* fnord */ }
+
+    void setLevel(float level) {
+        start();
+        bar.setLevel(level);
+    }
+
+    void setLeds(uint8_t *leds) {
+        start();
+        bar.setLeds(leds);
+    }
+
+    void snapshot(Snapshot &snapshot) {
+        snapshot.field(started);
+    }
+
+private:
+    /** Set up the LED bar, if it has not already been set up.
+     */
+    void start() {
+        if (!started) {
+            bar.begin();
+            started = true;
+        }
+    }
+
+    Grove_LED_Bar &bar; //!< A reference to the LED bar control object
+    bool started;       //!< Has the LED bar been set up?
+
+    static_assert(BarDisplay::segments == 10, "the sketch sets the Grove bar up as LED_BAR_10, so the bar must have ten segments");
+};
+
+#endif
@@ -0,0 +1,79 @@
+/** @file
+ *  Implementation of the HealthLog class. This file contains the
+ *  implementation of the class that keeps the switch health counters in EEPROM.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile keeps no health log
+#if !defined(USE_TINY_PROFILE)
+
+#include "HealthLog.h"
+#include "EepromWriter.h"
+
+void HealthLog::setup()
+{
+    Record record;
+
+    if (EepromWriter::get(eeprom_address, record) && record.magic == record_magic) {
+        button.set_health(record.health);
+    }
+
+    last_save = millis();
+}
+
+
+void HealthLog::update()
+{
+    if ((millis_t)(millis() - last_save) > interval) {
+        save();
+    }
+}
+
+
+void HealthLog::save()
+{
+    Record record;
+
+    record.magic  = record_magic;
+    record.health = button.get_health();
+
+    // If the write queue is full, try again on the next update
+    if (EepromWriter::put(eeprom_address, record)) {
+        last_save = millis();
+    }
+}
+
+
+void HealthLog::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(last_save);
+}
+
+#endif
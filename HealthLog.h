@@ -0,0 +1,102 @@
+/** @file
+ *  Definition of the HealthLog class. This file contains the definition of
+ *  a class that keeps the switch health counters in EEPROM.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef HealthLog_H
+#define HealthLog_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "SwitchControl.h"
+#include "Snapshot.h"
+
+/** A class to keep the health counters from a SwitchControl in EEPROM, so
+ *  that they build up over the whole life of the switch rather than being
+ *  lost at every power cycle. The counters are saved periodically rather
+ *  than on every change, to keep EEPROM wear down.
+ */
+class HealthLog
+{
+public:
+    /** Create a new HealthLog object.
+     *
+     * @param button         A reference to the switch whose counters should be kept.
+     * @param eeprom_address The EEPROM address the counters are stored at. This
+     *                       needs sizeof(HealthLog::Record) +
+     *                       EepromWriter::overhead bytes.
+     * @param interval       How often, in milliseconds, to save the counters.
+     * @return A new HealthLog object.
+     */
+    HealthLog(SwitchControl &button, int eeprom_address, millis_t interval = 3600000) :
+        button(button), eeprom_address(eeprom_address), interval(interval), last_save(0)
+        { /* fnord */ }
+
+
+    /** Load the counters from EEPROM into the switch. This should be called
+     *  once from the global setup() function.
+     */
+    void setup();
+
+
+    /** Save the counters to EEPROM if the save interval has passed.
+     */
+    void update();
+
+
+    /** Queue the counters to be saved to EEPROM now. Only bytes that have
+     *  changed since the last save are written.
+     */
+    void save();
+
+
+    /** The counters stored in EEPROM.
+     */
+    struct Record {
+        uint8_t magic;                 //!< Set to record_magic when the counters are valid
+        SwitchControl::Health health;  //!< The saved counters
+    };
+
+
+    /** Save or restore when the counters were last saved.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t record_magic = 0x4b; //!< Marker indicating the counters are valid
+
+    SwitchControl &button;   //!< A reference to the switch whose counters are kept
+    int eeprom_address;      //!< The address of the counters in EEPROM
+    millis_t interval;       //!< How often to save the counters, in millis
+    millis_t last_save;      //!< When the counters were last saved, in millis
+};
+
+#endif
@@ -0,0 +1,152 @@
+/** @file
+ *  Implementation of the LedEffects class. This file contains the
+ *  implementation of the class used to animate the switch LED with hardware PWM.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no LED effects
+#if !defined(USE_TINY_PROFILE)
+
+#include "LedEffects.h"
+#include <avr/pgmspace.h>
+
+// Half a breath, gamma corrected so the fade looks even to the eye. It's
+// played up and back down, so at 24 overflows per step a breath takes 3s.
+static const uint8_t breathe_table[] PROGMEM = {
+      2,   2,   2,   2,   2,   3,   3,   4,   6,   9,  13,  17,  24,  31,  40,  51,
+     63,  77,  92, 108, 125, 142, 159, 176, 193, 208, 221, 233, 242, 249, 254, 255
+};
+
+// On then off, with 122 overflows per step for a quarter of a second each,
+// to match the bar flashing in the program state.
+static const uint8_t blink_table[] PROGMEM = {
+    255, 0
+};
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+
+// The effects engine overflows should be passed to, set by start()
+static LedEffects *overflow_effects = NULL;
+
+ISR(TIMER2_OVF_vect)
+{
+    if (overflow_effects) {
+        overflow_effects -> advance();
+    }
+}
+#endif
+
+
+void LedEffects::start(Effect effect)
+{
+#if defined(__AVR__)
+    // Stop the interrupt while the waveform is switched over
+    TIMSK2 &= ~_BV(TOIE2);
+
+    switch (effect) {
+        case EFFECT_BREATHE:
+            table   = breathe_table;
+            length  = sizeof(breathe_table);
+            divider = 24;
+            mirror  = true;
+            break;
+
+        case EFFECT_BLINK:
+            table   = blink_table;
+            length  = sizeof(blink_table);
+            divider = 122;
+            mirror  = false;
+            break;
+    }
+
+    ticks     = 0;
+    position  = 0;
+    direction = 1;
+    overflow_effects = this;
+
+    // Show the first entry, and connect OC2B to the pin. This is what
+    // analogWrite() does, except that it won't use PWM for 0 or 255.
+    OCR2B   = pgm_read_byte(table);
+    TCCR2A |= _BV(COM2B1);
+    TIMSK2 |= _BV(TOIE2);
+#else
+    (void)effect;
+    digitalWrite(led_pin, HIGH);
+#endif
+}
+
+
+void LedEffects::stop()
+{
+#if defined(__AVR__)
+    TIMSK2 &= ~_BV(TOIE2);
+    TCCR2A &= ~_BV(COM2B1);
+#endif
+}
+
+
+void LedEffects::advance()
+{
+    if (++ticks < divider) {
+        return;
+    }
+    ticks = 0;
+
+    // Move to the next entry, either bouncing off or wrapping at the ends
+    if (mirror) {
+        if ((direction > 0 && position == length - 1) || (direction < 0 && position == 0)) {
+            direction = -direction;
+        }
+        position += direction;
+    } else if (++position == length) {
+        position = 0;
+    }
+
+#if defined(__AVR__)
+    OCR2B = pgm_read_byte(table + position);
+#endif
+}
+
+
+void LedEffects::snapshot(Snapshot &snapshot)
+{
+    noInterrupts();
+    snapshot.field(table);
+    snapshot.field(length);
+    snapshot.field(divider);
+    snapshot.field(mirror);
+    snapshot.field(ticks);
+    snapshot.field(position);
+    snapshot.field(direction);
+    interrupts();
+}
+
+#endif
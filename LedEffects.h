@@ -0,0 +1,116 @@
+/** @file
+ *  Definition of the LedEffects class. This file contains the definition
+ *  of the class used to animate the switch LED with hardware PWM.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef LedEffects_H
+#define LedEffects_H
+
+#include <Arduino.h>
+#include "Snapshot.h"
+
+/** A class to animate the illumination LED in the switch without any work
+ *  from the main loop. The LED brightness is set by Timer2's hardware PWM on
+ *  output compare B, and the timer's overflow interrupt steps through a
+ *  small waveform table in program memory, writing each entry into the
+ *  compare register. Once an effect has been started, it carries on until
+ *  it is stopped or replaced.
+ *
+ * @note The LED must be on OC2B, which is digital pin 3 on an Uno. Timer2 is
+ *       left in the phase correct PWM mode the Arduino core sets it up in,
+ *       so it overflows roughly every 2ms.
+ *
+ * @note On non-AVR (host) builds there is no PWM, and effects just turn the
+ *       LED on.
+ */
+class LedEffects
+{
+public:
+    /** The effects that can be shown on the LED.
+     */
+    enum Effect {
+        EFFECT_BREATHE,   //!< Slowly fade up and down, about every three seconds.
+        EFFECT_BLINK,     //!< Flash on and off, a quarter of a second each.
+    };
+
+    /** Create a new LedEffects object.
+     *
+     * @param led_pin The digital pin the LED is connected to. This must be
+     *                the pin for OC2B.
+     * @return A new LedEffects object.
+     */
+    LedEffects(uint8_t led_pin) :
+        led_pin(led_pin), table(NULL), length(0), divider(0), mirror(false),
+        ticks(0), position(0), direction(1)
+        { /* fnord */ }
+
+
+    /** Start showing an effect on the LED, replacing any effect already
+     *  being shown. The effect starts from the beginning of its waveform.
+     *
+     * @param effect The effect to show.
+     */
+    void start(Effect effect);
+
+
+    /** Stop any effect being shown, and release the LED pin for normal
+     *  digital output. The LED is left at whatever brightness it had.
+     */
+    void stop();
+
+
+    /** Step the effect on by one timer overflow. This is called from the
+     *  overflow interrupt on AVR builds, and must be kept short.
+     */
+    void advance();
+
+
+    /** Save or restore the waveform being played and how far it has got. The
+     *  timer registers aren't included, as they belong to the board.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    uint8_t led_pin;              //!< The digital pin the LED is connected to
+
+    // The waveform being played, set up by start() before the interrupt is enabled
+    const uint8_t *table;         //!< The waveform table in program memory
+    uint8_t length;               //!< How many entries there are in the table
+    uint8_t divider;              //!< How many overflows each entry is shown for
+    bool mirror;                  //!< Play the table back and forth rather than looping
+
+    // Playback position, only touched by the interrupt once running
+    uint8_t ticks;                //!< Overflows since the current entry was shown
+    uint8_t position;             //!< The table entry being shown
+    int8_t direction;             //!< Which way through the table playback is going
+};
+
+#endif
@@ -0,0 +1,159 @@
+/** @file
+ *  Implementation of the MY9221Display class. This file contains the
+ *  implementation of a small built-in driver for LED bars, like the Grove
+ *  bar, that are driven by a MY9221 LED driver chip.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "MY9221Display.h"
+
+void MY9221Display::setLevel(float level)
+{
+    // Only this conversion needs floating point, everything after it is
+    // done in steps of a segment
+    if (level <= 0.0f) {
+        setSteps(0);
+    } else if (level >= BarDisplay::segments) {
+        setSteps(BarDisplay::segments * BarDisplay::steps);
+    } else {
+        setSteps((uint16_t)(level * BarDisplay::steps));
+    }
+}
+
+
+void MY9221Display::setSteps(uint16_t level)
+{
+    uint8_t leds[BarDisplay::segments];
+    uint16_t remaining = level;
+
+    // Each step of a partly lit segment doubles its brightness, as the eye
+    // sees the difference between low brightnesses far more than high ones
+    for (uint8_t led = 0; led < BarDisplay::segments; ++led) {
+        uint8_t lit = (remaining > BarDisplay::steps) ? BarDisplay::steps : remaining;
+
+        leds[led] = (uint8_t)~(0xff << lit);
+        remaining -= lit;
+    }
+
+    setLeds(leds);
+}
+
+
+void MY9221Display::setLeds(uint8_t *leds)
+{
+    start();
+
+    send(command);
+    for (uint8_t led = 0; led < BarDisplay::segments; ++led) {
+        send(leds[reversed ? BarDisplay::segments - 1 - led : led]);
+    }
+
+    // Every output has to be sent before the chip will latch
+    for (uint8_t unused = BarDisplay::segments; unused < channels; ++unused) {
+        send(0);
+    }
+
+    latch();
+}
+
+
+void MY9221Display::start()
+{
+    if (clock_port) {
+        return;
+    }
+
+    pinMode(clock_pin, OUTPUT);
+    pinMode(data_pin, OUTPUT);
+
+    clock_port = portOutputRegister(digitalPinToPort(clock_pin));
+    clock_mask = digitalPinToBitMask(clock_pin);
+    data_port  = portOutputRegister(digitalPinToPort(data_pin));
+    data_mask  = digitalPinToBitMask(data_pin);
+}
+
+
+void MY9221Display::send(uint16_t data)
+{
+    // The chip reads a bit on every edge of the clock, rising or falling,
+    // so the clock only needs toggling once per bit
+    for (uint16_t bit = 0x8000; bit; bit >>= 1) {
+        set_data(data & bit);
+        toggle_clock();
+    }
+}
+
+
+void MY9221Display::latch()
+{
+    set_data(false);
+    delayMicroseconds(latch_delay);
+
+    // Four pulses on the data line, with the clock held still, latch the data
+    for (uint8_t pulse = 0; pulse < 4; ++pulse) {
+        set_data(true);
+        set_data(false);
+    }
+}
+
+
+void MY9221Display::set_data(bool high)
+{
+#if defined(__AVR__)
+    if (high) {
+        *data_port |= data_mask;
+    } else {
+        *data_port &= ~data_mask;
+    }
+#else
+    digitalWrite(data_pin, high ? HIGH : LOW);
+#endif
+}
+
+
+void MY9221Display::toggle_clock()
+{
+#if defined(__AVR__)
+    *clock_port ^= clock_mask;
+#else
+    digitalWrite(clock_pin, (*clock_port & clock_mask) ? LOW : HIGH);
+#endif
+}
+
+
+#if !defined(USE_TINY_PROFILE)
+void MY9221Display::snapshot(Snapshot &snapshot)
+{
+    // The ports are only set once the pins have been set up
+    snapshot.field(clock_port);
+    snapshot.field(data_port);
+    snapshot.field(clock_mask);
+    snapshot.field(data_mask);
+}
+#endif
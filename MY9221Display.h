@@ -0,0 +1,128 @@
+/** @file
+ *  Definition of the MY9221Display class. This file contains the definition
+ *  of a small built-in driver for LED bars, like the Grove bar, that are
+ *  driven by a MY9221 LED driver chip.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef MY9221Display_H
+#define MY9221Display_H
+
+#include <Arduino.h>
+#include "BarDisplay.h"
+
+/** A display that drives a MY9221 based LED bar directly, without needing
+ *  the Grove_LED_Bar library. On AVR builds the pins are written through
+ *  their port registers rather than with digitalWrite(), and levels are
+ *  worked out in eighths of a segment with integer maths, so this is a good
+ *  deal smaller and quicker than GroveBarDisplay; it is meant for parts
+ *  with little flash and RAM to spare. Nothing derives from it, so the tiny
+ *  profile's states can call it directly instead of through BarDisplay. Like GroveBarDisplay, the bar is not
+ *  set up until the first time something is drawn on it. The sketch only
+ *  uses it in place of GroveBarDisplay if `USE_MY9221_DISPLAY` is defined.
+ *
+ * @note The chip has twelve outputs, so `BarDisplay::segments` must not be
+ *       more than twelve. Outputs past the end of the bar are kept off.
+ */
+class MY9221Display final : public BarDisplay
+{
+public:
+    /** Create a new MY9221Display object.
+     *
+     * @param clock_pin The pin connected to the bar's clock input.
+     * @param data_pin  The pin connected to the bar's data input.
+     * @param reversed  If true, the bar fills from the other end, as the
+     *                  Grove bar does when it is set to go green to red.
+     * @return A new MY9221Display object.
+     */
+    MY9221Display(uint8_t clock_pin, uint8_t data_pin, bool reversed = false) :
+        clock_pin(clock_pin), data_pin(data_pin), reversed(reversed), clock_port(NULL), data_port(NULL), clock_mask(0), data_mask(0)
+        { /* fnord */ }
+
+    void setLevel(float level);
+
+    /** Light the bar up to a level given in steps of a segment. This is
+     *  what setLevel() draws with, and needs no floating point, so callers
+     *  that can work the level out in steps should use it instead.
+     *
+     * @param level The level to show, from 0 (all off) to
+     *              `BarDisplay::segments * BarDisplay::steps` (all on).
+     */
+    void setSteps(uint16_t level);
+
+    void setLeds(uint8_t *leds);
+
+#if !defined(USE_TINY_PROFILE)
+    void snapshot(Snapshot &snapshot);
+#endif
+
+private:
+    static const uint8_t  channels    = 12;     //!< The number of outputs the MY9221 has
+    static const uint16_t command     = 0x0000; //!< The command word selecting 8 bit greyscale
+    static const uint16_t latch_delay = 220;    //!< How long the data line must be still before a latch, in microseconds
+
+    static_assert(BarDisplay::segments <= channels, "the MY9221 can't drive more than twelve segments");
+    static_assert(BarDisplay::steps == 8, "each step of a segment is drawn as one of its eight brightness steps");
+
+    /** Set up the pins, if they have not already been set up.
+     */
+    void start();
+
+    /** Clock a 16 bit word out to the bar, most significant bit first.
+     *
+     * @param data The word to send.
+     */
+    void send(uint16_t data);
+
+    /** Latch the words sent so far onto the bar's outputs.
+     */
+    void latch();
+
+    /** Set the level of the data pin. On AVR builds this writes the port
+     *  register directly; elsewhere it goes through digitalWrite(), so that
+     *  host builds can watch the bus.
+     *
+     * @param high `true` to set the pin high, `false` to set it low.
+     */
+    void set_data(bool high);
+
+    /** Change the level of the clock pin, which clocks in one bit.
+     */
+    void toggle_clock();
+
+    uint8_t clock_pin;            //!< The pin connected to the bar's clock input
+    uint8_t data_pin;             //!< The pin connected to the bar's data input
+    bool reversed;                //!< Does the bar fill from the other end?
+    volatile uint8_t *clock_port; //!< The output register for the clock pin, or NULL before start()
+    volatile uint8_t *data_port;  //!< The output register for the data pin, or NULL before start()
+    uint8_t clock_mask;           //!< The bit for the clock pin in its output register
+    uint8_t data_mask;            //!< The bit for the data pin in its output register
+};
+
+#endif
@@ -0,0 +1,50 @@
+/** @file
+ *  Compile time profiles for the sketch. This file selects how much of the
+ *  project is built, so that every file agrees on it.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Profile_H
+#define Profile_H
+
+// The tiny profile builds only what the timer itself needs, for parts such
+// as the ATtiny85 with 8K of flash and 512 bytes of RAM: the switch, the
+// state machine, the clock, and the bar driven by MY9221Display. The
+// console, trace, FSM metrics, snapshots, LED effects and the optional
+// peripherals are left out, the states draw on the bar without virtual
+// calls or floating point, and short intervals are timed in 16 bits.
+// Every file must agree on the profile, so define this here, or for the
+// whole build, rather than in the sketch.
+// #define USE_TINY_PROFILE
+
+// The tiny profile has no room for the Grove library
+#if defined(USE_TINY_PROFILE) && !defined(USE_MY9221_DISPLAY)
+#define USE_MY9221_DISPLAY
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/** @file
+ *  Implementation of the ProgramHistory class. This file contains the
+ *  implementation of the class that remembers the most recently used programs.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile keeps no program history
+#if !defined(USE_TINY_PROFILE)
+
+#include "ProgramHistory.h"
+#include "EepromWriter.h"
+
+void ProgramHistory::setup()
+{
+    bool valid = EepromWriter::get(eeprom_address, history);
+
+    if (!valid || history.magic != history_magic) {
+        memset(&history, 0, sizeof(history));
+        history.magic = history_magic;
+
+        EepromWriter::put(eeprom_address, history);
+    }
+}
+
+
+void ProgramHistory::record(uint8_t bars)
+{
+    history.head = (history.head + 1) % entries;
+    history.programs[history.head] = bars;
+
+    // The program and head are committed together, so a power cut can't
+    // expose a stale program as the newest.
+    EepromWriter::put(eeprom_address, history);
+}
+
+
+uint8_t ProgramHistory::get(uint8_t age)
+{
+    if (age >= entries) {
+        return 0;
+    }
+
+    return history.programs[(history.head + entries - age) % entries];
+}
+
+
+void ProgramHistory::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(history);
+}
+
+#endif
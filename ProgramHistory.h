@@ -0,0 +1,107 @@
+/** @file
+ *  Definition of the ProgramHistory class. This file contains the definition
+ *  of a class that remembers the most recently used programs in EEPROM.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ProgramHistory_H
+#define ProgramHistory_H
+
+#include <Arduino.h>
+#include "Snapshot.h"
+
+/** A class to remember the most recently used programs. Programs are
+ *  identified by the number of bars selected in the ProgramState, and the
+ *  last few are kept in a small ring buffer in EEPROM so that the most recent
+ *  program can be restarted without programming it again, even after the
+ *  power has been off.
+ */
+class ProgramHistory
+{
+public:
+    static const uint8_t entries = 4; //!< How many programs are remembered
+
+    /** Create a new ProgramHistory object.
+     *
+     * @param eeprom_address The EEPROM address the history is stored at. This
+     *                       needs sizeof(ProgramHistory::History) +
+     *                       EepromWriter::overhead bytes.
+     * @return A new ProgramHistory object.
+     */
+    ProgramHistory(int eeprom_address) :
+        eeprom_address(eeprom_address)
+        { /* fnord */ }
+
+
+    /** Load the history from EEPROM. If the EEPROM does not contain a valid
+     *  history, the history starts out empty. This should be called once
+     *  from the global setup() function.
+     */
+    void setup();
+
+
+    /** Add a program to the history, discarding the oldest program if the
+     *  history is full.
+     *
+     * @param bars The number of bars selected by the user.
+     */
+    void record(uint8_t bars);
+
+
+    /** Obtain a program from the history.
+     *
+     * @param age How far back in the history to look, 0 is the most recent.
+     * @return The number of bars in the program, or 0 if there is no program
+     *         that far back in the history.
+     */
+    uint8_t get(uint8_t age = 0);
+
+
+    /** The history stored in EEPROM.
+     */
+    struct History {
+        uint8_t magic;            //!< Set to history_magic when the history is valid
+        uint8_t head;             //!< The slot the most recent program is stored in
+        uint8_t programs[entries]; //!< The programs, in bars, 0 for an empty slot
+    };
+
+
+    /** Save or restore the copy of the history.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t history_magic = 0x9e; //!< Marker indicating the history is valid
+
+    int eeprom_address; //!< The address of the history in EEPROM
+    History history;    //!< A copy of the history stored in EEPROM
+};
+
+#endif
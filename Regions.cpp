@@ -0,0 +1,223 @@
+/** @file
+ *  Implementation of the Regions class. This file contains the implementation
+ *  of the container that runs several independent state machines side by
+ *  side, and the event routing policies it can use.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile only has the one machine, drawing on the whole bar
+#if !defined(USE_TINY_PROFILE)
+
+#include "Regions.h"
+
+/* ------------------------------------------------------------------------
+ *  EventRouter
+ */
+
+uint8_t EventRouter::led_owner(Machine **regions, uint8_t count)
+{
+    for (uint8_t region = 0; region < count; ++region) {
+        if (regions[region] -> get_state() != State::STATE_OFF) {
+            return region;
+        }
+    }
+
+    return 0;
+}
+
+
+/* ------------------------------------------------------------------------
+ *  BroadcastRouter
+ */
+
+uint8_t BroadcastRouter::route(SwitchControl::Event event, Machine **regions, uint8_t count)
+{
+    (void)regions;
+
+    return (event == SwitchControl::EVENT_NONE) ? 0 : (uint8_t)((1U << count) - 1);
+}
+
+
+/* ------------------------------------------------------------------------
+ *  FocusRouter
+ */
+
+uint8_t FocusRouter::find(State::StateID state, Machine **regions, uint8_t count)
+{
+    uint8_t region;
+
+    for (region = 0; region < count; ++region) {
+        if (regions[region] -> get_state() == state) {
+            break;
+        }
+    }
+
+    return region;
+}
+
+
+uint8_t FocusRouter::route(SwitchControl::Event event, Machine **regions, uint8_t count)
+{
+    if (event == SwitchControl::EVENT_NONE || !count) {
+        return 0;
+    }
+
+    // A region that is being set up keeps the focus until it's done
+    uint8_t region = find(State::STATE_PROGRAM, regions, count);
+    if (region == count) {
+        region = find(State::STATE_STARTUP, regions, count);
+    }
+
+    // Otherwise presses start the next load, in a finished region if
+    // possible so that it gets emptied first.
+    if (region == count && (event == SwitchControl::EVENT_PRESSED || event == SwitchControl::EVENT_DOUBLEPRESS)) {
+        region = find(State::STATE_WAIT, regions, count);
+        if (region == count) {
+            region = find(State::STATE_OFF, regions, count);
+        }
+    }
+
+    if (region < count) {
+        focus = region;
+    }
+
+    return 1 << focus;
+}
+
+
+uint8_t FocusRouter::led_owner(Machine **regions, uint8_t count)
+{
+    uint8_t region = find(State::STATE_PROGRAM, regions, count);
+    if (region == count) {
+        region = find(State::STATE_STARTUP, regions, count);
+    }
+    if (region == count) {
+        region = find(State::STATE_WAIT, regions, count);
+    }
+    if (region == count && focus < count && regions[focus] -> get_state() != State::STATE_OFF) {
+        region = focus;
+    }
+
+    return (region < count) ? region : EventRouter::led_owner(regions, count);
+}
+
+
+/* ------------------------------------------------------------------------
+ *  RegionLed
+ */
+
+void RegionLed::set_led_state(bool state)
+{
+    effect  = false;
+    value   = state;
+    changed = true;
+}
+
+
+void RegionLed::set_led_effect(LedEffects::Effect effect)
+{
+    this -> effect = true;
+    value          = effect;
+    changed        = true;
+}
+
+
+void RegionLed::show(SwitchLed &output)
+{
+    if (effect) {
+        output.set_led_effect((LedEffects::Effect)value);
+    } else {
+        output.set_led_state(value);
+    }
+
+    changed = false;
+}
+
+
+/* ------------------------------------------------------------------------
+ *  Regions
+ */
+
+void Regions::add_region(Machine *machine)
+{
+    if (count < max_regions) {
+        regions[count] = machine;
+
+        if (led) {
+            machine -> set_led(leds[count]);
+        }
+
+        if (machine -> get_state() != State::STATE_OFF) {
+            active |= 1 << count;
+        }
+
+        ++count;
+    }
+}
+
+
+void Regions::update(SwitchControl::Event event)
+{
+    routed = router.route(event, regions, count);
+    uint8_t pending = active | routed;
+
+    // Only step the regions that are doing something, or have an event
+    for (uint8_t region = 0; pending; ++region, pending >>= 1) {
+        if (!(pending & 1)) {
+            continue;
+        }
+
+        uint8_t bit = 1 << region;
+        regions[region] -> update((routed & bit) ? event : SwitchControl::EVENT_NONE);
+
+        if (regions[region] -> get_state() == State::STATE_OFF) {
+            active &= ~bit;
+        } else {
+            active |= bit;
+        }
+    }
+
+    if (composite) {
+        composite -> flush();
+    }
+
+    // Only touch the switch's LED when something new is to be shown on it,
+    // as showing an effect starts it again from the beginning
+    if (led && count) {
+        uint8_t owner = router.led_owner(regions, count);
+
+        if (owner != led_owner || leds[owner].is_changed()) {
+            leds[owner].show(*led);
+            led_owner = owner;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,233 @@
+/** @file
+ *  Definition of the Regions class. This file contains the definition of a
+ *  container that runs several independent state machines side by side,
+ *  sharing one control switch and one LED bar.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Regions_H
+#define Regions_H
+
+#include "FSM.h"
+
+/** The base class for event routing policies. When several state machines
+ *  share one control switch, the router decides which of them should see
+ *  each event generated by the switch.
+ */
+class EventRouter
+{
+public:
+    /** Decide which regions should receive an event.
+     *
+     * @param event   The event generated by the control switch.
+     * @param regions An array of pointers to the state machine in each region.
+     * @param count   The number of regions.
+     * @return A bitmask with bit N set if region N should receive the event.
+     */
+    virtual uint8_t route(SwitchControl::Event event, Machine **regions, uint8_t count) = 0;
+
+
+    /** Decide which region the switch's LED should show the status of. By
+     *  default this is the first region that isn't off, or the first region
+     *  if they all are.
+     *
+     * @param regions An array of pointers to the state machine in each region.
+     * @param count   The number of regions.
+     * @return The index of the region that owns the LED.
+     */
+    virtual uint8_t led_owner(Machine **regions, uint8_t count);
+};
+
+
+/** A routing policy that sends every event to every region.
+ */
+class BroadcastRouter : public EventRouter
+{
+public:
+    uint8_t route(SwitchControl::Event event, Machine **regions, uint8_t count);
+};
+
+
+/** A routing policy that sends events to a single region at a time. A region
+ *  that is starting up or being programmed always has the focus. Otherwise,
+ *  a press goes to the first region waiting to be emptied, or failing that
+ *  the first region that is off, so that pressing the button starts the next
+ *  load. Any other event goes to the region that last had the focus, so that
+ *  a long press cancels the most recently programmed timer.
+ */
+class FocusRouter : public EventRouter
+{
+public:
+    FocusRouter() : focus(0)
+        { /* fnord */ }
+
+    uint8_t route(SwitchControl::Event event, Machine **regions, uint8_t count);
+
+
+    /** The LED shows the status of a region being set up, or failing that
+     *  one waiting to be emptied, as those are what the switch acts on next.
+     *  Otherwise it shows the region with the focus, unless that is off, in
+     *  which case it falls back to the first region that is running.
+     */
+    uint8_t led_owner(Machine **regions, uint8_t count);
+
+private:
+    /** Find the first region in a given state.
+     *
+     * @param state   The ID of the state to look for.
+     * @param regions An array of pointers to the state machine in each region.
+     * @param count   The number of regions.
+     * @return The index of the first region in the state, or count if no
+     *         regions are in the state.
+     */
+    uint8_t find(State::StateID state, Machine **regions, uint8_t count);
+
+    uint8_t focus; //!< The index of the region that last had the focus
+};
+
+
+/** The switch's LED as seen by the states in one region. The states set it
+ *  as they would the switch's own LED, and it remembers what they asked
+ *  for, so that Regions can show it on the switch while the region owns
+ *  the LED, and show it again when the region gets the LED back.
+ */
+class RegionLed : public SwitchLed
+{
+public:
+    RegionLed() : effect(false), value(0), changed(true)
+        { /* fnord */ }
+
+    void set_led_state(bool state);
+
+    void set_led_effect(LedEffects::Effect effect);
+
+
+    /** Show what the region's states asked for on an LED.
+     *
+     * @param output The LED to show it on.
+     */
+    void show(SwitchLed &output);
+
+
+    /** Find out whether the region's states have asked for anything since
+     *  it was last shown.
+     *
+     * @return `true` if it needs showing again, `false` if not.
+     */
+    bool is_changed() {
+        return changed;
+    }
+
+private:
+    bool effect;   //!< Did the states ask for an effect, rather than on or off?
+    uint8_t value; //!< The effect they asked for, or whether the LED is on
+    bool changed;  //!< Have they asked for anything since it was last shown?
+};
+
+
+/** A container for several orthogonal regions, each of which is an
+ *  independent state machine with its own set of states. This allows, for
+ *  example, a washer and a dryer to be timed at the same time. Every region
+ *  is driven from a single update() call, with the events from the control
+ *  switch handed out by a routing policy, and each region should draw on a
+ *  SegmentDisplay so that all the regions share one LED bar. Each region's
+ *  states are given their own RegionLed, and the routing policy decides
+ *  which of them the switch's LED shows.
+ *
+ *  Regions that are off and not receiving an event have nothing to do, so
+ *  only the active regions, and any region receiving an event, are updated.
+ */
+class Regions
+{
+public:
+    static const uint8_t max_regions = 8; //!< The most regions that can be added
+
+    /** Create a new, empty set of regions.
+     *
+     * @param router    The policy used to decide which regions see each event.
+     * @param composite The composite display the regions' segments draw into,
+     *                  or NULL if the regions do not share a display.
+     * @param led       The switch's LED, normally the SwitchControl, which
+     *                  the regions' states take turns to show their status
+     *                  on. If this is NULL, the states drive whatever LED
+     *                  they were given.
+     * @return A new Regions object.
+     */
+    Regions(EventRouter &router, CompositeDisplay *composite = NULL, SwitchLed *led = NULL) :
+        router(router), composite(composite), led(led), count(0), active(0), routed(0), led_owner(max_regions)
+        { /* fnord */ }
+
+
+    /** Add a region. The state machine should already have its states added,
+     *  and its initial state selected. If the regions share the switch's
+     *  LED, the states are moved onto the region's own RegionLed.
+     *
+     * @param machine A pointer to the state machine for the region.
+     */
+    void add_region(Machine *machine);
+
+
+    /** Update the regions. This routes the event to the appropriate regions,
+     *  updates every active region, and then redraws the shared display.
+     *
+     * @param event The last event generated by the button peripheral.
+     */
+    void update(SwitchControl::Event event);
+
+
+    /** Obtain which regions the event given to the last update() went to.
+     *
+     * @return A bitmask with bit N set if region N was given the event.
+     */
+    uint8_t get_routed() {
+        return routed;
+    }
+
+
+    /** Obtain the region whose status the switch's LED is showing.
+     *
+     * @return The index of the region, or max_regions if the LED isn't
+     *         shared or nothing has been shown on it yet.
+     */
+    uint8_t get_led_owner() {
+        return led_owner;
+    }
+
+private:
+    EventRouter &router;           //!< The policy used to decide which regions see each event
+    CompositeDisplay *composite;   //!< The composite display shared by the regions, if any
+    SwitchLed *led;                //!< The switch's LED shared by the regions, if any
+    Machine *regions[max_regions]; //!< The state machine for each region
+    RegionLed leds[max_regions];   //!< The LED as each region's states see it
+    uint8_t count;                 //!< How many regions have been added
+    uint8_t active;                //!< A bitmask of regions that are not in the off state
+    uint8_t routed;                //!< A bitmask of the regions given the last event
+    uint8_t led_owner;             //!< The region shown on the switch's LED
+};
+
+#endif
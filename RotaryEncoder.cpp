@@ -0,0 +1,129 @@
+/** @file
+ *  Implementation of the RotaryEncoder class. This file contains the
+ *  implementation of the class used to read a quadrature rotary encoder.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no encoder
+#if !defined(USE_TINY_PROFILE)
+
+#include "RotaryEncoder.h"
+
+// Valid quadrature sequences are 00 -> 01 -> 11 -> 10 -> 00 in one
+// direction, and the reverse in the other. Anything else is either no
+// change, or a skipped state that can't be given a direction.
+const int8_t RotaryEncoder::transitions[16] = {
+     0, -1,  1,  0,
+     1,  0,  0, -1,
+    -1,  0,  0,  1,
+     0,  1, -1,  0
+};
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+
+// The encoder pin changes should be passed to, set by the most recent setup()
+static RotaryEncoder *pcint_encoder = NULL;
+
+ISR(PCINT2_vect)
+{
+    if (pcint_encoder) {
+        pcint_encoder -> add_transition(pcint_encoder -> outputs());
+    }
+}
+#endif
+
+
+void RotaryEncoder::setup()
+{
+    pinMode(pin_a, INPUT_PULLUP);
+    pinMode(pin_b, INPUT_PULLUP);
+    state = outputs();
+
+#if defined(__AVR__)
+    pcint_encoder = this;
+
+    *digitalPinToPCMSK(pin_a) |= _BV(digitalPinToPCMSKbit(pin_a));
+    *digitalPinToPCMSK(pin_b) |= _BV(digitalPinToPCMSKbit(pin_b));
+    *digitalPinToPCICR(pin_a) |= _BV(digitalPinToPCICRbit(pin_a));
+#endif
+}
+
+
+uint8_t RotaryEncoder::outputs()
+{
+    // Read the port directly, as this is called from the interrupt
+    uint8_t a = (*portInputRegister(digitalPinToPort(pin_a)) & digitalPinToBitMask(pin_a)) ? 2 : 0;
+    uint8_t b = (*portInputRegister(digitalPinToPort(pin_b)) & digitalPinToBitMask(pin_b)) ? 1 : 0;
+
+    return a | b;
+}
+
+
+void RotaryEncoder::add_transition(uint8_t outputs)
+{
+    steps += transitions[(state << 2) | outputs];
+    state = outputs;
+}
+
+
+int8_t RotaryEncoder::read()
+{
+    noInterrupts();
+    int16_t detents = steps / steps_per_detent;
+    if (detents > 127) {
+        detents = 127;
+    } else if (detents < -128) {
+        detents = -128;
+    }
+    steps -= detents * steps_per_detent;
+    interrupts();
+
+    return (int8_t)detents;
+}
+
+
+void RotaryEncoder::discard()
+{
+    noInterrupts();
+    steps = 0;
+    interrupts();
+}
+
+
+void RotaryEncoder::snapshot(Snapshot &snapshot)
+{
+    noInterrupts();
+    snapshot.field(state);
+    snapshot.field(steps);
+    interrupts();
+}
+
+#endif
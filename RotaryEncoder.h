@@ -0,0 +1,125 @@
+/** @file
+ *  Definition of the RotaryEncoder class. This file contains the definition
+ *  of the class used to read a quadrature rotary encoder.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef RotaryEncoder_H
+#define RotaryEncoder_H
+
+#include <Arduino.h>
+#include "Snapshot.h"
+
+/** A class to read a mechanical quadrature rotary encoder. Both encoder
+ *  outputs are watched by a pin change interrupt, and each change is decoded
+ *  with a lookup table indexed by the previous and current output states,
+ *  which gives +1 or -1 for a valid step, and 0 for no change or an invalid
+ *  jump (usually contact bounce). The steps are accumulated in the interrupt,
+ *  and whole detents are handed out by read(), which should be called once
+ *  per update by whatever is using the encoder.
+ *
+ * @note The pin change interrupt handler is only installed for pins on
+ *       port D (digital pins 0 to 7 on an Uno), so both encoder pins must be
+ *       on that port.
+ *
+ * @note On non-AVR (host) builds no interrupt is installed, and the output
+ *       states should be fed in with add_transition().
+ */
+class RotaryEncoder
+{
+public:
+    /** Create a new RotaryEncoder object.
+     *
+     * @param pin_a            The digital pin encoder output A is connected to.
+     * @param pin_b            The digital pin encoder output B is connected to.
+     * @param steps_per_detent How many quadrature steps there are between the
+     *                         encoder's detents.
+     * @return A new RotaryEncoder object.
+     */
+    RotaryEncoder(uint8_t pin_a, uint8_t pin_b, uint8_t steps_per_detent = 4) :
+        pin_a(pin_a), pin_b(pin_b), steps_per_detent(steps_per_detent),
+        state(0), steps(0)
+        { /* fnord */ }
+
+
+    /** Set up the encoder pins with pull-ups, and enable the pin change
+     *  interrupt for them. This should be called once from the global
+     *  setup() function.
+     */
+    void setup();
+
+
+    /** Take the detents the encoder has been turned through since the last
+     *  call. Any partial detent is kept for next time, as are any detents
+     *  beyond what an int8_t can hold.
+     *
+     * @return The number of detents turned, positive when output A leads B,
+     *         saturated at -128 and 127.
+     */
+    int8_t read();
+
+
+    /** Throw away everything the encoder has been turned through that hasn't
+     *  been read, including any partial detent, so that turns made while
+     *  nothing was reading it are forgotten.
+     */
+    void discard();
+
+
+    /** Decode a change in the encoder outputs. This is called from the pin
+     *  change interrupt on AVR builds, and must be kept short.
+     *
+     * @param outputs The current encoder outputs, with A in bit 1 and B in bit 0.
+     */
+    void add_transition(uint8_t outputs);
+
+
+    /** Read the current encoder outputs from the pins.
+     *
+     * @return The encoder outputs, with A in bit 1 and B in bit 0.
+     */
+    uint8_t outputs();
+
+
+    /** Save or restore the encoder outputs and the steps not yet read.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const int8_t transitions[16]; //!< Step for each (previous << 2 | current) output state
+
+    uint8_t pin_a;              //!< The digital pin encoder output A is connected to
+    uint8_t pin_b;              //!< The digital pin encoder output B is connected to
+    uint8_t steps_per_detent;   //!< Quadrature steps between detents
+    uint8_t state;              //!< The previous encoder outputs
+    volatile int16_t steps;     //!< Steps accumulated by the interrupt and not yet read
+};
+
+#endif
@@ -0,0 +1,121 @@
+/** @file
+ *  Implementation of the Scheduler class. This file contains the
+ *  implementation of a small cooperative task scheduler for the main loop.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no background tasks, so its loop() needs no scheduler
+#if !defined(USE_TINY_PROFILE)
+
+#include "Scheduler.h"
+
+bool Scheduler::add_task(TaskFunction function, Priority priority, uint16_t budget)
+{
+    if (task_count >= max_tasks) {
+        return false;
+    }
+
+    Task &task = tasks[task_count++];
+    task.function = function;
+    task.priority = priority;
+    task.budget   = budget;
+    memset(&task.stats, 0, sizeof(task.stats));
+
+    return true;
+}
+
+
+void Scheduler::run()
+{
+    micros_t tick_start = micros();
+
+    for (uint8_t index = 0; index < task_count; ++index) {
+        if (tasks[index].priority == PRIORITY_HIGH) {
+            run_task(tasks[index]);
+        }
+    }
+
+    // Go round the background tasks once at most, starting from the one
+    // that was put off last time, and stop at the first that won't fit.
+    for (uint8_t checked = 0; checked < task_count; ++checked) {
+        uint8_t index = next_background;
+        next_background = (next_background + 1) % task_count;
+
+        Task &task = tasks[index];
+        if (task.priority != PRIORITY_BACKGROUND) {
+            continue;
+        }
+
+        if ((micros_t)(micros() - tick_start) + task.budget > tick_budget) {
+            count(task.stats.deferred);
+            next_background = index;
+            break;
+        }
+
+        run_task(task);
+    }
+
+    micros_t elapsed = micros() - tick_start;
+    if (elapsed > worst_tick) {
+        worst_tick = (elapsed < 0xffff) ? elapsed : 0xffff;
+    }
+    if (elapsed > tick_budget) {
+        count(late_ticks);
+    }
+}
+
+
+void Scheduler::run_task(Task &task)
+{
+    micros_t start = micros();
+    task.function();
+    micros_t elapsed = micros() - start;
+
+    if (elapsed > task.stats.worst) {
+        task.stats.worst = (elapsed < 0xffff) ? elapsed : 0xffff;
+    }
+
+    if (task.budget && elapsed > task.budget) {
+        count(task.stats.overruns);
+    }
+}
+
+
+void Scheduler::snapshot(Snapshot &snapshot)
+{
+    for (uint8_t task = 0; task < task_count; ++task) {
+        snapshot.field(tasks[task].stats);
+    }
+    snapshot.field(next_background);
+    snapshot.field(worst_tick);
+    snapshot.field(late_ticks);
+}
+
+#endif
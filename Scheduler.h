@@ -0,0 +1,208 @@
+/** @file
+ *  Definition of the Scheduler class. This file contains the definition
+ *  of a small cooperative task scheduler for the main loop.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Scheduler_H
+#define Scheduler_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "Snapshot.h"
+
+/** A small cooperative scheduler for the work done in the main loop. Tasks
+ *  are plain functions held in a fixed size table, and each call to run()
+ *  is one tick. High priority tasks run on every tick, in the order they
+ *  were added. Background tasks then run in turn, but only while there is
+ *  time left in the tick for the whole of a task's budget, so that the
+ *  time between runs of the high priority tasks stays bounded however much
+ *  background work there is. A background task that doesn't fit is the
+ *  first to be tried on the next tick, so every task gets its turn.
+ *
+ *  As tasks can't be interrupted, a task that runs over its budget is only
+ *  counted, along with how many times each task had to wait for a later
+ *  tick and the longest time each task has taken.
+ */
+class Scheduler
+{
+public:
+    /** The function a task runs each time it is scheduled.
+     */
+    typedef void (*TaskFunction)();
+
+    /** The priorities a task can be given.
+     */
+    enum Priority {
+        PRIORITY_HIGH,        //!< Run on every tick.
+        PRIORITY_BACKGROUND,  //!< Run in time left over after the high priority tasks.
+    };
+
+    /** Timing statistics for a task. All counters saturate rather than wrap.
+     */
+    struct Stats {
+        uint16_t overruns;    //!< How many times the task took longer than its budget
+        uint16_t deferred;    //!< How many times the task was put off to a later tick
+        uint16_t worst;       //!< The longest the task has taken, in microseconds
+    };
+
+    static const uint8_t max_tasks = 8; //!< How many tasks can be added
+
+    /** Create a new Scheduler object.
+     *
+     * @param tick_budget The time, in microseconds, each tick may take before
+     *                    no more background tasks are started.
+     * @return A new Scheduler object.
+     */
+    Scheduler(micros_t tick_budget = 4000) :
+        tick_budget(tick_budget), task_count(0), next_background(0), worst_tick(0), late_ticks(0)
+        { /* fnord */ }
+
+
+    /** Add a task to the scheduler. This should be called from the global
+     *  setup() function.
+     *
+     * @param function The function to run for the task.
+     * @param priority The priority of the task.
+     * @param budget   How long, in microseconds, the task should take. A
+     *                 background task is only started if this fits in what
+     *                 is left of the tick. 0 means the task isn't checked.
+     * @return true if the task was added, false if the table is full.
+     */
+    bool add_task(TaskFunction function, Priority priority, uint16_t budget = 0);
+
+
+    /** Run one tick: all high priority tasks, then as many background tasks
+     *  as fit. This should be called from the global loop() function.
+     */
+    void run();
+
+
+    /** Obtain the number of tasks that have been added.
+     *
+     * @return The number of tasks.
+     */
+    uint8_t get_task_count() {
+        return task_count;
+    }
+
+
+    /** Obtain the timing statistics for a task.
+     *
+     * @param task The index of the task, in the order tasks were added.
+     * @return A reference to the task's statistics.
+     */
+    const Stats &get_stats(uint8_t task) {
+        return tasks[task].stats;
+    }
+
+
+    /** Obtain how long a task should take.
+     *
+     * @param task The index of the task, in the order tasks were added.
+     * @return The task's budget, in microseconds, or 0 if it isn't checked.
+     */
+    uint16_t get_budget(uint8_t task) {
+        return tasks[task].budget;
+    }
+
+
+    /** Obtain how long a tick may take before no more background tasks are
+     *  started.
+     *
+     * @return The tick budget, in microseconds.
+     */
+    micros_t get_tick_budget() {
+        return tick_budget;
+    }
+
+
+    /** Obtain the longest a tick has taken. This is the worst case time
+     *  between runs of the high priority tasks, and so the worst latency
+     *  in responding to the switch.
+     *
+     * @return The longest tick, in microseconds, saturating at 0xffff.
+     */
+    uint16_t get_worst_tick() {
+        return worst_tick;
+    }
+
+
+    /** Obtain how many ticks have taken longer than the tick budget. This
+     *  should stay at 0; if it doesn't, some task is taking much longer
+     *  than its budget says.
+     *
+     * @return The number of late ticks, saturating at 0xffff.
+     */
+    uint16_t get_late_ticks() {
+        return late_ticks;
+    }
+
+
+    /** Save or restore the task statistics and the background task rotation.
+     *  The task table itself is set up by setup(), so isn't included.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    /** A task in the scheduler's table.
+     */
+    struct Task {
+        TaskFunction function; //!< The function to run
+        Priority priority;     //!< The priority of the task
+        uint16_t budget;       //!< How long the task should take, in microseconds
+        Stats stats;           //!< Timing statistics for the task
+    };
+
+    /** Run a task, and update its statistics.
+     *
+     * @param task The task to run.
+     */
+    void run_task(Task &task);
+
+    /** Increment a counter, unless it has reached its maximum value.
+     *
+     * @param counter The counter to increment.
+     */
+    static void count(uint16_t &counter) {
+        if (counter < 0xffff) {
+            ++counter;
+        }
+    }
+
+    micros_t tick_budget;       //!< How long a tick may take before background tasks stop being started
+    Task tasks[max_tasks];      //!< The task table
+    uint8_t task_count;         //!< How many tasks are in the table
+    uint8_t next_background;    //!< The task to try first for background time on the next tick
+    uint16_t worst_tick;        //!< The longest tick so far, in microseconds
+    uint16_t late_ticks;        //!< How many ticks took longer than the tick budget
+};
+
+#endif
@@ -0,0 +1,194 @@
+/** @file
+ *  Definition of the Snapshot class. This file contains the definition of a
+ *  class used to save and restore the runtime context of the system.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Snapshot_H
+#define Snapshot_H
+
+#include <Arduino.h>
+
+/** A class to save or restore the runtime context of the system, so that a
+ *  replay of a long recording can be started part way through rather than
+ *  from the beginning. Each class with context to save has a snapshot()
+ *  function that passes each of its fields to field(), in a fixed order.
+ *  The same function is used for both saving and restoring, so the two
+ *  can't get out of step.
+ *
+ *  The snapshot is plain bytes in the native layout, so it can only be
+ *  restored by the same build that saved it. Use save() and restore()
+ *  rather than calling a snapshot() function directly: restore() checks
+ *  that the buffer holds exactly the snapshot the function expects before
+ *  it changes anything, so a short or mismatched buffer can't leave the
+ *  system half restored.
+ */
+class Snapshot
+{
+public:
+    /** Whether fields are being saved or restored.
+     */
+    enum Mode {
+        SNAPSHOT_SAVE,     //!< Copy fields into the buffer.
+        SNAPSHOT_RESTORE,  //!< Copy fields out of the buffer.
+        SNAPSHOT_MEASURE,  //!< Only count the size of the fields.
+    };
+
+    /** A function that passes each field of the context to field().
+     */
+    typedef void (*Function)(Snapshot &snapshot);
+
+    /** Create a new Snapshot object.
+     *
+     * @param mode   Whether to save, restore or measure.
+     * @param buffer The buffer to save the fields into, or restore them from.
+     *               This may be NULL when measuring.
+     * @param size   The size of the buffer, in bytes. This is ignored when
+     *               measuring.
+     * @return A new Snapshot object.
+     */
+    Snapshot(Mode mode, uint8_t *buffer, uint16_t size) :
+        mode(mode), buffer(buffer), size(size), used(0), overflow(false)
+        { /* fnord */ }
+
+
+    /** Save or restore a field. If the buffer is too small, the field is
+     *  left alone, and the snapshot is marked as invalid.
+     *
+     * @param value The field to save or restore.
+     */
+    template <class T> void field(T &value) {
+        if (mode == SNAPSHOT_MEASURE) {
+            used += sizeof(T);
+            return;
+        }
+
+        if (overflow || used + sizeof(T) > size) {
+            overflow = true;
+            return;
+        }
+
+        if (mode == SNAPSHOT_SAVE) {
+            memcpy(&buffer[used], &value, sizeof(T));
+        } else {
+            memcpy(&value, &buffer[used], sizeof(T));
+        }
+        used += sizeof(T);
+    }
+
+
+    /** Save or restore a field shared with an interrupt. The caller must
+     *  hold the interrupt off, as the field is read and written back.
+     *
+     * @param value The field to save or restore.
+     */
+    template <class T> void field(volatile T &value) {
+        T copy = value;
+        field(copy);
+        value = copy;
+    }
+
+
+    /** Obtain how much of the buffer has been used so far.
+     *
+     * @return The number of bytes saved or restored.
+     */
+    uint16_t get_used() {
+        return used;
+    }
+
+
+    /** Check that every field fitted in the buffer.
+     *
+     * @return `true` if the snapshot is complete, `false` if the buffer was
+     *         too small.
+     */
+    bool is_valid() {
+        return !overflow;
+    }
+
+
+    /** Work out how big the snapshot made by a function is.
+     *
+     * @param function The function that passes the context to field().
+     * @return The size of the snapshot, in bytes.
+     */
+    static uint16_t measure(Function function) {
+        Snapshot snapshot(SNAPSHOT_MEASURE, NULL, 0);
+        function(snapshot);
+
+        return snapshot.get_used();
+    }
+
+
+    /** Save the context passed to field() by a function.
+     *
+     * @param function The function that passes the context to field().
+     * @param buffer   The buffer to save the context into.
+     * @param size     The size of the buffer, in bytes.
+     * @return The size of the snapshot, in bytes, or 0 if the buffer is too
+     *         small to hold it.
+     */
+    static uint16_t save(Function function, uint8_t *buffer, uint16_t size) {
+        Snapshot snapshot(SNAPSHOT_SAVE, buffer, size);
+        function(snapshot);
+
+        return snapshot.is_valid() ? snapshot.get_used() : 0;
+    }
+
+
+    /** Restore the context passed to field() by a function. Nothing is
+     *  changed unless the size of the buffer matches the size of the
+     *  snapshot exactly.
+     *
+     * @param function The function that passes the context to field().
+     * @param buffer   The buffer holding a snapshot saved by save().
+     * @param size     The size of the snapshot in the buffer, in bytes.
+     * @return `true` if the context was restored, `false` if the buffer
+     *         doesn't hold a snapshot of the right size.
+     */
+    static bool restore(Function function, uint8_t *buffer, uint16_t size) {
+        if (size != measure(function)) {
+            return false;
+        }
+
+        Snapshot snapshot(SNAPSHOT_RESTORE, buffer, size);
+        function(snapshot);
+
+        return true;
+    }
+
+private:
+    Mode mode;        //!< Whether fields are being saved or restored
+    uint8_t *buffer;  //!< The buffer fields are saved into or restored from
+    uint16_t size;    //!< The size of the buffer, in bytes
+    uint16_t used;    //!< How much of the buffer has been used
+    bool overflow;    //!< Did a field not fit in the buffer?
+};
+
+#endif
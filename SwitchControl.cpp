@@ -43,10 +43,32 @@ void SwitchControl::setup()
 
 void SwitchControl::set_led_state(bool state)
 {
+#if !defined(USE_TINY_PROFILE)
+    if (effects) {
+        effects -> stop();
+    }
+#endif
+
     digitalWrite(led_pin, state ? HIGH : LOW);
 }
 
 
+void SwitchControl::set_led_effect(LedEffects::Effect effect)
+{
+#if defined(USE_TINY_PROFILE)
+    // The tiny profile has no effects engine, so the LED is just lit
+    (void)effect;
+    digitalWrite(led_pin, HIGH);
+#else
+    if (effects) {
+        effects -> start(effect);
+    } else {
+        digitalWrite(led_pin, HIGH);
+    }
+#endif
+}
+
+
 SwitchControl::Event SwitchControl::update()
 {
     Event event = EVENT_NONE;
@@ -56,36 +78,135 @@ SwitchControl::Event SwitchControl::update()
     // If the state has changed since the last update, reset the debounce timer
     if(current_state != last_state) {
         last_debounce = millis();
+
+        // Keep track of the bouncing for the health counters
+        if(!bouncing) {
+            bouncing = true;
+            bounce_changes = 0;
+            bounce_start = last_debounce;
+        }
+        if(bounce_changes < 0xff) {
+            ++bounce_changes;
+        }
     }
 
     // If the debounce timer has been going for longer than the debounce time,
     // a valid state change might be present
-    if((millis() - last_debounce) > debounce_time) {
+    if((millis_t)(millis() - last_debounce) > debounce_time) {
 
         // If the state has changed, update
         if(current_state != switch_state) {
             switch_state = current_state;
+            record_bounce();
 
             // Convert the switch status into an event type and record the time
             if(switch_state == HIGH) {
                 last_press = millis();
-                event = EVENT_PRESSED;
+                next_repeat = repeat_delay;
+                current_interval = repeat_interval;
+
+                // Only pairs of presses count, so a third quick press is a plain press
+                count(health.presses);
+                if(can_double && (last_press - last_release) < doublepress_time) {
+                    can_double = false;
+                    event = EVENT_DOUBLEPRESS;
+                } else {
+                    can_double = true;
+                    event = EVENT_PRESSED;
+                }
             } else {
                 in_longpress = false;    // by definition, can't be in longpress if released.
                 last_release = millis();
                 event = EVENT_RELEASED;
+
+                count(health.hold_time[bucket(last_release - last_press, 7)]);
             }
+
+        // If the reading changed and came back without the state changing,
+        // something glitched; worn switches do this before phantom presses.
+        } else if(bouncing) {
+            count(health.glitches);
+            bouncing = false;
         }
 
-        // Has the switch been held down for more than the longpress time?
-        if(!in_longpress && switch_state == HIGH && ((millis() - last_press) > longpress_time)) {
-            in_longpress = true;
-            event = EVENT_LONGPRESS;
+        if(!in_longpress && switch_state == HIGH) {
+            millis_t held = millis() - last_press;
+
+            // Has the switch been held down for more than the longpress time?
+            if(held > longpress_time) {
+                in_longpress = true;
+                can_double = false;      // a long press can't be half of a double press
+                event = EVENT_LONGPRESS;
+                count(health.longpresses);
+
+            // If not, is a repeat due? Each one comes a bit sooner than the last.
+            } else if(event == EVENT_NONE && held >= next_repeat) {
+                event = EVENT_REPEAT;
+
+                next_repeat += current_interval;
+                current_interval = (current_interval * 3) / 4;
+                if(current_interval < min_repeat_interval) {
+                    current_interval = min_repeat_interval;
+                }
+            }
         }
     }
 
     // Record the current state for comparison next update()
     last_state = current_state;
 
+    millis_t now = millis();
+    limit_age(last_press, now);
+    limit_age(last_release, now);
+    limit_age(last_debounce, now);
+
     return event;
 }
+
+
+void SwitchControl::record_bounce()
+{
+    // The first change is the real one, anything more is bounce
+    uint8_t extra = bounce_changes ? bounce_changes - 1 : 0;
+
+    health.bounces = (health.bounces > 0xffff - extra) ? 0xffff : health.bounces + extra;
+    if(extra > health.worst_bounces) {
+        health.worst_bounces = extra;
+    }
+
+    count(health.bounce_time[bucket(last_debounce - bounce_start, 0)]);
+
+    bouncing = false;
+}
+
+
+uint8_t SwitchControl::bucket(millis_t value, uint8_t shift)
+{
+    uint8_t result = 0;
+
+    value >>= shift;
+    while(value && result < health_buckets - 1) {
+        value >>= 1;
+        ++result;
+    }
+
+    return result;
+}
+
+
+void SwitchControl::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(switch_state);
+    snapshot.field(in_longpress);
+    snapshot.field(can_double);
+    snapshot.field(last_press);
+    snapshot.field(last_release);
+    snapshot.field(last_state);
+    snapshot.field(last_debounce);
+    snapshot.field(next_repeat);
+    snapshot.field(current_interval);
+    snapshot.field(bouncing);
+    snapshot.field(bounce_changes);
+    snapshot.field(bounce_start);
+    snapshot.field(health);
+}
@@ -33,24 +33,78 @@
 #define SwitchControl_H
 
 #include <Arduino.h>
+#include "TimeTypes.h"
+#include "LedEffects.h"
+#include "Snapshot.h"
+
+/** Something that can show the state of the timer on the illumination LED
+ *  in the switch. The SwitchControl drives the LED itself; when several
+ *  state machines share the switch, each can be given its own, and only the
+ *  one that owns the LED at the time reaches it (see RegionLed).
+ */
+class SwitchLed
+{
+public:
+    /** Set the LED to either on or off.
+     *
+     * @param state Set to `true` to turn the LED on, `false` to turn it off.
+     */
+    virtual void set_led_state(bool state) = 0;
+
+
+    /** Show an effect on the LED. The effect runs until it is replaced, or
+     *  set_led_state() is called.
+     *
+     * @param effect The effect to show.
+     */
+    virtual void set_led_effect(LedEffects::Effect effect) = 0;
+};
+
 
 /** A class to interact with a SPST momentary illuminated switch. This class
  *  provides features to turn on or off the LED illumination in the switch,
  *  and software debounce and press/longpress detection for button pushes.
  *  This class requires one digital input pin and one digital output pin per
  *  instance, and allows the debounce and longpress timers to be configured
- *  during creation.
+ *  during creation. While the switch is held, repeat events are generated
+ *  at an accelerating rate, like a keyboard's auto-repeat, until either the
+ *  switch is released or a long press is triggered. A press that comes soon
+ *  after the switch was released is reported as a double press rather than
+ *  a plain press.
+ *
+ *  As switches wear they bounce more, so the debouncing also keeps a set of
+ *  health counters: how many extra transitions each press and release
+ *  bounced through, how long the bouncing lasted, how long presses are held,
+ *  and how often short glitches that never became a press were seen. These
+ *  only need updating when the switch changes, so they cost next to nothing
+ *  in update().
  */
-class SwitchControl
+class SwitchControl : public SwitchLed
 {
 public:
+    static const uint8_t health_buckets = 8; //!< The number of buckets in each health histogram
+
+    /** Switch health counters. All counters saturate rather than wrap.
+     */
+    struct Health {
+        uint16_t presses;                      //!< How many presses (including double presses) there have been
+        uint16_t longpresses;                  //!< How many of the presses became long presses
+        uint16_t glitches;                     //!< How many times the switch changed briefly without a press or release
+        uint16_t bounces;                      //!< How many extra transitions have been seen during debounce
+        uint8_t  worst_bounces;                //!< The most extra transitions seen for a single press or release
+        uint16_t bounce_time[health_buckets];  //!< Bounce durations: bucket 0 is under 1ms, bucket N is 2^(N-1) to 2^N-1 ms
+        uint16_t hold_time[health_buckets];    //!< Press durations: bucket N is up to 2^N * 128 ms, the last is anything longer
+    };
+
     /** The possible kinds of events that may be reported by update()
      */
     enum Event {
-        EVENT_NONE,      //!< Nothing happened. Nothing to see here, move along.
-        EVENT_PRESSED,   //!< The switch was pressed.
-        EVENT_LONGPRESS, //!< The switch had been held long enough to trigger a longpress.
-        EVENT_RELEASED   //!< The switch was released.
+        EVENT_NONE,       //!< Nothing happened. Nothing to see here, move along.
+        EVENT_PRESSED,    //!< The switch was pressed.
+        EVENT_LONGPRESS,  //!< The switch had been held long enough to trigger a longpress.
+        EVENT_RELEASED,   //!< The switch was released.
+        EVENT_REPEAT,     //!< The switch is being held, and should be treated as pressed again.
+        EVENT_DOUBLEPRESS //!< The switch was pressed again shortly after being released.
     };
 
     /** Create a new SwitchControl object for interacting with an illuminated
@@ -65,13 +119,29 @@ public:
      *                   spurious press and release events are generated.
      * @param longpress_time If the switch is held pressed for this amount of time
      *                   in milliseconds a 'long press' event will be generated.
+     * @param repeat_delay How long, in milliseconds, the switch must be held
+     *                   before the first repeat event is generated.
+     * @param repeat_interval The time, in milliseconds, between the first and
+     *                   second repeat events. Each following interval is 3/4
+     *                   of the previous one, down to `min_repeat_interval`.
+     * @param doublepress_time If the switch is pressed within this many
+     *                   milliseconds of being released, a 'double press' event
+     *                   will be generated instead of a 'pressed' event.
+     * @param effects    An optional pointer to an effects engine for the LED,
+     *                   used by set_led_effect(). If this is NULL, or in
+     *                   the tiny profile, effects just turn the LED on.
      */
-    SwitchControl(uint8_t switch_pin, uint8_t led_pin, unsigned long debounce_time = 50, unsigned long longpress_time = 3000) :
-        switch_pin(switch_pin), led_pin(led_pin),
-        switch_state(LOW),in_longpress(false),last_press(0),last_release(0),
+    SwitchControl(uint8_t switch_pin, uint8_t led_pin, millis_t debounce_time = 50, millis_t longpress_time = 3000,
+                  millis_t repeat_delay = 400, millis_t repeat_interval = 300, millis_t doublepress_time = 400,
+                  LedEffects *effects = NULL) :
+        switch_pin(switch_pin), led_pin(led_pin), effects(effects),
+        switch_state(LOW),in_longpress(false),can_double(false),last_press(0),last_release(0),
         last_state(LOW),last_debounce(0),
-        debounce_time(debounce_time), longpress_time(longpress_time)
-    { /* fnord */ }
+        debounce_time(debounce_time), longpress_time(longpress_time),
+        repeat_delay(repeat_delay), repeat_interval(repeat_interval), doublepress_time(doublepress_time),
+        next_repeat(0), current_interval(0),
+        bouncing(false), bounce_changes(0), bounce_start(0)
+    { memset(&health, 0, sizeof(health)); }
 
 
     /* ------------------------------------------------------------------------
@@ -106,10 +176,47 @@ public:
     void set_led_state(bool state);
 
 
+    /** Show an effect on the illumination LED in the switch. The effect runs
+     *  until it is replaced, or set_led_state() is called.
+     *
+     * @param effect The effect to show.
+     */
+    void set_led_effect(LedEffects::Effect effect);
+
+
+    /** Replace the health counters, for example with counters loaded from
+     *  EEPROM so that they accumulate over the life of the switch.
+     *
+     * @param counters The counters to use.
+     */
+    void set_health(const Health &counters)
+    {
+        health = counters;
+    }
+
+
+    /** Save or restore the switch's debounce and timing context, and its
+     *  health counters.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+
     /* ------------------------------------------------------------------------
      *  State lookup
      */
 
+    /** Obtain the switch health counters.
+     *
+     * @return A reference to the health counters.
+     */
+    const Health &get_health()
+    {
+        return health;
+    }
+
+
     /** Determine whether the switch is currently pressed.
      *
      * @return `true` if the switch is currently pressed, `false` if it is not.
@@ -126,7 +233,7 @@ public:
      *
      * @return The time in milliseconds since the last press event.
      */
-    unsigned long time_since_pressed()
+    millis_t time_since_pressed()
     {
         return (millis() - last_press);
     }
@@ -137,29 +244,83 @@ public:
      *
      * @return The time in milliseconds since the last release event.
      */
-    unsigned long time_since_released()
+    millis_t time_since_released()
     {
         return (millis() - last_release);
     }
 
 private:
+    static const millis_t min_repeat_interval = 120; //!< The shortest time between repeats, in milliseconds
+    static const millis_t max_age = 0x40000000UL;    //!< The oldest a timestamp is allowed to get, about 12 days
+
+    /** Record the bouncing seen for a press or release in the health counters.
+     */
+    void record_bounce();
+
+    /** Work out which histogram bucket a value should go in.
+     *
+     * @param value The value to place in a bucket.
+     * @param shift How many bits to drop from the value before bucketing.
+     * @return The bucket the value belongs in, based on its highest set bit.
+     */
+    static uint8_t bucket(millis_t value, uint8_t shift);
+
+    /** Stop a timestamp getting so old that the time since it wraps round
+     *  and makes it look recent again, which would happen after about 49.7
+     *  days without touching the switch. Past `max_age`, the timestamp moves
+     *  forward so that the time since it stays at `max_age`.
+     *
+     * @param timestamp The timestamp to limit, in millis.
+     * @param now       The current time, in millis.
+     */
+    static void limit_age(millis_t &timestamp, millis_t now)
+    {
+        if ((millis_t)(now - timestamp) > max_age) {
+            timestamp = now - max_age;
+        }
+    }
+
+    /** Increment a health counter, unless it is already at its maximum.
+     *
+     * @param counter The counter to increment.
+     */
+    static void count(uint16_t &counter)
+    {
+        if (counter < 0xffff) {
+            ++counter;
+        }
+    }
+
     // Digital pin configuration
     uint8_t switch_pin;           //!< The digital pin the switch connected to
     uint8_t led_pin;              //!< The digital pin the indicator LED connected to
+    LedEffects *effects;          //!< The effects engine for the LED, or NULL if there isn't one
 
     // Button state information
     uint8_t switch_state;         //!< The current switch state
     bool in_longpress;            //!< Are we in a long press state?
-    unsigned long last_press;     //!< The time in millis since last reset that the last press happened (after debounce)
-    unsigned long last_release;   //!< The time in millis since last reset that the last release happened (after debounce)
+    bool can_double;              //!< Could the next press be a double press?
+    millis_t last_press;          //!< The time in millis since last reset that the last press happened (after debounce)
+    millis_t last_release;        //!< The time in millis since last reset that the last release happened (after debounce)
 
     // Timing control
-    unsigned long debounce_time;  //!< Time to delay during debounce, in milliseconds.
-    unsigned long longpress_time; //!< How long the switch must be held to trigger a 'longpress' event
+    millis_t debounce_time;       //!< Time to delay during debounce, in milliseconds.
+    millis_t longpress_time;      //!< How long the switch must be held to trigger a 'longpress' event
+    millis_t repeat_delay;        //!< How long the switch must be held before repeats start
+    millis_t repeat_interval;     //!< The initial time between repeats
+    millis_t doublepress_time;    //!< How soon after a release a press must come to be a double press
 
     // State variables needed to persist data over update()s
     uint8_t last_state;           //!< Previous reading from the switch
-    unsigned long last_debounce;  //!< The time at which the last state change occurred during debounce
+    millis_t last_debounce;       //!< The time at which the last state change occurred during debounce
+    millis_t next_repeat;         //!< Time since the press at which the next repeat event is due
+    millis_t current_interval;    //!< The time between the most recent repeat and the next
+
+    // Health tracking
+    Health health;                //!< The switch health counters
+    bool bouncing;                //!< Has the reading changed since the switch was last stable?
+    uint8_t bounce_changes;       //!< How many times the reading has changed since it was last stable
+    millis_t bounce_start;        //!< The time of the first change since the switch was last stable
 };
 
 #endif
@@ -0,0 +1,64 @@
+/** @file
+ *  Definition of the fixed width types used for times. This file contains
+ *  the types used for times and intervals throughout the project.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef TimeTypes_H
+#define TimeTypes_H
+
+#include <stdint.h>
+#include "Profile.h"
+
+/** A time or interval in milliseconds. millis() returns an unsigned long,
+ *  which is 32 bits on AVR but 64 bits on most hosts, so times are kept in
+ *  a fixed width type instead to make host builds wrap round exactly as
+ *  the device does. Intervals must be found by subtracting times and
+ *  casting the result back to millis_t, for example
+ *  `(millis_t)(millis() - last_update)`, so that the subtraction wraps at
+ *  32 bits on every platform.
+ */
+typedef uint32_t millis_t;
+
+/** A time or interval in microseconds, with the same rules as millis_t.
+ */
+typedef uint32_t micros_t;
+
+/** A time in milliseconds that is only compared with times a few seconds
+ *  away, such as when a state last redrew the bar. The tiny profile keeps
+ *  these in 16 bits, which are cheaper to store and subtract on an 8 bit
+ *  part, so intervals between them must stay well under 65 seconds. They
+ *  follow the same rules as millis_t, casting to state_millis_t instead.
+ */
+#if defined(USE_TINY_PROFILE)
+typedef uint16_t state_millis_t;
+#else
+typedef millis_t state_millis_t;
+#endif
+
+#endif
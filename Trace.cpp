@@ -0,0 +1,184 @@
+/** @file
+ *  Implementation of the Trace class. This file contains the implementation
+ *  of a small buffer of timestamped events used to build a timeline of activity.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no trace
+#if !defined(USE_TINY_PROFILE)
+
+#include "Trace.h"
+#include "Clock.h"
+
+void Trace::set_enabled(bool enable)
+{
+    enabled = enable;
+    count   = 0;
+    dropped = 0;
+
+    if (enabled && display) {
+        display -> record_current();
+    }
+}
+
+
+void Trace::record(Kind kind, uint8_t value)
+{
+    if (!enabled) {
+        return;
+    }
+
+    if (count == max_records) {
+        if (dropped < 0xffff) {
+            ++dropped;
+        }
+        return;
+    }
+
+    Record &next = records[(head + count) % max_records];
+    next.time  = Clock::millis();
+    next.kind  = kind;
+    next.value = value;
+    ++count;
+}
+
+
+bool Trace::take(Record &record)
+{
+    if (!count) {
+        return false;
+    }
+
+    record = records[head];
+    head = (head + 1) % max_records;
+    --count;
+
+    return true;
+}
+
+
+uint16_t Trace::take_dropped()
+{
+    uint16_t result = dropped;
+    dropped = 0;
+
+    return result;
+}
+
+
+void TraceDisplay::setLevel(float level)
+{
+    drawn = level;
+    if (trace.is_enabled()) {
+        record_level(tenths(level));
+    }
+
+    output.setLevel(level);
+}
+
+
+void TraceDisplay::setSteps(uint16_t level)
+{
+    drawn = (float)level / steps;
+    if (trace.is_enabled()) {
+        // Rounded to the nearest tenth, as tenths() does for setLevel()
+        uint32_t value = ((uint32_t)level * 10 + steps / 2) / steps;
+        record_level((value > 255) ? 255 : value);
+    }
+
+    output.setSteps(level);
+}
+
+
+void TraceDisplay::setLeds(uint8_t *leds)
+{
+    // Patterns don't have a level, so count the segments that are lit
+    uint8_t lit = 0;
+    for (uint8_t led = 0; led < segments; ++led) {
+        if (leds[led]) {
+            ++lit;
+        }
+    }
+
+    drawn = lit;
+    if (trace.is_enabled()) {
+        record_level(lit * 10);
+    }
+
+    output.setLeds(leds);
+}
+
+
+void TraceDisplay::record_current()
+{
+    last_level = tenths(drawn);
+    trace.record(Trace::TRACE_LEVEL, last_level);
+}
+
+
+void TraceDisplay::record_level(uint8_t level)
+{
+    if (level != last_level) {
+        last_level = level;
+        trace.record(Trace::TRACE_LEVEL, level);
+    }
+}
+
+
+uint8_t TraceDisplay::tenths(float level)
+{
+    float value = level * 10.0f + 0.5f;
+
+    if (value < 0.0f) {
+        return 0;
+    }
+
+    return (value > 255.0f) ? 255 : (uint8_t)value;
+}
+
+
+void Trace::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(enabled);
+    snapshot.field(records);
+    snapshot.field(head);
+    snapshot.field(count);
+    snapshot.field(dropped);
+}
+
+
+void TraceDisplay::snapshot(Snapshot &snapshot)
+{
+    snapshot.field(drawn);
+    snapshot.field(last_level);
+    output.snapshot(snapshot);
+}
+
+#endif
@@ -0,0 +1,211 @@
+/** @file
+ *  Definition of the Trace class. This file contains the definition of a
+ *  small buffer of timestamped events used to build a timeline of activity.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Trace_H
+#define Trace_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "BarDisplay.h"
+#include "Snapshot.h"
+
+class TraceDisplay;
+
+/** A class to record a timeline of what the system is doing, to help debug
+ *  timing interactions between the switch, the states and the display.
+ *  Each record is a timestamp, a kind and a value, and records are kept in
+ *  a small ring buffer until they are taken, usually by the console sending
+ *  them to a host. The host can turn state records into spans, event
+ *  records into instant events, and level records into counter tracks.
+ *
+ *  Recording costs nothing while the trace is disabled, and only a copy
+ *  into the buffer while it is enabled. If records aren't taken quickly
+ *  enough, new ones are dropped and counted rather than overwriting old
+ *  ones, so that the timeline has a clear gap rather than a hidden one.
+ */
+class Trace
+{
+public:
+    /** The kinds of record in the trace.
+     */
+    enum Kind {
+        TRACE_STATE,   //!< The state machine entered a state; the value is the state ID
+        TRACE_EVENT,   //!< The switch generated an event; the value is the event
+        TRACE_SWITCH,  //!< The debounced switch level changed; the value is 1 if pressed
+        TRACE_LEVEL,   //!< The bar level changed; the value is the level in tenths of a segment
+    };
+
+    /** A single record in the trace.
+     */
+    struct Record {
+        millis_t time;       //!< When the record was made, in millis
+        uint8_t kind;        //!< The kind of record, one of the Kind values
+        uint8_t value;       //!< The value recorded
+    };
+
+    static const uint8_t max_records = 16; //!< How many records can be waiting to be taken
+
+    /** Create a new, disabled, Trace object.
+     *
+     * @return A new Trace object.
+     */
+    Trace() : enabled(false), head(0), count(0), dropped(0), display(NULL)
+        { /* fnord */ }
+
+
+    /** Turn recording on or off. Turning it off discards anything not yet
+     *  taken. Turning it on records the level of the display, if there is
+     *  one, so the trace starts with it rather than waiting for it to
+     *  change.
+     *
+     * @param enable `true` to start recording, `false` to stop.
+     */
+    void set_enabled(bool enable);
+
+
+    /** Determine whether the trace is recording.
+     *
+     * @return `true` if the trace is recording, `false` if not.
+     */
+    bool is_enabled() {
+        return enabled;
+    }
+
+
+    /** Set the display whose level is recorded when recording is turned
+     *  on. A TraceDisplay does this itself.
+     *
+     * @param source The display, or NULL for none.
+     */
+    void set_display(TraceDisplay *source) {
+        display = source;
+    }
+
+
+    /** Add a record to the trace, if it is enabled.
+     *
+     * @param kind  The kind of record.
+     * @param value The value to record.
+     */
+    void record(Kind kind, uint8_t value);
+
+
+    /** Take the oldest record from the trace.
+     *
+     * @param record Set to the oldest record, if there is one.
+     * @return `true` if a record was taken, `false` if the trace is empty.
+     */
+    bool take(Record &record);
+
+
+    /** Obtain and reset the number of records dropped because the buffer
+     *  was full.
+     *
+     * @return The number of records dropped since the last call.
+     */
+    uint16_t take_dropped();
+
+
+    /** Save or restore whether the trace is recording, and the records
+     *  waiting to be taken.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    bool enabled;                 //!< Is the trace recording?
+    Record records[max_records];  //!< The records waiting to be taken
+    uint8_t head;                 //!< The oldest record waiting to be taken
+    uint8_t count;                //!< How many records are waiting to be taken
+    uint16_t dropped;             //!< Records dropped since take_dropped() was last called
+    TraceDisplay *display;        //!< The display whose level is recorded when recording starts, or NULL
+};
+
+
+/** A display that passes everything on to another display, and records
+ *  changes in the bar level in a trace. While the trace is disabled, the
+ *  level is only remembered, so that it can be recorded when the trace is
+ *  enabled.
+ */
+class TraceDisplay : public BarDisplay
+{
+public:
+    /** Create a new TraceDisplay object.
+     *
+     * @param output The display to pass drawing on to.
+     * @param trace  The trace to record level changes in.
+     * @return A new TraceDisplay object.
+     */
+    TraceDisplay(BarDisplay &output, Trace &trace) :
+        output(output), trace(trace), drawn(0), last_level(0)
+        { trace.set_display(this); }
+
+    void setLevel(float level);
+
+    void setSteps(uint16_t level);
+
+    void setLeds(uint8_t *leds);
+
+    /** Record the level last drawn in the trace, whether or not it has
+     *  changed. This is called by the trace when it is enabled.
+     */
+    void record_current();
+
+
+    /** Save or restore the level last drawn and the level last recorded,
+     *  and the context of the display drawing is passed on to.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    /** Record the level, if it has changed since the last one recorded.
+     *
+     * @param level The level in tenths of a segment.
+     */
+    void record_level(uint8_t level);
+
+    /** Convert a level to tenths of a segment, as it is recorded.
+     *
+     * @param level The level, in segments.
+     * @return The level in tenths of a segment, up to 255.
+     */
+    static uint8_t tenths(float level);
+
+    BarDisplay &output;  //!< The display drawing is passed on to
+    Trace &trace;        //!< The trace level changes are recorded in
+    float drawn;         //!< The level last drawn, in segments
+    uint8_t last_level;  //!< The last level recorded, in tenths of a segment
+};
+
+#endif
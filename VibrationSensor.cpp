@@ -0,0 +1,195 @@
+/** @file
+ *  Implementation of the VibrationSensor class. This file contains the
+ *  implementation of the cycle sensor that works out what a laundry machine
+ *  is doing from its vibration.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Profile.h"
+
+// The tiny profile has no cycle sensor
+#if !defined(USE_TINY_PROFILE)
+
+#include "VibrationSensor.h"
+
+// Filter coefficients, 2cos(2*pi*k/N) in fixed point for N = 100. With the
+// sample rate at 976.5625Hz / 10, these are tuned to 0.98, 1.95 (agitate),
+// 13.7, 17.6 and 21.5Hz (spin).
+const int16_t VibrationSensor::coefficients[VibrationSensor::filters] = {
+    8176, 8127, 5222, 3488, 1535
+};
+
+#include <avr/interrupt.h>
+
+// The sensor that samples should be passed to, set by the most recent setup()
+static VibrationSensor *sample_sensor = NULL;
+static uint8_t sample_channel = 0;
+static uint8_t sample_divider = 0;
+
+// Timer0 overflows every 1.024ms for millis(), and the compare A interrupt
+// fires once per overflow, so take every tenth for a ~98Hz sample rate. On
+// host builds the stand-in ISR() makes this an ordinary function, which
+// tools call to play the interrupt against the stand-in ADC registers.
+ISR(TIMER0_COMPA_vect)
+{
+    if (++sample_divider < 10) {
+        return;
+    }
+    sample_divider = 0;
+
+    // The conversion started last time finished long ago, so pass it on
+    // and start the next one rather than waiting on analogRead().
+    if (sample_sensor && !(ADCSRA & _BV(ADSC))) {
+        sample_sensor -> add_sample(ADC);
+    }
+
+    ADMUX   = _BV(REFS0) | sample_channel;
+    ADCSRA |= _BV(ADSC);
+}
+
+
+void VibrationSensor::setup()
+{
+    sample_channel = ((analog_pin >= A0) ? analog_pin - A0 : analog_pin) & 0x07;
+    sample_sensor  = this;
+
+    OCR0A   = 0x80;
+    TIMSK0 |= _BV(OCIE0A);
+}
+
+
+void VibrationSensor::reset()
+{
+    CycleSensor::reset();
+
+    noInterrupts();
+    tail = head;
+    interrupts();
+
+    clear_filters();
+    current_phase = PHASE_UNKNOWN;
+}
+
+
+void VibrationSensor::add_sample(uint16_t sample)
+{
+    uint8_t next = (head + 1) & (buffer_size - 1);
+
+    if (next == tail) {
+        ++dropped;
+    } else {
+        buffer[head] = sample;
+        head = next;
+    }
+}
+
+
+void VibrationSensor::update()
+{
+    // Bound the work done here so the rest of the loop isn't held up
+    for (uint8_t count = 0; count < max_per_update && tail != head; ++count) {
+        filter_sample(buffer[tail]);
+        tail = (tail + 1) & (buffer_size - 1);
+    }
+}
+
+
+void VibrationSensor::clear_filters()
+{
+    memset(s1, 0, sizeof(s1));
+    memset(s2, 0, sizeof(s2));
+    block_samples = 0;
+}
+
+
+void VibrationSensor::filter_sample(uint16_t sample)
+{
+    // Remove the DC offset (including gravity) with a slow low-pass filter,
+    // and drop a couple of bits so the filter state fits comfortably in 32 bits
+    int16_t centred = (int16_t)sample - (int16_t)(bias >> bias_shift);
+    bias += centred;
+    centred >>= 2;
+
+    for (uint8_t filter = 0; filter < filters; ++filter) {
+        int32_t s0 = centred + (((int32_t)coefficients[filter] * s1[filter]) >> coeff_shift) - s2[filter];
+        s2[filter] = s1[filter];
+        s1[filter] = s0;
+    }
+
+    if (++block_samples < block_length) {
+        return;
+    }
+
+    // The block is complete, so work out how much energy each group of
+    // filters saw: s1^2 + s2^2 - coeff * s1 * s2, with the state scaled down
+    // first so the products fit in 32 bits.
+    uint32_t agitate = 0;
+    uint32_t spin    = 0;
+    for (uint8_t filter = 0; filter < filters; ++filter) {
+        int32_t a = s1[filter] >> 4;
+        int32_t b = s2[filter] >> 4;
+        uint32_t energy = (uint32_t)(a * a + b * b - ((((int32_t)coefficients[filter] * a) >> coeff_shift) * b));
+
+        if (filter < agitate_bins) {
+            agitate += energy;
+        } else {
+            spin += energy;
+        }
+    }
+
+    if (spin > spin_threshold && spin > agitate) {
+        current_phase = PHASE_SPIN;
+    } else if (agitate > agitate_threshold) {
+        current_phase = PHASE_AGITATE;
+    } else {
+        current_phase = PHASE_IDLE;
+    }
+
+    set_active(current_phase != PHASE_IDLE);
+    clear_filters();
+}
+
+
+void VibrationSensor::snapshot(Snapshot &snapshot)
+{
+    CycleSensor::snapshot(snapshot);
+    snapshot.field(current_phase);
+    snapshot.field(bias);
+    snapshot.field(s1);
+    snapshot.field(s2);
+    snapshot.field(block_samples);
+
+    noInterrupts();
+    snapshot.field(buffer);
+    snapshot.field(head);
+    snapshot.field(tail);
+    snapshot.field(dropped);
+    interrupts();
+}
+
+#endif
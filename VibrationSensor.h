@@ -0,0 +1,176 @@
+/** @file
+ *  Definition of the VibrationSensor class. This file contains the definition
+ *  of a cycle sensor that works out what a laundry machine is doing from its
+ *  vibration, using an analog accelerometer attached to the machine.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef VibrationSensor_H
+#define VibrationSensor_H
+
+#include <Arduino.h>
+#include "CycleSensor.h"
+#include "Snapshot.h"
+
+/** A cycle sensor that classifies the machine's vibration into idle, agitate
+ *  and spin phases. One axis of an analog accelerometer is sampled at a fixed
+ *  rate (roughly 98Hz) from the Timer0 compare A interrupt, which leaves the
+ *  Timer0 overflow used by millis() alone. Samples are placed in a small ring
+ *  buffer, and update() runs them through a bank of fixed-point Goertzel
+ *  filters tuned to the drum speeds seen while agitating (around 1-2Hz) and
+ *  spinning (around 13-22Hz). At the end of each block of samples the energy
+ *  in each group of filters is used to classify the phase.
+ *
+ *  To keep the cost of update() bounded, only a couple of samples are
+ *  filtered per call; the main loop runs much faster than the sample rate,
+ *  so the ring buffer never needs more than that to keep up.
+ *
+ * @note The ADC conversions are started from the interrupt, so this sensor
+ *       can not be used at the same time as the CurrentSensor.
+ *
+ * @note On non-AVR (host) builds nothing raises the interrupt. Samples can
+ *       be fed to the sensor with add_sample(), or, after setup(), by
+ *       setting the stand-in ADC register and calling TIMER0_COMPA_vect()
+ *       once per Timer0 tick, as host/sensor_replay does with captured
+ *       vibration traces.
+ */
+class VibrationSensor : public CycleSensor
+{
+public:
+    /** Create a new VibrationSensor object.
+     *
+     * @param analog_pin        The analog pin the accelerometer axis is connected to.
+     * @param agitate_threshold The filter energy above which the machine is
+     *                          considered to be agitating.
+     * @param spin_threshold    The filter energy above which the machine is
+     *                          considered to be spinning.
+     * @param idle_time         How long, in milliseconds, the machine must be
+     *                          idle after running before the cycle is finished.
+     * @return A new VibrationSensor object.
+     */
+    VibrationSensor(uint8_t analog_pin, uint32_t agitate_threshold = 50, uint32_t spin_threshold = 50, millis_t idle_time = 180000) :
+        CycleSensor(idle_time), analog_pin(analog_pin),
+        agitate_threshold(agitate_threshold), spin_threshold(spin_threshold),
+        current_phase(PHASE_UNKNOWN), bias(512L << bias_shift), block_samples(0),
+        head(0), tail(0), dropped(0)
+        { clear_filters(); }
+
+
+    /** Start sampling the accelerometer from the Timer0 compare interrupt.
+     */
+    void setup();
+
+
+    /** Reset the sensor for a new cycle. This also discards any partially
+     *  processed block of samples.
+     */
+    void reset();
+
+
+    /** Filter any samples waiting in the ring buffer, and classify the phase
+     *  of the machine at the end of each block.
+     */
+    void update();
+
+
+    /** Add a sample to the ring buffer. This is called from the sampling
+     *  interrupt on AVR builds, and must be kept short. If the buffer is
+     *  full the sample is dropped.
+     *
+     * @param sample The raw ADC reading, in the range 0 to 1023.
+     */
+    void add_sample(uint16_t sample);
+
+
+    /** Obtain the phase the machine was in during the most recent block.
+     *
+     * @return The current phase of the machine's cycle.
+     */
+    Phase phase() {
+        return current_phase;
+    }
+
+
+    /** Obtain the number of samples dropped because the ring buffer was full.
+     *  This should stay at zero; if it doesn't, update() is not being called
+     *  often enough.
+     *
+     * @return The number of dropped samples.
+     */
+    uint16_t dropped_samples() {
+        return dropped;
+    }
+
+
+    /** Save or restore the cycle state, the filter bank and the samples
+     *  waiting to be filtered.
+     *
+     * @param snapshot The snapshot to save the context to or restore it from.
+     */
+    void snapshot(Snapshot &snapshot);
+
+private:
+    static const uint8_t  filters        = 5;   //!< How many Goertzel filters are in the bank
+    static const uint8_t  agitate_bins   = 2;   //!< The first agitate_bins filters detect agitation, the rest spinning
+    static const uint8_t  block_length   = 100; //!< The number of samples in each block
+    static const uint8_t  coeff_shift    = 12;  //!< Fixed point fraction bits in the filter coefficients
+    static const uint8_t  bias_shift     = 8;   //!< Fixed point fraction bits in the DC bias tracker
+    static const uint8_t  buffer_size    = 16;  //!< Ring buffer size, must be a power of two
+    static const uint8_t  max_per_update = 2;   //!< The most samples filtered in a single update()
+    static const int16_t  coefficients[filters];
+
+    /** Clear the state of all the filters ready to start a new block.
+     */
+    void clear_filters();
+
+    /** Run a single sample through the filter bank, classifying the phase
+     *  if the sample completes a block.
+     *
+     * @param sample The raw ADC reading to filter.
+     */
+    void filter_sample(uint16_t sample);
+
+    uint8_t  analog_pin;        //!< The analog pin the accelerometer is connected to
+    uint32_t agitate_threshold; //!< Energy in the agitate filters needed to be agitating
+    uint32_t spin_threshold;    //!< Energy in the spin filters needed to be spinning
+    Phase    current_phase;     //!< The phase detected in the last complete block
+
+    // Filter state
+    int32_t bias;               //!< The DC bias of the signal, in fixed point
+    int32_t s1[filters];        //!< The previous output of each filter
+    int32_t s2[filters];        //!< The output of each filter before the previous one
+    uint8_t block_samples;      //!< How many samples have been filtered in this block
+
+    // Ring buffer shared with the interrupt
+    uint16_t buffer[buffer_size]; //!< Samples waiting to be filtered
+    volatile uint8_t head;        //!< Where the next sample will be stored
+    volatile uint8_t tail;        //!< The next sample to be filtered
+    volatile uint16_t dropped;    //!< How many samples were dropped due to a full buffer
+};
+
+#endif
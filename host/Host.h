@@ -0,0 +1,195 @@
+/** @file
+ *  Definition of the Host interface. This file contains the definition of
+ *  the functions host tools use to drive the simulated clock, pins, serial
+ *  port and EEPROM that the host build of the sketch runs against.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef Host_H
+#define Host_H
+
+#include <Arduino.h>
+#include <string>
+
+/** The simulated hardware the host build of the sketch runs against. Time
+ *  only moves when a tool moves it, or when the sketch waits with delay()
+ *  or a blocking serial write, so runs are repeatable and can go as fast
+ *  as the host allows. millis() and micros() wrap at 32 bits, as they do
+ *  on the device.
+ */
+namespace Host
+{
+    /** A function to be told about every digitalWrite().
+     *
+     * @param pin     The pin written to.
+     * @param level   The level written, HIGH or LOW.
+     * @param context The context pointer given to set_write_hook().
+     */
+    typedef void (*WriteHook)(uint8_t pin, uint8_t level, void *context);
+
+    static const uint8_t  pins        = 20;   //!< The number of pins, including A0-A5
+    static const uint16_t eeprom_size = 1024; //!< The size of the EEPROM, in bytes
+
+    /** Put everything back as it is at power on: the clock at 0, all pins
+     *  inputs and undriven, the EEPROM erased, and the serial port empty.
+     *  Whether core calls are charged for is left as it is.
+     */
+    void reset();
+
+
+    /** Charge each Arduino core call the time it takes on an ATmega328P at
+     *  16 MHz, by moving the clock on, so that micros() sees the sketch's
+     *  I/O take about as long as it does on the device. The time taken by
+     *  the sketch's own code between core calls is not charged, so this is
+     *  a measurement of the I/O and waiting in a path, not a bound on the
+     *  whole of it. Off by default, so that other tools see time move only
+     *  when they move it.
+     *
+     * @param charge `true` to charge core calls, `false` to make them free.
+     */
+    void set_costs(bool charge);
+
+
+    /** Obtain the simulated time.
+     *
+     * @return The time since reset, in microseconds. Unlike micros(), this
+     *         does not wrap.
+     */
+    uint64_t now();
+
+
+    /** Set the simulated time. This can be used to start a run close to a
+     *  millis() wrap.
+     *
+     * @param time The new time, in microseconds.
+     */
+    void set_time(uint64_t time);
+
+
+    /** Move the simulated time on.
+     *
+     * @param time How far to move, in microseconds.
+     */
+    void advance(uint64_t time);
+
+
+    /** Drive an input pin from outside, as the switch or encoder would.
+     *
+     * @param pin   The pin to drive.
+     * @param level The level to drive it to, HIGH or LOW.
+     */
+    void set_input(uint8_t pin, uint8_t level);
+
+
+    /** Set the value analogRead() returns for a pin.
+     *
+     * @param pin   The analog pin, A0 to A5.
+     * @param value The reading, 0 to 1023.
+     */
+    void set_analog(uint8_t pin, int value);
+
+
+    /** Obtain the level the sketch last wrote to an output pin.
+     *
+     * @param pin The pin to look at.
+     * @return HIGH or LOW.
+     */
+    uint8_t get_output(uint8_t pin);
+
+
+    /** Obtain the mode the sketch last set a pin to.
+     *
+     * @param pin The pin to look at.
+     * @return INPUT, OUTPUT or INPUT_PULLUP.
+     */
+    uint8_t get_mode(uint8_t pin);
+
+
+    /** Set the function to be told about every digitalWrite().
+     *
+     * @param hook    The function to call, or NULL to stop calling one.
+     * @param context A pointer passed to the hook.
+     */
+    void set_write_hook(WriteHook hook, void *context);
+
+
+    /** Queue characters to be read from the serial port by the sketch.
+     *
+     * @param text The characters to queue.
+     */
+    void serial_input(const char *text);
+
+
+    /** Take a complete line the sketch has sent over the serial port.
+     *
+     * @param line Set to the line, without the line ending.
+     * @return `true` if there was a complete line, `false` if not.
+     */
+    bool serial_line(std::string &line);
+
+
+    /** Obtain how many bytes the sketch has written to the serial port.
+     *
+     * @return The number of bytes written since reset.
+     */
+    uint32_t serial_written();
+
+
+    /** Obtain how long the sketch has spent waiting for room in the serial
+     *  transmit buffer.
+     *
+     * @return The total time spent waiting since reset, in microseconds.
+     */
+    uint64_t serial_waited();
+
+
+    /** Obtain the EEPROM contents, so a tool can save, restore or inspect
+     *  them.
+     *
+     * @return A pointer to the `eeprom_size` bytes of EEPROM.
+     */
+    uint8_t *eeprom();
+
+
+    /** Save the state of the board: the clock, pins, serial port and
+     *  EEPROM. The write hook belongs to the tool, so isn't included.
+     *
+     * @param board Set to the saved state.
+     */
+    void save(std::string &board);
+
+
+    /** Put the board back into a state saved by save().
+     *
+     * @param board The saved state.
+     */
+    void restore(const std::string &board);
+};
+
+#endif
@@ -0,0 +1,719 @@
+/** @file
+ *  Implementation of the host stand-ins for the Arduino core, EEPROM and
+ *  Grove_LED_Bar libraries, and of the Host interface that drives them.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Grove_LED_Bar.h>
+#include "Host.h"
+
+volatile uint8_t host_pin_registers[5];
+volatile uint8_t host_port_registers[5];
+
+// The ADC and Timer0 registers the VibrationSensor's sampling interrupt
+// uses, so tools can play the interrupt. Nothing else here looks at them.
+volatile uint8_t  ADCSRA;
+volatile uint8_t  ADMUX;
+volatile uint16_t ADC;
+volatile uint8_t  OCR0A;
+volatile uint8_t  TIMSK0;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+namespace
+{
+    const int serial_buffer = 63; //!< How many bytes the serial transmit buffer holds
+
+    // Typical times taken by the Arduino AVR core calls on an ATmega328P at
+    // 16 MHz, in nanoseconds. EEPROM writes cost nothing, as on the device
+    // the sketch only makes them from the EEPROM ready interrupt.
+    const uint32_t cost_millis        = 1500;   //!< millis()
+    const uint32_t cost_micros        = 3500;   //!< micros()
+    const uint32_t cost_pin_mode      = 4000;   //!< pinMode()
+    const uint32_t cost_digital_write = 3600;   //!< digitalWrite()
+    const uint32_t cost_digital_read  = 3200;   //!< digitalRead()
+    const uint32_t cost_analog_read   = 112000; //!< analogRead(), mostly the conversion
+    const uint32_t cost_analog_write  = 6000;   //!< analogWrite()
+    const uint32_t cost_serial_poll   = 1000;   //!< Serial.available() and availableForWrite()
+    const uint32_t cost_serial_read   = 1500;   //!< Serial.read()
+    const uint32_t cost_serial_write  = 5000;   //!< Serial.write() of a byte, when there's room
+    const uint32_t cost_eeprom_read   = 1000;   //!< EEPROM.read()
+
+    uint64_t time_now;                //!< The simulated time, in microseconds
+    uint8_t  modes[Host::pins];       //!< The mode of each pin
+    uint8_t  inputs[Host::pins];      //!< The level each pin is driven to from outside
+    bool     driven[Host::pins];      //!< Is each pin driven from outside?
+    uint8_t  outputs[Host::pins];     //!< The level last written to each pin
+    int      analog[Host::pins];      //!< The analogRead() value for each pin
+
+    Host::WriteHook write_hook;       //!< The function told about writes, or NULL
+    void *write_context;              //!< The pointer passed to the write hook
+
+    std::string serial_in;            //!< Characters waiting for the sketch to read
+    std::string serial_out;           //!< Characters sent that no tool has taken yet
+    uint32_t serial_count;            //!< How many bytes have been sent since reset
+    uint64_t serial_wait;             //!< How long writes have waited for room since reset, in microseconds
+    uint64_t byte_time;               //!< How long a byte takes to send, in microseconds, or 0 before begin()
+    uint64_t send_end;                //!< When the transmit buffer will be empty, in microseconds
+
+    uint8_t eeprom_data[Host::eeprom_size]; //!< The EEPROM contents
+
+    bool     charging;                //!< Are core calls charged for?
+    uint32_t charged;                 //!< Time charged but not yet added to the clock, in nanoseconds
+
+
+    /** Work out how much room there is in the serial transmit buffer.
+     *
+     * @return The number of bytes that can be written without waiting.
+     */
+    int buffer_space()
+    {
+        if (!byte_time || send_end <= time_now) {
+            return serial_buffer;
+        }
+
+        int waiting = (send_end - time_now + byte_time - 1) / byte_time;
+        return (waiting < serial_buffer) ? serial_buffer - waiting : 0;
+    }
+
+
+    /** Charge a core call for the time it takes, if charging is on.
+     *
+     * @param cost The time the call takes, in nanoseconds.
+     */
+    void charge(uint32_t cost)
+    {
+        if (charging) {
+            charged  += cost;
+            time_now += charged / 1000;
+            charged  %= 1000;
+        }
+    }
+
+
+    /** Work out the level a pin reads as, and update its port input register.
+     *
+     * @param pin The pin to update.
+     */
+    void update_pin(uint8_t pin)
+    {
+        uint8_t level;
+        if (modes[pin] == OUTPUT) {
+            level = outputs[pin];
+        } else if (driven[pin]) {
+            level = inputs[pin];
+        } else {
+            level = (modes[pin] == INPUT_PULLUP) ? HIGH : LOW;
+        }
+
+        volatile uint8_t &reg = host_pin_registers[digitalPinToPort(pin)];
+        if (level) {
+            reg |= digitalPinToBitMask(pin);
+        } else {
+            reg &= ~digitalPinToBitMask(pin);
+        }
+    }
+
+
+    /** Print an unsigned number in the given base.
+     *
+     * @param value The number to print.
+     * @param base  The base to print it in.
+     * @return The number of characters printed.
+     */
+    size_t print_number(unsigned long value, int base)
+    {
+        char digits[sizeof(value) * 8 + 1];
+        uint8_t length = 0;
+
+        do {
+            uint8_t digit = value % base;
+            digits[length++] = (digit < 10) ? '0' + digit : 'A' + digit - 10;
+            value /= base;
+        } while (value);
+
+        for (uint8_t index = length; index; --index) {
+            Serial.write(digits[index - 1]);
+        }
+
+        return length;
+    }
+
+
+    /** Add a value to a saved board state.
+     *
+     * @param board The saved state to add to.
+     * @param value The value to add.
+     */
+    template <class T> void put(std::string &board, const T &value)
+    {
+        board.append((const char *)&value, sizeof(T));
+    }
+
+
+    /** Take a value from a saved board state.
+     *
+     * @param board    The saved state.
+     * @param position Where the value starts; moved on past it.
+     * @param value    Set to the value.
+     */
+    template <class T> void get(const std::string &board, size_t &position, T &value)
+    {
+        memcpy(&value, board.data() + position, sizeof(T));
+        position += sizeof(T);
+    }
+
+
+    /** Add a string to a saved board state, preceded by its length.
+     *
+     * @param board The saved state to add to.
+     * @param text  The string to add.
+     */
+    void put_text(std::string &board, const std::string &text)
+    {
+        put(board, text.size());
+        board += text;
+    }
+
+
+    /** Take a string added by put_text() from a saved board state.
+     *
+     * @param board    The saved state.
+     * @param position Where the string starts; moved on past it.
+     * @param text     Set to the string.
+     */
+    void get_text(const std::string &board, size_t &position, std::string &text)
+    {
+        size_t length;
+        get(board, position, length);
+        text.assign(board, position, length);
+        position += length;
+    }
+}
+
+
+/* ------------------------------------------------------------------------
+ *  Host
+ */
+
+void Host::reset()
+{
+    time_now = 0;
+    charged  = 0;
+
+    memset(modes, INPUT, sizeof(modes));
+    memset(inputs, LOW, sizeof(inputs));
+    memset(driven, 0, sizeof(driven));
+    memset(outputs, LOW, sizeof(outputs));
+    memset(analog, 0, sizeof(analog));
+    memset((void *)host_pin_registers, 0, sizeof(host_pin_registers));
+    memset((void *)host_port_registers, 0, sizeof(host_port_registers));
+
+    write_hook    = NULL;
+    write_context = NULL;
+
+    serial_in.clear();
+    serial_out.clear();
+    serial_count = 0;
+    serial_wait  = 0;
+    byte_time    = 0;
+    send_end     = 0;
+
+    // Erased EEPROM reads as all ones
+    memset(eeprom_data, 0xff, sizeof(eeprom_data));
+}
+
+
+void Host::set_costs(bool charge)
+{
+    charging = charge;
+}
+
+
+uint64_t Host::now()
+{
+    return time_now;
+}
+
+
+void Host::set_time(uint64_t time)
+{
+    time_now = time;
+    send_end = time;
+}
+
+
+void Host::advance(uint64_t time)
+{
+    time_now += time;
+}
+
+
+void Host::set_input(uint8_t pin, uint8_t level)
+{
+    inputs[pin] = level ? HIGH : LOW;
+    driven[pin] = true;
+    update_pin(pin);
+}
+
+
+void Host::set_analog(uint8_t pin, int value)
+{
+    analog[pin] = value;
+}
+
+
+uint8_t Host::get_output(uint8_t pin)
+{
+    return outputs[pin];
+}
+
+
+uint8_t Host::get_mode(uint8_t pin)
+{
+    return modes[pin];
+}
+
+
+void Host::set_write_hook(WriteHook hook, void *context)
+{
+    write_hook    = hook;
+    write_context = context;
+}
+
+
+void Host::serial_input(const char *text)
+{
+    serial_in += text;
+}
+
+
+bool Host::serial_line(std::string &line)
+{
+    size_t end = serial_out.find('\n');
+    if (end == std::string::npos) {
+        return false;
+    }
+
+    line.assign(serial_out, 0, end);
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.erase(line.size() - 1);
+    }
+    serial_out.erase(0, end + 1);
+
+    return true;
+}
+
+
+uint32_t Host::serial_written()
+{
+    return serial_count;
+}
+
+
+uint64_t Host::serial_waited()
+{
+    return serial_wait;
+}
+
+
+uint8_t *Host::eeprom()
+{
+    return eeprom_data;
+}
+
+
+void Host::save(std::string &board)
+{
+    board.clear();
+    put(board, time_now);
+    put(board, charged);
+    put(board, modes);
+    put(board, inputs);
+    put(board, driven);
+    put(board, outputs);
+    put(board, analog);
+    for (uint8_t port = 0; port < sizeof(host_pin_registers); ++port) {
+        put(board, (uint8_t)host_pin_registers[port]);
+        put(board, (uint8_t)host_port_registers[port]);
+    }
+    put_text(board, serial_in);
+    put_text(board, serial_out);
+    put(board, serial_count);
+    put(board, serial_wait);
+    put(board, byte_time);
+    put(board, send_end);
+    put(board, eeprom_data);
+}
+
+
+void Host::restore(const std::string &board)
+{
+    size_t position = 0;
+    get(board, position, time_now);
+    get(board, position, charged);
+    get(board, position, modes);
+    get(board, position, inputs);
+    get(board, position, driven);
+    get(board, position, outputs);
+    get(board, position, analog);
+    for (uint8_t port = 0; port < sizeof(host_pin_registers); ++port) {
+        uint8_t value;
+        get(board, position, value);
+        host_pin_registers[port] = value;
+        get(board, position, value);
+        host_port_registers[port] = value;
+    }
+    get_text(board, position, serial_in);
+    get_text(board, position, serial_out);
+    get(board, position, serial_count);
+    get(board, position, serial_wait);
+    get(board, position, byte_time);
+    get(board, position, send_end);
+    get(board, position, eeprom_data);
+}
+
+
+/* ------------------------------------------------------------------------
+ *  Arduino core
+ */
+
+uint32_t millis()
+{
+    charge(cost_millis);
+    return (uint32_t)(time_now / 1000);
+}
+
+
+uint32_t micros()
+{
+    charge(cost_micros);
+    return (uint32_t)time_now;
+}
+
+
+void delay(unsigned long ms)
+{
+    time_now += (uint64_t)ms * 1000;
+}
+
+
+void delayMicroseconds(unsigned int us)
+{
+    time_now += us;
+}
+
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    charge(cost_pin_mode);
+    modes[pin] = mode;
+    update_pin(pin);
+}
+
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    charge(cost_digital_write);
+    outputs[pin] = level ? HIGH : LOW;
+
+    volatile uint8_t &reg = host_port_registers[digitalPinToPort(pin)];
+    if (outputs[pin]) {
+        reg |= digitalPinToBitMask(pin);
+    } else {
+        reg &= ~digitalPinToBitMask(pin);
+    }
+    update_pin(pin);
+
+    if (write_hook) {
+        write_hook(pin, outputs[pin], write_context);
+    }
+}
+
+
+int digitalRead(uint8_t pin)
+{
+    charge(cost_digital_read);
+    return (host_pin_registers[digitalPinToPort(pin)] & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+
+int analogRead(uint8_t pin)
+{
+    charge(cost_analog_read);
+    return analog[pin];
+}
+
+
+void analogWrite(uint8_t pin, int value)
+{
+    charge(cost_analog_write - cost_digital_write);
+    digitalWrite(pin, value ? HIGH : LOW);
+}
+
+
+/* ------------------------------------------------------------------------
+ *  HardwareSerial
+ */
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    // Ten bits per byte, with the start and stop bits
+    byte_time = 10000000UL / baud;
+    send_end  = time_now;
+}
+
+
+int HardwareSerial::available()
+{
+    charge(cost_serial_poll);
+    return serial_in.size();
+}
+
+
+int HardwareSerial::read()
+{
+    charge(cost_serial_read);
+    if (serial_in.empty()) {
+        return -1;
+    }
+
+    uint8_t next = serial_in[0];
+    serial_in.erase(0, 1);
+
+    return next;
+}
+
+
+int HardwareSerial::availableForWrite()
+{
+    charge(cost_serial_poll);
+    return buffer_space();
+}
+
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    charge(cost_serial_write);
+
+    if (byte_time) {
+        // A full buffer makes the write wait for room, as it does on the device
+        if (!buffer_space()) {
+            uint64_t room = send_end - (serial_buffer - 1) * byte_time;
+            serial_wait += room - time_now;
+            time_now = room;
+        }
+
+        send_end = ((send_end > time_now) ? send_end : time_now) + byte_time;
+    }
+
+    serial_out += (char)value;
+    ++serial_count;
+
+    return 1;
+}
+
+
+size_t HardwareSerial::print(const char *text)
+{
+    size_t length = 0;
+    while (text[length]) {
+        write(text[length++]);
+    }
+
+    return length;
+}
+
+
+size_t HardwareSerial::print(char value)
+{
+    return write(value);
+}
+
+
+size_t HardwareSerial::print(unsigned char value, int base)
+{
+    return print_number(value, base);
+}
+
+
+size_t HardwareSerial::print(int value, int base)
+{
+    return print((long)value, base);
+}
+
+
+size_t HardwareSerial::print(unsigned int value, int base)
+{
+    return print_number(value, base);
+}
+
+
+size_t HardwareSerial::print(long value, int base)
+{
+    if (value < 0 && base == DEC) {
+        return write('-') + print_number(-(unsigned long)value, base);
+    }
+
+    return print_number((unsigned long)value, base);
+}
+
+
+size_t HardwareSerial::print(unsigned long value, int base)
+{
+    return print_number(value, base);
+}
+
+
+size_t HardwareSerial::println()
+{
+    return write('\r') + write('\n');
+}
+
+
+/* ------------------------------------------------------------------------
+ *  EEPROMClass
+ */
+
+uint8_t EEPROMClass::read(int address)
+{
+    charge(cost_eeprom_read);
+    return eeprom_data[address % Host::eeprom_size];
+}
+
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+    eeprom_data[address % Host::eeprom_size] = value;
+}
+
+
+void EEPROMClass::update(int address, uint8_t value)
+{
+    write(address, value);
+}
+
+
+uint16_t EEPROMClass::length()
+{
+    return Host::eeprom_size;
+}
+
+
+/* ------------------------------------------------------------------------
+ *  Grove_LED_Bar
+ */
+
+Grove_LED_Bar::Grove_LED_Bar(unsigned char clock_pin, unsigned char data_pin, bool green_to_red, LedType type) :
+    count((type == LED_CIRCULAR_24) ? 24 : 10), begun(false), frames(0),
+    clock_pin(clock_pin), data_pin(data_pin), green_to_red(green_to_red)
+{
+    memset(leds, 0, sizeof(leds));
+}
+
+
+void Grove_LED_Bar::begin()
+{
+    pinMode(clock_pin, OUTPUT);
+    pinMode(data_pin, OUTPUT);
+    begun = true;
+}
+
+
+void Grove_LED_Bar::setLevel(float level)
+{
+    // The library lights whole LEDs up to the level, and the LED the level
+    // falls in to one of eight brightness steps
+    level = (level < 0.0f) ? 0.0f : (level > count) ? count : level;
+    int eighths = (int)(level * 8);
+
+    for (uint8_t led = 0; led < count; ++led) {
+        int steps = (eighths > 8) ? 8 : eighths;
+        leds[led] = (uint8_t)~(0xff << steps);
+        eighths -= steps;
+    }
+    show();
+}
+
+
+void Grove_LED_Bar::setLeds(uint8_t *leds)
+{
+    memcpy(this -> leds, leds, count);
+    show();
+}
+
+
+void Grove_LED_Bar::show()
+{
+    // Each chip takes a command word and a word for each of its twelve
+    // outputs, with the outputs past the end of the bar sent as off
+    for (uint8_t first = 0; first < count; first += 12) {
+        send(0);
+        for (uint8_t output = 0; output < 12; ++output) {
+            uint8_t led = first + output;
+            if (led >= count) {
+                send(0);
+            } else {
+                send(leds[green_to_red ? count - 1 - led : led]);
+            }
+        }
+    }
+    latch();
+
+    ++frames;
+}
+
+
+void Grove_LED_Bar::send(uint16_t data)
+{
+    // The chip reads a bit on every clock edge, so the clock is toggled
+    // once per bit, from whatever level it was left at
+    for (uint8_t bit = 0; bit < 16; ++bit) {
+        digitalWrite(data_pin, (data & 0x8000) ? HIGH : LOW);
+        digitalWrite(clock_pin, digitalRead(clock_pin) ? LOW : HIGH);
+        data <<= 1;
+    }
+}
+
+
+void Grove_LED_Bar::latch()
+{
+    // The data line has to be still for 220us before the four pulses on it
+    // that latch the data
+    digitalWrite(data_pin, LOW);
+    delayMicroseconds(220);
+
+    for (uint8_t pulse = 0; pulse < 4; ++pulse) {
+        digitalWrite(data_pin, HIGH);
+        digitalWrite(data_pin, LOW);
+    }
+}
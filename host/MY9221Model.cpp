@@ -0,0 +1,186 @@
+/** @file
+ *  Implementation of the MY9221Model class. This file contains the
+ *  implementation of a host model of the MY9221 LED driver chip used on the
+ *  Grove LED bar, which decodes the pin writes a bar driver makes into
+ *  latched frames.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include <stdio.h>
+#include "MY9221Model.h"
+#include "Host.h"
+
+MY9221Model::MY9221Model(uint8_t clock_pin, uint8_t data_pin) :
+    clock_pin(clock_pin), data_pin(data_pin),
+    clock_level(Host::get_output(clock_pin)), data_level(Host::get_output(data_pin)),
+    last_clock(0), last_data(0)
+{
+    clear();
+    Host::set_write_hook(write_hook, this);
+}
+
+
+MY9221Model::~MY9221Model()
+{
+    Host::set_write_hook(NULL, NULL);
+}
+
+
+void MY9221Model::clear()
+{
+    memset(shift, 0, sizeof(shift));
+    bits   = 0;
+    edges  = 0;
+    rising = false;
+    pulses = 0;
+    quiet  = 0;
+
+    frames.clear();
+    violations.clear();
+}
+
+
+void MY9221Model::write_hook(uint8_t pin, uint8_t level, void *context)
+{
+    MY9221Model *model = (MY9221Model *)context;
+
+    if (pin != model -> clock_pin && pin != model -> data_pin) {
+        return;
+    }
+
+    if (Host::get_mode(pin) != OUTPUT) {
+        char message[64];
+        snprintf(message, sizeof(message), "pin %d written while not an output", pin);
+        model -> violation(message);
+    }
+
+    // Writing the level a pin is already at doesn't make an edge
+    if (pin == model -> clock_pin && level != model -> clock_level) {
+        model -> clock_level = level;
+        model -> clock_edge();
+    } else if (pin == model -> data_pin && level != model -> data_level) {
+        model -> data_level = level;
+        model -> data_edge(level);
+    }
+}
+
+
+void MY9221Model::clock_edge()
+{
+    if (!edges++) {
+        frame_start = Host::now();
+    }
+
+    if (pulses) {
+        char message[64];
+        snprintf(message, sizeof(message), "clock changed after %d of the 4 latch pulses", pulses);
+        violation(message);
+    }
+
+    // The chip is a 208 bit shift register, so anything past that pushes
+    // the oldest bits out of the far end
+    if (bits == frame_bits) {
+        violation("more than 208 bits sent before a latch");
+    } else {
+        ++bits;
+    }
+
+    uint16_t carry = data_level ? 1 : 0;
+    for (int8_t word = frame_bits / 16 - 1; word >= 0; --word) {
+        uint16_t out = shift[word] >> 15;
+        shift[word] = (shift[word] << 1) | carry;
+        carry = out;
+    }
+
+    last_clock = Host::now();
+    rising = false;
+    pulses = 0;
+}
+
+
+void MY9221Model::data_edge(uint8_t level)
+{
+    if (!edges++) {
+        frame_start = Host::now();
+    }
+
+    if (level) {
+        // The start time is measured to the first pulse, from whichever
+        // line changed last before it
+        if (!pulses && !rising) {
+            quiet = Host::now() - ((last_clock > last_data) ? last_clock : last_data);
+        }
+        rising = true;
+    } else if (rising) {
+        rising = false;
+        if (++pulses == 4) {
+            latch();
+        }
+    }
+
+    last_data = Host::now();
+}
+
+
+void MY9221Model::latch()
+{
+    char message[64];
+
+    if (quiet < start_time) {
+        snprintf(message, sizeof(message), "latched after %u us of quiet, needs %u", (unsigned)quiet, start_time);
+        violation(message);
+    }
+
+    if (bits != frame_bits) {
+        snprintf(message, sizeof(message), "latched %u bits, needs %u", bits, frame_bits);
+        violation(message);
+    }
+
+    Frame frame;
+    frame.command = shift[0];
+    memcpy(frame.channel, &shift[1], sizeof(frame.channel));
+    frame.edges = edges;
+    frame.start = frame_start;
+    frame.end   = Host::now();
+    frames.push_back(frame);
+
+    memset(shift, 0, sizeof(shift));
+    bits   = 0;
+    edges  = 0;
+    pulses = 0;
+    quiet  = 0;
+}
+
+
+void MY9221Model::violation(const std::string &message)
+{
+    char when[32];
+    snprintf(when, sizeof(when), "%llu us: ", (unsigned long long)Host::now());
+    violations.push_back(when + message);
+}
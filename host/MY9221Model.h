@@ -0,0 +1,156 @@
+/** @file
+ *  Definition of the MY9221Model class. This file contains the definition of
+ *  a host model of the MY9221 LED driver chip used on the Grove LED bar,
+ *  which decodes the pin writes a bar driver makes into latched frames.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef MY9221Model_H
+#define MY9221Model_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+/** A model of the MY9221 LED driver on the far end of the bar's clock and
+ *  data pins. It watches every digitalWrite() to those pins, through the
+ *  Host write hook, and decodes them the way the chip would: a bit is
+ *  taken from the data pin on every clock edge, rising or falling, and
+ *  once the data pin has been held still for the start time, four pulses
+ *  on it with the clock held still latch the last 208 bits. Those bits are
+ *  a 16 bit command word followed by a 16 bit word for each of the twelve
+ *  outputs.
+ *
+ *  Anything the chip would not accept is recorded as a violation, rather
+ *  than being quietly worked around, so that a bar driver can be shown to
+ *  follow the protocol exactly. The number of pin edges each frame took is
+ *  also kept, so the cost of different drivers can be compared.
+ */
+class MY9221Model
+{
+public:
+    static const uint8_t  channels   = 12;  //!< The number of outputs the chip has
+    static const uint8_t  frame_bits = 208; //!< The bits in a frame: the command and a word per output
+    static const uint16_t start_time = 220; //!< How long the data line must be still before a latch, in microseconds
+
+    /** A frame latched by the chip.
+     */
+    struct Frame {
+        uint16_t command;            //!< The command word
+        uint16_t channel[channels];  //!< The word for each output, in the order they were sent
+        uint32_t edges;              //!< How many clock and data edges the frame took, including the latch
+        uint64_t start;              //!< When the first edge of the frame happened, in microseconds
+        uint64_t end;                //!< When the frame was latched, in microseconds
+    };
+
+    /** Create a new MY9221Model object, and attach it to the Host write
+     *  hook. Only one model can be attached at a time.
+     *
+     * @param clock_pin The pin the chip's clock input is connected to.
+     * @param data_pin  The pin the chip's data input is connected to.
+     * @return A new MY9221Model object.
+     */
+    MY9221Model(uint8_t clock_pin, uint8_t data_pin);
+
+    /** Detach the model from the Host write hook.
+     */
+    ~MY9221Model();
+
+
+    /** Obtain the frames latched so far.
+     *
+     * @return The latched frames, oldest first.
+     */
+    const std::vector<Frame> &get_frames() {
+        return frames;
+    }
+
+
+    /** Obtain the protocol violations seen so far.
+     *
+     * @return A description of each violation, oldest first.
+     */
+    const std::vector<std::string> &get_violations() {
+        return violations;
+    }
+
+
+    /** Forget the frames and violations seen so far.
+     */
+    void clear();
+
+private:
+    /** Handle a pin write, as the Host write hook.
+     *
+     * @param pin     The pin written to.
+     * @param level   The level written.
+     * @param context The model the write is for.
+     */
+    static void write_hook(uint8_t pin, uint8_t level, void *context);
+
+    /** Handle a change of level on the clock pin.
+     */
+    void clock_edge();
+
+    /** Handle a change of level on the data pin.
+     *
+     * @param level The new level of the data pin.
+     */
+    void data_edge(uint8_t level);
+
+    /** Latch the bits shifted in so far as a frame.
+     */
+    void latch();
+
+    /** Record a protocol violation.
+     *
+     * @param message A description of what went wrong.
+     */
+    void violation(const std::string &message);
+
+    uint8_t clock_pin;                   //!< The pin the clock input is connected to
+    uint8_t data_pin;                    //!< The pin the data input is connected to
+    uint8_t clock_level;                 //!< The level the clock pin was last seen at
+    uint8_t data_level;                  //!< The level the data pin was last seen at
+
+    uint16_t shift[frame_bits / 16];     //!< The bits shifted in for the frame so far
+    uint16_t bits;                       //!< How many bits have been shifted in since the last latch
+    uint32_t edges;                      //!< How many edges there have been since the last latch
+    uint64_t frame_start;                //!< When the first edge since the last latch happened
+    uint64_t last_clock;                 //!< When the clock last changed, in microseconds
+    uint64_t last_data;                  //!< When the data line last changed, in microseconds
+    bool rising;                         //!< Has the data line gone high since the clock last changed?
+    uint8_t pulses;                      //!< How many whole data pulses there have been since the clock last changed
+    uint64_t quiet;                      //!< How long the lines were still before the first of those pulses, in microseconds
+
+    std::vector<Frame> frames;           //!< The frames latched so far
+    std::vector<std::string> violations; //!< The protocol violations seen so far
+};
+
+#endif
@@ -0,0 +1,145 @@
+/** @file
+ *  Implementation of the Script class. This file contains the implementation
+ *  of the class host tools use to describe the inputs to give the sketch.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include "Host.h"
+#include "Sketch.h"
+#include "Script.h"
+
+bool Script::add(uint64_t at, Kind kind, const std::string &text)
+{
+    if (!actions.empty() && at < actions.back().at) {
+        return false;
+    }
+
+    Action action;
+    action.at   = at;
+    action.kind = kind;
+    action.text = text;
+    actions.push_back(action);
+
+    return true;
+}
+
+
+bool Script::load(FILE *file, std::string &error)
+{
+    char line[256];
+    unsigned number = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        ++number;
+
+        unsigned long long at;
+        char command[16];
+        int used = 0;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0' || line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+
+        bool good = sscanf(line, "%llu %15s %n", &at, command, &used) == 2;
+        if (good) {
+            if (!strcmp(command, "press")) {
+                good = add(at, ACTION_PRESS);
+            } else if (!strcmp(command, "release")) {
+                good = add(at, ACTION_RELEASE);
+            } else if (!strcmp(command, "send")) {
+                good = add(at, ACTION_SEND, line + used);
+            } else if (!strcmp(command, "end")) {
+                good = add(at, ACTION_END);
+            } else {
+                good = false;
+            }
+        }
+
+        if (!good) {
+            error = "line " + std::to_string(number) + ": can't use \"" + line + "\"";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void Script::add_standard_run()
+{
+    add(0,       ACTION_PRESS);
+    add(120,     ACTION_RELEASE);
+    add(2500,    ACTION_PRESS);
+    add(2620,    ACTION_RELEASE);
+    add(3200,    ACTION_PRESS);
+    add(3320,    ACTION_RELEASE);
+    add(5410000, ACTION_PRESS);
+    add(5414000, ACTION_RELEASE);
+    add(5420000, ACTION_END);
+}
+
+
+bool Script::play(size_t &next, uint64_t time) const
+{
+    while (next < actions.size() && actions[next].at <= time) {
+        const Action &action = actions[next++];
+
+        switch (action.kind) {
+            case ACTION_PRESS:
+                Sketch::set_switch(true);
+                break;
+
+            case ACTION_RELEASE:
+                Sketch::set_switch(false);
+                break;
+
+            case ACTION_SEND:
+                Host::serial_input((action.text + "\n").c_str());
+                break;
+
+            case ACTION_END:
+                return false;
+        }
+    }
+
+    return next < actions.size() || time < end();
+}
+
+
+uint64_t Script::end() const
+{
+    for (size_t index = 0; index < actions.size(); ++index) {
+        if (actions[index].kind == ACTION_END) {
+            return actions[index].at;
+        }
+    }
+
+    return actions.empty() ? 0 : actions.back().at;
+}
@@ -0,0 +1,130 @@
+/** @file
+ *  Definition of the Script class. This file contains the definition of the
+ *  class host tools use to describe the inputs to give the sketch: when the
+ *  switch is pressed and released, and what is sent over the serial port.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Script_H
+#define Script_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** A script of inputs for the sketch. Scripts can be built in code, or read
+ *  from text with one action per line:
+ *
+ *  - `<time> press` presses the switch.
+ *  - `<time> release` releases the switch.
+ *  - `<time> send <text>` sends the text, and a newline, over the serial
+ *    port, for example `send M` to ask for the state machine metrics.
+ *  - `<time> end` ends the run.
+ *
+ *  Times are in milliseconds from the start of the run, and may not go
+ *  backwards. Blank lines and lines starting with `#` are ignored.
+ */
+class Script
+{
+public:
+    /** The kinds of action.
+     */
+    enum Kind {
+        ACTION_PRESS,    //!< Press the switch
+        ACTION_RELEASE,  //!< Release the switch
+        ACTION_SEND,     //!< Send a line over the serial port
+        ACTION_END       //!< End the run
+    };
+
+    /** One action in the script.
+     */
+    struct Action {
+        uint64_t    at;    //!< When to do it, in milliseconds from the start of the run
+        Kind        kind;  //!< What to do
+        std::string text;  //!< The line to send, for ACTION_SEND
+    };
+
+    /** Add an action to the end of the script.
+     *
+     * @param at   When to do it, in milliseconds from the start of the run.
+     * @param kind What to do.
+     * @param text The line to send, for ACTION_SEND.
+     * @return `true` if the action was added, `false` if it comes before
+     *         the last one.
+     */
+    bool add(uint64_t at, Kind kind, const std::string &text = "");
+
+
+    /** Read actions from a text file, adding them to the script.
+     *
+     * @param file  The file to read.
+     * @param error Set to a description of the problem, if there is one.
+     * @return `true` if the whole file was read, `false` if not.
+     */
+    bool load(FILE *file, std::string &error);
+
+
+    /** Add the actions for the run tools use when they aren't given a
+     *  script: wake the unit, set three bars, let the timer run out, and
+     *  turn it off with a long press once it has finished.
+     */
+    void add_standard_run();
+
+
+    /** Do every action that is due.
+     *
+     * @param next The index of the next action to do. Updated to the index
+     *             of the first action that isn't due yet.
+     * @param time The time since the start of the run, in milliseconds.
+     * @return `false` if the run has ended, `true` if not.
+     */
+    bool play(size_t &next, uint64_t time) const;
+
+
+    /** Obtain when the run ends: the time of the end action, or of the last
+     *  action if there isn't one.
+     *
+     * @return The end time, in milliseconds from the start of the run.
+     */
+    uint64_t end() const;
+
+
+    /** Obtain the actions in the script.
+     *
+     * @return The actions, in order.
+     */
+    const std::vector<Action> &get_actions() const {
+        return actions;
+    }
+
+private:
+    std::vector<Action> actions; //!< The actions, in order
+};
+
+#endif
@@ -0,0 +1,90 @@
+/** @file
+ *  Implementation of the Sketch interface. This file builds the laundry
+ *  sketch itself, and contains the implementation of the functions host
+ *  tools use to run it.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Host.h"
+#include "Sketch.h"
+
+// The sketch is built here, as the Arduino IDE would build it
+#include "laundry.ino"
+
+//! Names for the State::StateID values
+static const char *const state_names[] = { "none", "off", "startup", "program", "timer", "wait" };
+static_assert(sizeof(state_names) / sizeof(state_names[0]) == State::STATE_MAX, "every state needs a name");
+
+//! Names for the SwitchControl::Event values
+static const char *const event_names[] = { "none", "pressed", "longpress", "released", "repeat", "doublepress" };
+
+void Sketch::start()
+{
+    Host::reset();
+    setup();
+}
+
+
+void Sketch::step(uint32_t time)
+{
+    loop();
+    Host::advance(time);
+}
+
+
+void Sketch::run(millis_t time, uint32_t step)
+{
+    uint64_t end = Host::now() + (uint64_t)time * 1000;
+    while (Host::now() < end) {
+        Sketch::step(step);
+    }
+}
+
+
+millis_t Sketch::bar_length()
+{
+    return (millis_t)bar_time * 1000;
+}
+
+
+void Sketch::set_switch(bool pressed)
+{
+    Host::set_input(switch_pin, pressed ? HIGH : LOW);
+}
+
+
+const char *Sketch::state_name(unsigned long state)
+{
+    return (state < State::STATE_MAX) ? state_names[state] : "unknown";
+}
+
+
+const char *Sketch::event_name(unsigned long event)
+{
+    return (event < sizeof(event_names) / sizeof(event_names[0])) ? event_names[event] : "unknown";
+}
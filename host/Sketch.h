@@ -0,0 +1,125 @@
+/** @file
+ *  Definition of the Sketch interface. This file contains the definition
+ *  of the functions host tools use to run the whole laundry sketch on the
+ *  simulated board, and declarations of the sketch's objects they look at.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Sketch_H
+#define Sketch_H
+
+#include <Arduino.h>
+#include "TimeTypes.h"
+#include "SwitchControl.h"
+#include "FSM.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "Snapshot.h"
+
+/** The laundry sketch, built as it is for the device, running on the
+ *  simulated board. Each loop() is taken to run for `loop_time`, on top of
+ *  any time it spends waiting, such as for room in the serial buffer, so
+ *  that the scheduler sees time pass as it would on the device.
+ */
+namespace Sketch
+{
+    static const uint32_t loop_time = 500; //!< How long a loop() is taken to run for, in microseconds
+
+    /** Reset the simulated board and run the sketch's setup(). This can
+     *  only be done once per run of a tool, as the sketch's objects are only
+     *  constructed once.
+     */
+    void start();
+
+
+    /** Run the sketch's loop() once.
+     *
+     * @param time How long the loop() is taken to run for, in microseconds.
+     *             Longer times let quiet stretches be run through quickly.
+     */
+    void step(uint32_t time = loop_time);
+
+
+    /** Run the sketch's loop() for a while.
+     *
+     * @param time How long to run it for, in milliseconds.
+     * @param step How long each loop() is taken to run for, in microseconds.
+     */
+    void run(millis_t time, uint32_t step = loop_time);
+
+
+    /** Press or release the control switch.
+     *
+     * @param pressed `true` to press the switch, `false` to release it.
+     */
+    void set_switch(bool pressed);
+
+
+    /** Obtain how much time each bar of a program adds.
+     *
+     * @return The time per bar, in milliseconds.
+     */
+    millis_t bar_length();
+
+
+    /** Obtain the name of a state, for reports.
+     *
+     * @param state The ID of the state.
+     * @return The name of the state, or "unknown".
+     */
+    const char *state_name(unsigned long state);
+
+
+    /** Obtain the name of a switch event, for reports.
+     *
+     * @param event The event.
+     * @return The name of the event, or "unknown".
+     */
+    const char *event_name(unsigned long event);
+};
+
+// The sketch's objects that tools look at. The tiny profile has no trace,
+// scheduler or snapshots, so only tools that watch the pins can run it.
+extern SwitchControl control_switch;
+extern Machine       fsm;
+extern TimerState    state_timer;
+extern millis_t      total_time;
+extern millis_t      boot_time;
+
+#if !defined(USE_TINY_PROFILE)
+extern Trace         trace;
+extern Scheduler     scheduler;
+
+/** Save or restore the runtime context of the sketch.
+ *
+ * @param snapshot The snapshot to save the context to or restore it from.
+ */
+void snapshot(Snapshot &snapshot);
+#endif
+
+#endif
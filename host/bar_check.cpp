@@ -0,0 +1,215 @@
+/** @file
+ *  A host tool that checks the bar drivers against the MY9221 model. Every
+ *  frame a driver sends is decoded as the chip would decode it, and must
+ *  follow the protocol exactly and show what was drawn.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include <stdio.h>
+#include "GroveBarDisplay.h"
+#include "Host.h"
+#include "MY9221Model.h"
+#include "BarDisplay.h"
+#include "MY9221Display.h"
+
+static const uint8_t clock_pin = 7;
+static const uint8_t data_pin  = 8;
+
+// The reference bar draws on pins the model isn't watching
+static const uint8_t reference_clock_pin = 10;
+static const uint8_t reference_data_pin  = 11;
+
+static int failures = 0;
+
+/** The bus statistics for one bar driver.
+ */
+struct Stats {
+    const char *name;     //!< The name of the driver
+    uint32_t frames;      //!< How many frames have been checked
+    uint32_t edges;       //!< How many edges those frames took in total
+    uint32_t worst_edges; //!< The most edges any one frame took
+    uint64_t bus_time;    //!< How long those frames took in total, in microseconds
+};
+
+/** Check the frame the model has seen against what should have been drawn.
+ *
+ * @param model    The model watching the driver.
+ * @param leds     The brightness each segment should have.
+ * @param reversed Was the driver filling the bar from the other end?
+ * @param what     A description of what was drawn, for failure messages.
+ */
+static void check_frame(MY9221Model &model, const uint8_t *leds, bool reversed, const char *what)
+{
+    const std::vector<std::string> &violations = model.get_violations();
+    for (size_t index = 0; index < violations.size(); ++index) {
+        printf("%s: %s\n", what, violations[index].c_str());
+        ++failures;
+    }
+
+    if (model.get_frames().size() != 1) {
+        printf("%s: %u frames latched, expected 1\n", what, (unsigned)model.get_frames().size());
+        ++failures;
+        return;
+    }
+
+    const MY9221Model::Frame &frame = model.get_frames()[0];
+    if (frame.command != 0) {
+        printf("%s: command %04x, expected 0000\n", what, frame.command);
+        ++failures;
+    }
+
+    for (uint8_t channel = 0; channel < MY9221Model::channels; ++channel) {
+        uint16_t expected = 0;
+        if (channel < BarDisplay::segments) {
+            expected = leds[reversed ? BarDisplay::segments - 1 - channel : channel];
+        }
+
+        if (frame.channel[channel] != expected) {
+            printf("%s: channel %d is %04x, expected %04x\n", what, channel, frame.channel[channel], expected);
+            ++failures;
+        }
+    }
+}
+
+
+/** Add the frame the model has seen to a driver's bus statistics.
+ *
+ * @param model The model watching the driver.
+ * @param stats The statistics of the driver.
+ */
+static void count_frame(MY9221Model &model, Stats &stats)
+{
+    if (model.get_frames().size() != 1) {
+        return;
+    }
+
+    const MY9221Model::Frame &frame = model.get_frames()[0];
+    ++stats.frames;
+    stats.edges += frame.edges;
+    stats.bus_time += frame.end - frame.start;
+    if (frame.edges > stats.worst_edges) {
+        stats.worst_edges = frame.edges;
+    }
+}
+
+
+/** Draw a range of levels and LED patterns with a display, and check every
+ *  frame it sends.
+ *
+ * @param model     The model watching the driver.
+ * @param display   The display to draw with.
+ * @param reference A Grove bar, off the model's pins, to show what each
+ *                  level should look like.
+ * @param reversed  Does the display fill the bar from the other end?
+ * @param stats     The statistics of the driver.
+ */
+static void check_display(MY9221Model &model, BarDisplay &display, Grove_LED_Bar &reference, bool reversed, Stats &stats)
+{
+    static const float levels[] = { -1.0f, 0.0f, 0.1f, 0.5f, 1.0f, 2.99f, 5.125f, 7.5f, 9.9f, 10.0f, 12.0f };
+    static const uint8_t patterns = 32;
+
+    uint32_t seed = 1;
+    char what[64];
+
+    for (size_t level = 0; level < sizeof(levels) / sizeof(levels[0]); ++level) {
+        model.clear();
+        display.setLevel(levels[level]);
+        reference.setLevel(levels[level]);
+
+        snprintf(what, sizeof(what), "%s setLevel(%.3f)%s", stats.name, levels[level], reversed ? " reversed" : "");
+        check_frame(model, reference.leds, reversed, what);
+
+        count_frame(model, stats);
+    }
+
+    for (uint8_t pattern = 0; pattern < patterns; ++pattern) {
+        uint8_t leds[BarDisplay::segments];
+        for (uint8_t led = 0; led < BarDisplay::segments; ++led) {
+            seed = seed * 1103515245 + 12345;
+            leds[led] = seed >> 24;
+        }
+
+        model.clear();
+        display.setLeds(leds);
+
+        snprintf(what, sizeof(what), "%s setLeds(pattern %d)%s", stats.name, pattern, reversed ? " reversed" : "");
+        check_frame(model, leds, reversed, what);
+
+        count_frame(model, stats);
+    }
+}
+
+
+/** Print a driver's bus statistics.
+ *
+ * @param stats The statistics of the driver.
+ */
+static void report(const Stats &stats)
+{
+    if (stats.frames) {
+        printf("bar_check: %s, %u frames, %u edges per frame on average, %u at most, %u us of bus time per frame\n",
+               stats.name, stats.frames, stats.edges / stats.frames, stats.worst_edges,
+               (unsigned)(stats.bus_time / stats.frames));
+    }
+}
+
+
+int main()
+{
+    Host::reset();
+
+    MY9221Model model(clock_pin, data_pin);
+
+    // The Grove library is the reference for what a level looks like
+    Grove_LED_Bar reference(reference_clock_pin, reference_data_pin, false, LED_BAR_10);
+
+    Stats grove  = { "GroveBarDisplay", 0, 0, 0, 0 };
+    Stats my9221 = { "MY9221Display", 0, 0, 0, 0 };
+
+    for (uint8_t reversed = 0; reversed < 2; ++reversed) {
+        Grove_LED_Bar bar(clock_pin, data_pin, reversed, LED_BAR_10);
+        GroveBarDisplay display(bar);
+        check_display(model, display, reference, reversed, grove);
+    }
+
+    for (uint8_t reversed = 0; reversed < 2; ++reversed) {
+        MY9221Display display(clock_pin, data_pin, reversed);
+        check_display(model, display, reference, reversed, my9221);
+    }
+
+    report(grove);
+    report(my9221);
+
+    if (failures) {
+        printf("bar_check: %d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/** @file
+ *  A host tool that checks the console's replies. The whole sketch is run
+ *  with tracing on, the long replies are asked for while the switch is being
+ *  used, and every line sent must be complete and in order, with nothing
+ *  mixed into it, without the console ever waiting for the serial port.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Host.h"
+#include "Sketch.h"
+
+static int failures = 0;
+
+/** Check whether a string is a number.
+ */
+static bool is_number(const std::string &text)
+{
+    if (text.empty()) {
+        return false;
+    }
+
+    for (size_t index = 0; index < text.size(); ++index) {
+        if ((text[index] < '0' || text[index] > '9') && !(index == 0 && text[index] == '-')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/** Split a line into the words separated by spaces.
+ */
+static std::vector<std::string> split(const std::string &line)
+{
+    std::vector<std::string> words;
+    size_t start = 0;
+
+    for (;;) {
+        size_t end = line.find(' ', start);
+        words.push_back(line.substr(start, end - start));
+        if (end == std::string::npos) {
+            return words;
+        }
+        start = end + 1;
+    }
+}
+
+
+/** Check a reply line has the right name and number of counters.
+ *
+ * @param line   The line sent.
+ * @param name   The name it should start with. A number may follow the
+ *               name directly, which counts as one of the counters.
+ * @param count  How many counters should follow the name.
+ */
+static void check_line(const std::string &line, const std::string &name, size_t count)
+{
+    std::vector<std::string> words = split(line);
+    size_t counters = words.size() - 1;
+
+    bool good = words[0].compare(0, name.size(), name) == 0;
+    if (good && words[0].size() > name.size()) {
+        good = is_number(words[0].substr(name.size()));
+        ++counters;
+    }
+    for (size_t word = 1; word < words.size(); ++word) {
+        good = good && is_number(words[word]);
+    }
+
+    if (!good || counters != count) {
+        printf("console_check: got \"%s\", expected %s with %u counters\n", line.c_str(), name.c_str(), (unsigned)count);
+        ++failures;
+    }
+}
+
+
+/** Check whether a line is a trace record, "X<time> <kind> <value>" or
+ *  "XD<count>".
+ */
+static bool is_trace(const std::string &line)
+{
+    if (line.size() < 2 || line[0] != 'X') {
+        return false;
+    }
+
+    if (line[1] == 'D') {
+        return is_number(line.substr(2));
+    }
+
+    std::vector<std::string> words = split(line.substr(1));
+    return words.size() == 3 && is_number(words[0]) && is_number(words[1]) && is_number(words[2]);
+}
+
+
+int main()
+{
+    Sketch::start();
+    Sketch::run(1000);
+
+    Host::serial_input("X1\n");
+    Sketch::run(100);
+
+    // Ask for every long reply at once, and keep the switch busy so there
+    // are trace records waiting to go out at the same time
+    Host::serial_input("H\nM\nT\n");
+    for (uint8_t press = 0; press < 8; ++press) {
+        Sketch::set_switch(true);
+        Sketch::run(150);
+        Sketch::set_switch(false);
+        Sketch::run(250);
+    }
+    Sketch::run(3000);
+
+    // Each reply, in the order asked for
+    std::vector<std::pair<std::string, size_t> > expected;
+    expected.push_back(std::make_pair("H", 5 + 2 * SwitchControl::health_buckets));
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        expected.push_back(std::make_pair("MT" + std::to_string(state), (size_t)State::STATE_MAX));
+    }
+    for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+        expected.push_back(std::make_pair("MD" + std::to_string(state), (size_t)Machine::dwell_buckets));
+    }
+    expected.push_back(std::make_pair("MR", (size_t)State::STATE_MAX));
+    expected.push_back(std::make_pair("ML", (size_t)1));
+    expected.push_back(std::make_pair("MW", (size_t)State::STATE_MAX));
+    for (uint8_t task = 0; task < scheduler.get_task_count(); ++task) {
+        expected.push_back(std::make_pair("T" + std::to_string(task), (size_t)3));
+    }
+    expected.push_back(std::make_pair("TT", (size_t)2));
+    expected.push_back(std::make_pair("TB", (size_t)1));
+
+    size_t reply  = 0;
+    uint32_t records = 0;
+    std::string line;
+    while (Host::serial_line(line)) {
+        if (is_trace(line)) {
+            ++records;
+        } else if (reply < expected.size()) {
+            check_line(line, expected[reply].first, expected[reply].second);
+            ++reply;
+        } else {
+            printf("console_check: unexpected line \"%s\"\n", line.c_str());
+            ++failures;
+        }
+    }
+
+    if (reply != expected.size()) {
+        printf("console_check: got %u reply lines, expected %u\n", (unsigned)reply, (unsigned)expected.size());
+        ++failures;
+    }
+    if (!records) {
+        printf("console_check: no trace records were sent\n");
+        ++failures;
+    }
+
+    // Fill the serial buffer, as a long reply would, and overflow the
+    // trace. The dropped count is then waiting to go out with no room for
+    // it, and must wait for room rather than holding the sketch up
+    while (Serial.availableForWrite() > 3) {
+        Serial.print('Z');
+    }
+    Serial.println();
+    for (uint8_t record = 0; record < 2 * Trace::max_records; ++record) {
+        trace.record(Trace::TRACE_EVENT, SwitchControl::EVENT_NONE);
+    }
+    Sketch::run(3000);
+
+    unsigned long dropped = 0;
+    while (Host::serial_line(line)) {
+        unsigned long value;
+        if (sscanf(line.c_str(), "XD%lu", &value) == 1) {
+            dropped += value;
+        } else if (is_trace(line)) {
+            ++records;
+        } else if (line.empty() || line[0] != 'Z') {
+            printf("console_check: unexpected line \"%s\" while the trace was overflowing\n", line.c_str());
+            ++failures;
+        }
+    }
+    if (!dropped) {
+        printf("console_check: no dropped count was sent after the trace overflowed\n");
+        ++failures;
+    }
+
+    // The serial port must never have held the sketch up
+    printf("console_check: %u reply lines, %u trace records, %lu dropped, %u bytes, %u us waiting for the serial port\n",
+           (unsigned)reply, records, dropped, Host::serial_written(), (unsigned)Host::serial_waited());
+    if (Host::serial_waited()) {
+        ++failures;
+    }
+
+    if (failures) {
+        printf("console_check: %d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Report how much flash and RAM the sketch needs on the device, in the full
+# and tiny profiles. The sketch is built once for each with arduino-cli, for
+# the board in FQBN (an Uno unless set), and each build is measured with
+# avr-size. Without the toolchain there is nothing to measure, so this says
+# so and stops without failing, as the host checks don't need it.
+
+FQBN=${FQBN:-arduino:avr:uno}
+SKETCH=$(cd "$(dirname "$0")/.." && pwd)
+
+if ! command -v arduino-cli > /dev/null 2>&1; then
+    echo "footprint: arduino-cli not found, so the sketch can't be built for $FQBN"
+    exit 0
+fi
+
+# arduino-cli installs the toolchain out of the way, so look there as well
+SIZE=$(command -v avr-size)
+if [ -z "$SIZE" ]; then
+    SIZE=$(ls -d "$HOME"/.arduino15/packages/arduino/tools/avr-gcc/*/bin/avr-size 2> /dev/null | tail -n 1)
+fi
+if [ -z "$SIZE" ]; then
+    echo "footprint: avr-size not found; install the AVR core with arduino-cli core install arduino:avr"
+    exit 0
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# The sketch folder has to be named after the sketch, and only the sketch's
+# own files are wanted, not the host build
+mkdir "$WORK/laundry"
+cp "$SKETCH"/*.ino "$SKETCH"/*.cpp "$SKETCH"/*.h "$WORK/laundry/"
+
+status=0
+printf "footprint: %s\n%-8s %8s %8s\n" "$FQBN" "profile" "flash" "RAM"
+for profile in full tiny; do
+    flags=
+    if [ "$profile" = tiny ]; then
+        flags=-DUSE_TINY_PROFILE
+    fi
+
+    if ! arduino-cli compile --fqbn "$FQBN" --build-path "$WORK/$profile" \
+            --build-property "compiler.cpp.extra_flags=$flags" "$WORK/laundry" > "$WORK/$profile.log" 2>&1; then
+        printf "%-8s failed to build:\n" "$profile"
+        sed 's/^/    /' "$WORK/$profile.log" | tail -n 20
+        status=1
+        continue
+    fi
+
+    # Flash holds the code and the initial data; RAM holds the data and bss
+    "$SIZE" "$WORK/$profile/laundry.ino.elf" | awk -v profile="$profile" \
+        'NR == 2 { printf "%-8s %8d %8d\n", profile, $1 + $2, $2 + $3 }'
+done
+
+exit $status
@@ -0,0 +1,264 @@
+/** @file
+ *  A host tool that measures how long each loop() of the whole sketch takes,
+ *  with every Arduino core call charged the time it takes on the device. It
+ *  fails if the longest goes over the latency budget, or if a task goes
+ *  over the budget it was added to the scheduler with. Runs start from a
+ *  snapshot with a program being set, and press the switch at a sweep of
+ *  times, so that presses land on the flash redraws and the start of the
+ *  timer as well as between them.
+ *
+ *  This is a measurement in simulation, not a static worst case analysis:
+ *  the time the sketch's own code takes between core calls isn't counted,
+ *  and only the paths the runs take are measured.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Host.h"
+#include "Sketch.h"
+#include "Snapshot.h"
+
+//! Names for the scheduler's tasks, in the order setup() adds them
+static const char *const task_names[] = { "input", "fsm", "console", "health" };
+
+/** The longest time seen for something, and the run it was seen in.
+ */
+struct Worst {
+    uint16_t time;    //!< The longest time, in microseconds
+    std::string run;  //!< A description of the run it was seen in
+
+    Worst() : time(0) { /* fnord */ }
+
+    /** Keep a time, if it's the longest yet.
+     *
+     * @param seen The time seen, in microseconds.
+     * @param in   The run it was seen in.
+     */
+    void keep(uint16_t seen, const std::string &in) {
+        if (seen > time) {
+            time = seen;
+            run  = in;
+        }
+    }
+};
+
+
+/** A point the runs start from: the sketch's snapshot and the board.
+ */
+struct Start {
+    std::vector<uint8_t> sketch; //!< The sketch's snapshot
+    std::string board;           //!< The state of the simulated board
+};
+
+
+/** Run the sketch for a while.
+ *
+ * @param time How long to run it for, in microseconds.
+ */
+static void run(uint64_t time)
+{
+    uint64_t end = Host::now() + time;
+    while (Host::now() < end) {
+        Sketch::step();
+    }
+
+    // Replies aren't looked at, but mustn't pile up
+    std::string line;
+    while (Host::serial_line(line)) { /* fnord */ }
+}
+
+
+/** Press the switch, hold it, and let it go.
+ *
+ * @param time How long to hold it for, in milliseconds.
+ */
+static void press(millis_t time)
+{
+    Sketch::set_switch(true);
+    run((uint64_t)time * 1000);
+    Sketch::set_switch(false);
+}
+
+
+/** Use the unit from a start point: press the switch after a delay, let the
+ *  program start, ask for every console report while the timer runs,
+ *  double press, and turn the unit off with a long press.
+ *
+ * @param delay How long after the start point to press the switch, in
+ *              microseconds.
+ */
+static void use(uint64_t delay)
+{
+    run(delay);
+    press(120);
+    run(8000000);
+
+    Host::serial_input("H\nM\nT\n");
+    run(2000000);
+
+    press(100);
+    run(100000);
+    press(100);
+    run(2000000);
+
+    press(4000);
+    run(3000000);
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-b budget]\n"
+                    "  -b budget  The longest a loop() may take, in microseconds; defaults\n"
+                    "             to the scheduler's tick budget\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned long budget = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "b:")) != -1) {
+        switch (option) {
+            case 'b': budget = strtoul(optarg, NULL, 10); break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+    }
+
+    // Start tracing, so its records go out with everything else, then wake
+    // the unit and add a bar
+    Sketch::start();
+    Host::set_costs(true);
+    Host::serial_input("X1\n");
+    run(100000);
+    press(120);
+    run(2000000);
+    press(120);
+
+    if (!budget) {
+        budget = scheduler.get_tick_budget();
+    }
+
+    Start start;
+    start.sketch.resize(Snapshot::measure(snapshot));
+    Snapshot::save(snapshot, start.sketch.data(), start.sketch.size());
+    Host::save(start.board);
+
+    // Find when the timer starts if the switch is left alone
+    uint64_t timer_start = 0;
+    while (fsm.get_state() != State::STATE_TIMER && timer_start < 10000000) {
+        Sketch::step();
+        timer_start += Sketch::loop_time;
+    }
+
+    // Press every 50ms until a second after the timer starts, which puts
+    // presses on the flash redraws, and on every loop() for a few
+    // milliseconds either side of the timer starting
+    std::vector<uint64_t> delays;
+    for (uint64_t delay = 0; delay < timer_start + 1000000; delay += 50000) {
+        delays.push_back(delay);
+    }
+    for (uint64_t delay = timer_start - 5000; delay < timer_start + 5000; delay += Sketch::loop_time) {
+        delays.push_back(delay);
+    }
+
+    uint8_t tasks = scheduler.get_task_count();
+    Worst tick;
+    std::vector<Worst> task_worst(tasks);
+    std::vector<Worst> state_worst(State::STATE_MAX);
+    unsigned late = 0;
+    bool over = false;
+
+    // The last run leaves the timer to run out, and the unit to sweep the
+    // bar and play the tune, before turning it off
+    for (size_t index = 0; index <= delays.size(); ++index) {
+        Snapshot::restore(snapshot, start.sketch.data(), start.sketch.size());
+        Host::restore(start.board);
+
+        char run_name[48];
+        if (index < delays.size()) {
+            use(delays[index]);
+            snprintf(run_name, sizeof(run_name), "press at +%.1f ms", delays[index] / 1000.0);
+        } else {
+            while (fsm.get_state() != State::STATE_WAIT && Host::now() < (uint64_t)3 * 3600 * 1000000) {
+                run(1000000);
+            }
+            run(20000000);
+            press(120);
+            run(3000000);
+            snprintf(run_name, sizeof(run_name), "timer running out");
+        }
+
+        tick.keep(scheduler.get_worst_tick(), run_name);
+        for (uint8_t task = 0; task < tasks; ++task) {
+            task_worst[task].keep(scheduler.get_stats(task).worst, run_name);
+        }
+        for (uint8_t state = 0; state < State::STATE_MAX; ++state) {
+            state_worst[state].keep(fsm.get_worst_update()[state], run_name);
+        }
+        late += scheduler.get_late_ticks();
+    }
+
+    printf("latency_check: %zu runs, longest loop() %u us, budget %lu us, in the run with the %s\n",
+           delays.size() + 1, tick.time, budget, tick.run.c_str());
+
+    printf("  task        worst  budget\n");
+    for (uint8_t task = 0; task < tasks; ++task) {
+        uint16_t task_budget = scheduler.get_budget(task);
+        if (task_budget && task_worst[task].time > task_budget) {
+            over = true;
+        }
+        printf("  %-10s %6u  %6u%s\n", task < sizeof(task_names) / sizeof(task_names[0]) ? task_names[task] : "?",
+               task_worst[task].time, task_budget,
+               (task_budget && task_worst[task].time > task_budget) ? "  over" : "");
+    }
+
+    printf("  state      update\n");
+    for (uint8_t state = State::STATE_OFF; state < State::STATE_MAX; ++state) {
+        printf("  %-10s %6u\n", Sketch::state_name(state), state_worst[state].time);
+    }
+
+    if (tick.time > budget || late || over) {
+        printf("latency_check: over budget: the longest loop() took %u us, %u ticks went over the scheduler's tick budget\n",
+               tick.time, late);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/** @file
+ *  A host tool that records what the sketch does to its outputs: every frame
+ *  sent to the LED bar, every change of the switch LED, and every change of
+ *  state. Unlike the trace, this needs nothing from the sketch but its pins
+ *  and the state machine, so it works for every build, including the tiny
+ *  profile, and two builds can be checked against each other by comparing
+ *  what they record.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "Host.h"
+#include "Sketch.h"
+#include "Script.h"
+#include "MY9221Model.h"
+
+// The pins laundry.ino drives the bar and the switch LED on
+static const uint8_t clock_pin = 7;
+static const uint8_t data_pin  = 8;
+static const uint8_t led_pin   = 3;
+
+/** A recorder for the sketch's outputs, written as one line per change:
+ *  the time in microseconds, what changed, and what it changed to.
+ */
+class PinTrace
+{
+public:
+    /** Create a new PinTrace object. The sketch must have been started,
+     *  so that the pins have their power on levels.
+     *
+     * @param out The file to write the lines to.
+     * @return A new PinTrace object.
+     */
+    PinTrace(FILE *out) : out(out), model(clock_pin, data_pin), state(-1), led(-1), frames(0), states(0), leds(0), violations(0)
+        { setvbuf(out, NULL, _IOFBF, 1 << 20); }
+
+
+    /** Record anything that has changed since the last check.
+     *
+     * @param time The time to record the changes at, in microseconds.
+     */
+    void check(uint64_t time)
+    {
+        // The drivers may take different times to send a frame, so frames
+        // are put down to the loop() they were sent in
+        for (const MY9221Model::Frame &frame : model.get_frames()) {
+            fprintf(out, "%llu bar", (unsigned long long)time);
+            for (uint8_t channel = 0; channel < MY9221Model::channels; ++channel) {
+                fprintf(out, " %02x", frame.channel[channel]);
+            }
+            fputc('\n', out);
+            ++frames;
+        }
+        for (const std::string &violation : model.get_violations()) {
+            fprintf(stderr, "pin_trace: %llu: %s\n", (unsigned long long)time, violation.c_str());
+            ++violations;
+        }
+        model.clear();
+
+        int now = Host::get_output(led_pin);
+        if (now != led) {
+            led = now;
+            fprintf(out, "%llu led %d\n", (unsigned long long)time, led);
+            ++leds;
+        }
+
+        now = fsm.get_state();
+        if (now != state) {
+            state = now;
+            fprintf(out, "%llu state %s\n", (unsigned long long)time, Sketch::state_name(state));
+            ++states;
+        }
+    }
+
+    uint32_t get_frames()     { return frames; }     //!< How many bar frames have been recorded
+    uint32_t get_states()     { return states; }     //!< How many state changes have been recorded
+    uint32_t get_leds()       { return leds; }       //!< How many switch LED changes have been recorded
+    uint32_t get_violations() { return violations; } //!< How many protocol violations the bar has seen
+
+private:
+    FILE *out;           //!< Where the lines are written
+    MY9221Model model;   //!< The model of the bar, which turns the pin writes back into frames
+    int state;           //!< The state last recorded, or -1 before the first
+    int led;             //!< The switch LED level last recorded, or -1 before the first
+    uint32_t frames;     //!< How many bar frames have been recorded
+    uint32_t states;     //!< How many state changes have been recorded
+    uint32_t leds;       //!< How many switch LED changes have been recorded
+    uint32_t violations; //!< How many protocol violations the bar has seen
+};
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s script] [-o output]\n"
+                    "  -s script  Run the sketch with the inputs in the script; the default\n"
+                    "             sets a three bar program and lets it run out\n"
+                    "  -o output  Where to write the record; defaults to stdout\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *script_name = NULL;
+    const char *output_name = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:o:")) != -1) {
+        switch (option) {
+            case 's': script_name = optarg; break;
+            case 'o': output_name = optarg; break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+    }
+
+    Script script;
+    if (script_name) {
+        FILE *in = fopen(script_name, "r");
+        std::string error;
+
+        if (!in) {
+            perror(script_name);
+            return 1;
+        }
+        if (!script.load(in, error)) {
+            fprintf(stderr, "%s: %s\n", script_name, error.c_str());
+            return 1;
+        }
+        fclose(in);
+    } else {
+        script.add_standard_run();
+    }
+
+    FILE *out = output_name ? fopen(output_name, "w") : stdout;
+    if (!out) {
+        perror(output_name);
+        return 1;
+    }
+
+    // The script starts where trace_export's does, so the two line up
+    Sketch::start();
+    PinTrace pins(out);
+    pins.check(Host::now());
+    Sketch::run(100);
+
+    uint64_t start = Host::now();
+    size_t next = 0;
+    std::string line;
+    for (uint32_t loops = 0; script.play(next, (Host::now() - start) / 1000); ++loops) {
+        uint64_t time = Host::now();
+        Sketch::step();
+        pins.check(time);
+
+        // Nothing reads the serial port here, but it mustn't pile up
+        if (loops % 1024 == 0) {
+            while (Host::serial_line(line)) { /* fnord */ }
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "pin_trace: %u frames, %u state changes, %u switch LED changes, %u violations\n",
+            pins.get_frames(), pins.get_states(), pins.get_leds(), pins.get_violations());
+
+    return (pins.get_frames() && !pins.get_violations()) ? 0 : 1;
+}
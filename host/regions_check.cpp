@@ -0,0 +1,363 @@
+/** @file
+ *  A host tool that runs two state machines side by side through Regions,
+ *  as a washer and a dryer sharing one switch and one LED bar, and checks
+ *  which region each switch event is routed to, what the shared bar shows,
+ *  and which region's status the switch's LED shows. The machines are
+ *  driven by a real SwitchControl on the simulated clock, so the states see
+ *  the switch exactly as they do in the sketch.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Host.h"
+#include "BarDisplay.h"
+#include "FSM.h"
+#include "Regions.h"
+
+static const uint8_t switch_pin = 2;
+static const uint8_t led_pin    = 3;
+static const uint8_t half       = BarDisplay::segments / 2;
+
+static int failures = 0;
+
+/** The shared bar, which keeps the last frame sent to it.
+ */
+class FrameBar : public BarDisplay
+{
+public:
+    FrameBar() : frames(0)
+        { memset(frame, 0, sizeof(frame)); }
+
+    void setLevel(float level) {
+        (void)level;
+        printf("regions_check: the composite display set a level rather than a frame\n");
+        ++failures;
+    }
+
+    void setLeds(uint8_t *leds) {
+        memcpy(frame, leds, sizeof(frame));
+        ++frames;
+    }
+
+    uint8_t frame[BarDisplay::segments]; //!< The last frame sent
+    uint32_t frames;                     //!< How many frames have been sent
+};
+
+
+/** The switch's LED, which keeps what it was last asked to show.
+ */
+class LedLog : public SwitchLed
+{
+public:
+    LedLog() : effect(false), value(0)
+        { /* fnord */ }
+
+    void set_led_state(bool state) {
+        effect = false;
+        value  = state;
+    }
+
+    void set_led_effect(LedEffects::Effect effect) {
+        this -> effect = true;
+        value          = effect;
+    }
+
+    bool effect; //!< Was an effect asked for, rather than on or off?
+    int value;   //!< The effect asked for, or whether the LED is on
+};
+
+
+/** One region: a full set of states drawing on half of the shared bar.
+ */
+struct Region {
+    SegmentDisplay segment;
+    millis_t total_time;
+    OffState off;
+    StartupState startup;
+    ProgramState program;
+    TimerState timer;
+    WaitState wait;
+    Machine machine;
+
+    /** Create a region, and put it in the off state.
+     *
+     * @param button    The shared switch.
+     * @param composite The shared bar's frame.
+     * @param first     The first segment of the bar the region draws on.
+     */
+    Region(SwitchControl &button, CompositeDisplay &composite, uint8_t first) :
+        segment(composite, first, half), total_time(0),
+        off(button, segment), startup(button, segment),
+        program(button, segment, &total_time, NULL, NULL, NULL, 60),
+        timer(button, segment, &total_time), wait(button, segment)
+    {
+        machine.add_state(&off);
+        machine.add_state(&startup);
+        machine.add_state(&program);
+        machine.add_state(&timer);
+        machine.add_state(&wait);
+        machine.set_state(State::STATE_OFF);
+    }
+};
+
+
+SwitchControl button(switch_pin, led_pin);
+FrameBar bar;
+CompositeDisplay composite(bar);
+LedLog led;
+Region washer(button, composite, 0);
+Region dryer(button, composite, half);
+
+
+/** Run the regions for a while, a millisecond per update, as the sketch
+ *  does, keeping which regions the last press was routed to.
+ *
+ * @param regions The regions to run.
+ * @param time    How long to run them for, in milliseconds.
+ * @param pressed Set to the routing of the last press seen, if any.
+ */
+static void run(Regions &regions, millis_t time, uint8_t *pressed = NULL)
+{
+    for (millis_t elapsed = 0; elapsed < time; ++elapsed) {
+        Host::advance(1000);
+
+        SwitchControl::Event event = button.update();
+        regions.update(event);
+
+        if (pressed && event == SwitchControl::EVENT_PRESSED) {
+            *pressed = regions.get_routed();
+        }
+    }
+}
+
+
+/** Press the switch, hold it, and let it go.
+ *
+ * @param regions The regions to run.
+ * @param hold    How long to hold it for, in milliseconds.
+ * @return Which regions the press was routed to.
+ */
+static uint8_t press(Regions &regions, millis_t hold)
+{
+    uint8_t pressed = 0;
+
+    Host::set_input(switch_pin, HIGH);
+    run(regions, hold, &pressed);
+    Host::set_input(switch_pin, LOW);
+    run(regions, 500, &pressed);
+
+    return pressed;
+}
+
+
+/** Count up how many segments of a part of the bar are fully lit. A level
+ *  part of the way into a segment lights it dimly, which isn't counted.
+ *
+ * @param first The first segment to look at.
+ * @return How many of the `half` segments from it are fully lit.
+ */
+static uint8_t lit(uint8_t first)
+{
+    uint8_t count = 0;
+
+    for (uint8_t segment = first; segment < first + half; ++segment) {
+        if (bar.frame[segment] == 0xff) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+
+/** Check that the regions are as they should be.
+ *
+ * @param step      What has just been done, for the report.
+ * @param regions   The regions.
+ * @param washer_is The state the washer should be in.
+ * @param dryer_is  The state the dryer should be in.
+ * @param owner     The region whose status the LED should show.
+ */
+static void check(const char *step, Regions &regions, State::StateID washer_is, State::StateID dryer_is, uint8_t owner)
+{
+    if (washer.machine.get_state() != washer_is || dryer.machine.get_state() != dryer_is) {
+        printf("regions_check: %s: the washer is in state %d and the dryer %d, expected %d and %d\n",
+               step, washer.machine.get_state(), dryer.machine.get_state(), washer_is, dryer_is);
+        ++failures;
+    }
+    if (regions.get_led_owner() != owner) {
+        printf("regions_check: %s: the LED shows region %u, expected %u\n", step, regions.get_led_owner(), owner);
+        ++failures;
+    }
+}
+
+
+/** Check which regions a press went to.
+ *
+ * @param step    What the press was for, for the report.
+ * @param pressed Which regions it went to.
+ * @param mask    Which regions it should have gone to.
+ */
+static void check_routed(const char *step, uint8_t pressed, uint8_t mask)
+{
+    if (pressed != mask) {
+        printf("regions_check: %s: the press went to regions 0x%x, expected 0x%x\n", step, pressed, mask);
+        ++failures;
+    }
+}
+
+
+/** Check what the shared bar shows.
+ *
+ * @param step         What has just been done, for the report.
+ * @param washer_lit   How many of the washer's segments should be fully lit.
+ * @param dryer_lit    How many of the dryer's segments should be fully lit.
+ */
+static void check_bar(const char *step, uint8_t washer_lit, uint8_t dryer_lit)
+{
+    if (lit(0) != washer_lit || lit(half) != dryer_lit) {
+        printf("regions_check: %s: the bar shows %u and %u segments fully lit, expected %u and %u\n",
+               step, lit(0), lit(half), washer_lit, dryer_lit);
+        ++failures;
+    }
+}
+
+
+/** Check what the switch's LED shows.
+ *
+ * @param step   What has just been done, for the report.
+ * @param effect Whether an effect should be showing.
+ * @param value  The effect that should be showing, or whether the LED should be on.
+ */
+static void check_led(const char *step, bool effect, int value)
+{
+    if (led.effect != effect || led.value != value) {
+        printf("regions_check: %s: the LED shows %s %d, expected %s %d\n", step,
+               led.effect ? "effect" : "state", led.value, effect ? "effect" : "state", value);
+        ++failures;
+    }
+}
+
+
+/** Set a program in whichever region the switch is acting on: press to wake
+ *  it, let the self-test run, add bars to the one it starts with, and wait
+ *  for the timer to start.
+ *
+ * @param regions The regions.
+ * @param bars    How many bars to set, two or more.
+ * @param step    What is being set, for the report.
+ * @param mask    Which regions the presses should go to.
+ * @param washer_lit How many of the washer's segments should be fully lit once the bars are set.
+ * @param dryer_lit  How many of the dryer's segments should be fully lit.
+ */
+static void set_program(Regions &regions, uint8_t bars, const char *step, uint8_t mask, uint8_t washer_lit, uint8_t dryer_lit)
+{
+    check_routed(step, press(regions, 120), mask);
+    run(regions, 1500);
+
+    for (uint8_t bar = 1; bar < bars; ++bar) {
+        check_routed(step, press(regions, 120), mask);
+    }
+    check_bar(step, washer_lit, dryer_lit);
+
+    run(regions, 7000);
+}
+
+
+int main()
+{
+    button.setup();
+
+    // The router gives each press to one region, and the LED to the one
+    // the switch acts on next
+    FocusRouter focus;
+    Regions regions(focus, &composite, &led);
+    regions.add_region(&washer.machine);
+    regions.add_region(&dryer.machine);
+
+    run(regions, 100);
+    check("idle", regions, State::STATE_OFF, State::STATE_OFF, 0);
+    check_led("idle", false, 0);
+
+    // The first press wakes the first region that is off, which keeps the
+    // presses and the LED until its timer starts
+    set_program(regions, 4, "setting the washer", 1, 2, 0);
+    check("setting the washer", regions, State::STATE_TIMER, State::STATE_OFF, 0);
+    check_led("setting the washer", false, 1);
+
+    // A press now starts the next load, in the dryer
+    set_program(regions, 6, "setting the dryer", 2, 0, 3);
+    check("setting the dryer", regions, State::STATE_TIMER, State::STATE_TIMER, 1);
+    check_led("setting the dryer", false, 1);
+
+    // A long press goes to the region that last had the focus, and the LED
+    // goes back to the washer, which is still running
+    check_routed("turning the dryer off", press(regions, 4000), 2);
+    check("turning the dryer off", regions, State::STATE_TIMER, State::STATE_OFF, 0);
+    check_bar("turning the dryer off", 0, 0);
+    check_led("turning the dryer off", false, 1);
+
+    // The washer runs out, and its alert takes the LED; the next press
+    // goes to it, to acknowledge it, rather than waking the dryer
+    run(regions, 240000);
+    check("the washer finishing", regions, State::STATE_WAIT, State::STATE_OFF, 0);
+    check_led("the washer finishing", true, LedEffects::EFFECT_BREATHE);
+
+    check_routed("emptying the washer", press(regions, 120), 1);
+    check("emptying the washer", regions, State::STATE_PROGRAM, State::STATE_OFF, 0);
+    check_led("emptying the washer", false, 1);
+
+    check_routed("turning the washer off", press(regions, 4000), 1);
+    check("turning the washer off", regions, State::STATE_OFF, State::STATE_OFF, 0);
+    check_led("turning the washer off", false, 0);
+
+    // Broadcasting gives every event to every region, and the LED to the
+    // first that is running. The self-tests have been shown, so a press
+    // goes straight to programming.
+    BroadcastRouter broadcast;
+    Regions both(broadcast, &composite, &led);
+    both.add_region(&washer.machine);
+    both.add_region(&dryer.machine);
+
+    check_routed("waking both", press(both, 120), 3);
+    check("waking both", both, State::STATE_PROGRAM, State::STATE_PROGRAM, 0);
+    check_routed("adding a bar to both", press(both, 120), 3);
+    check_bar("adding a bar to both", 1, 1);
+    check_routed("turning both off", press(both, 4000), 3);
+    check("turning both off", both, State::STATE_OFF, State::STATE_OFF, 0);
+    check_bar("turning both off", 0, 0);
+
+    printf("regions_check: %u frames sent to the shared bar, %d failures\n", bar.frames, failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,387 @@
+/** @file
+ *  A host tool that replays a script of inputs through the whole sketch and
+ *  finds the first loop() at which an invariant breaks. The run is
+ *  checkpointed every so often, with the sketch's snapshot and the state of
+ *  the simulated board, and the invariants are checked at each checkpoint.
+ *  When one is found broken, the run is restarted from the checkpoint
+ *  before and bisected down to the loop() that broke it, so even a very
+ *  long run only has to be replayed once.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Host.h"
+#include "Sketch.h"
+#include "Script.h"
+#include "Snapshot.h"
+
+/** A point in the run that the replay can be restarted from.
+ */
+struct Checkpoint {
+    uint64_t loops;                //!< How many loop()s had run
+    size_t next;                   //!< The next script action to do
+    std::vector<uint8_t> sketch;   //!< The sketch's snapshot
+    std::string board;             //!< The state of the simulated board
+};
+
+
+/** The sketch running through a script, one loop() at a time, which can be
+ *  checkpointed and restarted from a checkpoint.
+ */
+class Replay
+{
+public:
+    /** Create a new Replay object, and start the sketch.
+     *
+     * @param script The inputs to give the sketch.
+     * @param fault  The loop() before which to inject a fault, or 0 for
+     *               none. The fault adds a millisecond to the set time, as
+     *               a stray write might, to check that it is found.
+     */
+    Replay(const Script &script, uint64_t fault) :
+        script(script), fault(fault), loops(0), next(0)
+    {
+        Sketch::start();
+        start = Host::now();
+    }
+
+
+    /** Run the next loop(), doing any script actions that are due first.
+     *
+     * @return `true` if the loop() was run, `false` if the run has ended.
+     */
+    bool step()
+    {
+        if (!script.play(next, (Host::now() - start) / 1000)) {
+            return false;
+        }
+
+        if (fault && loops == fault) {
+            ++total_time;
+        }
+
+        Sketch::step();
+        ++loops;
+
+        // Replies aren't looked at, but mustn't pile up in the checkpoints
+        std::string line;
+        while (Host::serial_line(line)) { /* fnord */ }
+
+        return true;
+    }
+
+
+    /** Run loop()s until a given number have run in total.
+     *
+     * @param target How many loop()s should have run.
+     * @return `true` if they have, `false` if the run ended first.
+     */
+    bool run_to(uint64_t target)
+    {
+        while (loops < target) {
+            if (!step()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    /** Save a checkpoint of the run so far.
+     *
+     * @param checkpoint The checkpoint to save into.
+     */
+    void save(Checkpoint &checkpoint)
+    {
+        checkpoint.loops = loops;
+        checkpoint.next  = next;
+        checkpoint.sketch.resize(Snapshot::measure(snapshot));
+        Snapshot::save(snapshot, checkpoint.sketch.data(), checkpoint.sketch.size());
+        Host::save(checkpoint.board);
+    }
+
+
+    /** Restart the run from a checkpoint.
+     *
+     * @param checkpoint The checkpoint to restart from.
+     * @return `true` if the run was restored, `false` if the checkpoint
+     *         doesn't hold a snapshot this build can restore.
+     */
+    bool restore(Checkpoint &checkpoint)
+    {
+        if (!Snapshot::restore(snapshot, checkpoint.sketch.data(), checkpoint.sketch.size())) {
+            return false;
+        }
+
+        Host::restore(checkpoint.board);
+        loops = checkpoint.loops;
+        next  = checkpoint.next;
+
+        return true;
+    }
+
+
+    /** Obtain how many loop()s have run.
+     *
+     * @return The number of loop()s run since the start.
+     */
+    uint64_t get_loops() {
+        return loops;
+    }
+
+private:
+    const Script &script; //!< The inputs to give the sketch
+    uint64_t fault;       //!< The loop() before which the fault is injected, or 0
+    uint64_t start;       //!< The simulated time the script started at, in microseconds
+    uint64_t loops;       //!< How many loop()s have run
+    size_t next;          //!< The next script action to do
+};
+
+
+/** Check the invariants of the sketch. These should hold after every loop().
+ *
+ * @return A description of the first invariant that doesn't hold, or NULL
+ *         if they all do.
+ */
+static const char *broken()
+{
+    State::StateID state = fsm.get_state();
+    if (state == State::STATE_NONE || state >= State::STATE_MAX) {
+        return "the machine is in one of its states";
+    }
+
+    // Programs are set in whole bars, so anything else is corruption
+    millis_t bar = Sketch::bar_length();
+    if (total_time % bar || total_time > BarDisplay::segments * bar) {
+        return "the set time is a whole number of bars, and no more than a full bar";
+    }
+
+    if (state == State::STATE_TIMER && !total_time) {
+        return "the timer has a time set";
+    }
+
+    return NULL;
+}
+
+
+/** Check that each checkpoint can be reached by restarting the run from the
+ *  one before it, so that nothing the run depends on is missing from the
+ *  snapshot or the board state, and that a snapshot that is cut short is
+ *  refused without changing anything.
+ *
+ * @param replay      The run to restart.
+ * @param checkpoints The checkpoints saved during the run.
+ * @return `true` if every checkpoint was reached exactly, `false` if not.
+ */
+static bool verify(Replay &replay, std::vector<Checkpoint> &checkpoints)
+{
+    Checkpoint reached;
+    Checkpoint before;
+
+    replay.save(before);
+    reached = checkpoints.front();
+    reached.sketch.pop_back();
+    if (replay.restore(reached)) {
+        fprintf(stderr, "replay: a snapshot a byte short was restored\n");
+        return false;
+    }
+    replay.save(reached);
+    if (reached.sketch != before.sketch) {
+        fprintf(stderr, "replay: a snapshot a byte short was partly restored\n");
+        return false;
+    }
+
+    for (size_t index = 1; index < checkpoints.size(); ++index) {
+        Checkpoint &expected = checkpoints[index];
+
+        if (!replay.restore(checkpoints[index - 1]) || !replay.run_to(expected.loops)) {
+            fprintf(stderr, "replay: couldn't restart from checkpoint %zu\n", index - 1);
+            return false;
+        }
+
+        replay.save(reached);
+        if (reached.next != expected.next || reached.sketch != expected.sketch) {
+            fprintf(stderr, "replay: the sketch differs at checkpoint %zu when restarted from the one before\n", index);
+            return false;
+        }
+        if (reached.board != expected.board) {
+            fprintf(stderr, "replay: the board differs at checkpoint %zu when restarted from the one before\n", index);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s script] [-i interval] [-f time] [-v]\n"
+                    "  -s script    The inputs to give the sketch; the default sets a three\n"
+                    "               bar program and lets it run out\n"
+                    "  -i interval  How often to checkpoint, in seconds; defaults to 60\n"
+                    "  -f time      Inject a fault this many ms into the run, and check that\n"
+                    "               it is found at the right loop()\n"
+                    "  -v           Check that every checkpoint can be reached from the one\n"
+                    "               before it\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *script_name = NULL;
+    unsigned long interval  = 60;
+    uint64_t fault          = 0;
+    bool check_restore      = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:i:f:v")) != -1) {
+        switch (option) {
+            case 's': script_name   = optarg; break;
+            case 'i': interval      = strtoul(optarg, NULL, 10); break;
+            case 'f': fault         = strtoull(optarg, NULL, 10) * 1000 / Sketch::loop_time; break;
+            case 'v': check_restore = true; break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (optind != argc || !interval) {
+        usage(argv[0]);
+    }
+
+    Script script;
+    if (script_name) {
+        FILE *in = fopen(script_name, "r");
+        std::string error;
+
+        if (!in) {
+            perror(script_name);
+            return 1;
+        }
+        if (!script.load(in, error)) {
+            fprintf(stderr, "%s: %s\n", script_name, error.c_str());
+            return 1;
+        }
+        fclose(in);
+    } else {
+        script.add_standard_run();
+    }
+
+    Replay replay(script, fault);
+    uint64_t spacing = (uint64_t)interval * 1000000 / Sketch::loop_time;
+
+    // Run the whole script, only checking at each checkpoint. The first
+    // checkpoint is the start of the run, before anything has been set up.
+    std::vector<Checkpoint> checkpoints(1);
+    replay.save(checkpoints.back());
+
+    const char *failure = NULL;
+    bool running = true;
+    while (running && !failure) {
+        running = replay.run_to(checkpoints.back().loops + spacing);
+
+        checkpoints.push_back(Checkpoint());
+        replay.save(checkpoints.back());
+        failure = broken();
+    }
+
+    uint64_t loops = replay.get_loops();
+    printf("replay: %llu loops, %zu checkpoints of %zu + %zu bytes\n",
+           (unsigned long long)loops, checkpoints.size(),
+           checkpoints.back().sketch.size(), checkpoints.back().board.size());
+
+    if (check_restore) {
+        if (!verify(replay, checkpoints)) {
+            return 1;
+        }
+        printf("replay: every checkpoint reached again from the one before\n");
+    }
+
+    if (!failure) {
+        if (fault) {
+            fprintf(stderr, "replay: the fault injected at loop %llu wasn't found\n", (unsigned long long)fault);
+            return 1;
+        }
+
+        printf("replay: every invariant held\n");
+        return 0;
+    }
+
+    // The invariants held at the checkpoint before, so the loop() that broke
+    // one is somewhere after it. Restart from there and bisect.
+    Checkpoint &good = checkpoints[checkpoints.size() - 2];
+    uint64_t held   = good.loops;
+    uint64_t failed = checkpoints.back().loops;
+    unsigned restarts = 0;
+
+    while (failed - held > 1) {
+        uint64_t middle = held + (failed - held) / 2;
+
+        if (!replay.restore(good)) {
+            fprintf(stderr, "replay: couldn't restart from the checkpoint at loop %llu\n", (unsigned long long)held);
+            return 1;
+        }
+        replay.run_to(middle);
+        ++restarts;
+
+        if (broken()) {
+            failed = middle;
+        } else {
+            held = middle;
+        }
+    }
+
+    // Leave the sketch just after the loop() that broke it, and say why
+    replay.restore(good);
+    replay.run_to(failed);
+    failure = broken();
+
+    uint64_t culprit = failed - 1;
+    printf("replay: \"%s\" broke in loop %llu, %.3f s into the run, found in %u restarts\n",
+           failure, (unsigned long long)culprit,
+           (double)culprit * Sketch::loop_time / 1000000, restarts);
+    printf("replay: state %d, set time %lu ms\n", (int)fsm.get_state(), (unsigned long)total_time);
+
+    if (fault) {
+        if (culprit != fault) {
+            fprintf(stderr, "replay: the fault was injected in loop %llu\n", (unsigned long long)fault);
+            return 1;
+        }
+        return 0;
+    }
+
+    return 1;
+}
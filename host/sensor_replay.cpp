@@ -0,0 +1,462 @@
+/** @file
+ *  A host tool that plays captured sensor signals through the cycle sensors,
+ *  one ADC sample at a time on the simulated clock, and checks when the
+ *  sensor decides the machine has started running and when it decides the
+ *  cycle has finished. A capture is a text file:
+ *  
+ *      # comments start with a hash
+ *      sensor current              # the sensor to play it through
+ *      rate 9615                   # samples per second
+ *      expect started 2000 2250    # when it must start, in ms from the start
+ *      expect finished 272000 272250
+ *      512 514 517 ...             # samples, as many to a line as needed
+ *      repeat 60                   # repeat the last line for 60 s from its start
+ *  
+ *  so a long quiet or steady stretch of a real recording can be shortened to
+ *  one mains cycle and a repeat, and a raw dump of ADC readings can be used
+ *  as it is.
+ *
+ *  Vibration captures must be at the rate the Timer0 compare interrupt
+ *  samples at, 97.65625 per second. They are played through the interrupt
+ *  itself, one Timer0 tick at a time, and each tick is charged what that
+ *  path through the interrupt costs on the device, so the interrupt's cost
+ *  can be checked against its share of the tick.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <avr/io.h>
+#include "Host.h"
+#include "CurrentSensor.h"
+#include "VibrationSensor.h"
+
+//! The VibrationSensor's sampling interrupt, an ordinary function here
+extern "C" void TIMER0_COMPA_vect(void);
+
+static const uint16_t timer0_tick      = 1024; //!< Timer0 overflows every 1024 us, at 16 MHz with /64
+static const uint8_t  ticks_per_sample = 10;   //!< The vibration sensor samples on every tenth tick
+static const uint8_t  ticks_per_loop   = 4;    //!< loop()s taking the scheduler's whole 4 ms tick budget
+
+// What each path through the sampling interrupt costs on an ATmega328P at
+// 16 MHz, in cycles, estimated from the instructions it needs. Each path
+// includes getting in and out of the interrupt, and saving and restoring
+// the registers the inlined add_sample() uses, which avr-gcc does on every
+// path.
+static const uint16_t isr_cycles_divide = 70;  //!< Counting ticks to the next sample
+static const uint16_t isr_cycles_sample = 115; //!< Storing a sample and starting the next conversion
+static const uint16_t isr_cycles_drop   = 105; //!< Dropping a sample as the ring buffer is full
+
+// The interrupt fires halfway between millis() overflows and holds the
+// others off while it runs, so it is given a sixteenth of the tick
+static const uint16_t isr_budget = timer0_tick / 16;
+
+/** When something must happen in a capture, if the capture says.
+ */
+struct Expect {
+    bool given;   //!< Whether the capture gave a time
+    millis_t min; //!< The earliest it may happen, in milliseconds from the start
+    millis_t max; //!< The latest it may happen
+
+    Expect() : given(false), min(0), max(0) { /* fnord */ }
+};
+
+
+/** A capture being played through a sensor, as it is read.
+ */
+class SensorReplay
+{
+public:
+    SensorReplay() :
+        current(A0), vibration(A0), sensor(NULL), rate(0), samples(0), block_start(0), peak(0),
+        ticks(0), isr_cycles(0), isr_worst(0),
+        started(false), finished(false), started_at(0), finished_at(0)
+        { /* fnord */ }
+
+
+    /** Act on one line of the capture.
+     *
+     * @param text  The line, without the line ending.
+     * @param error Set to what is wrong with the line, if anything.
+     * @return `true` if the line was used, `false` if it is wrong.
+     */
+    bool line(const char *text, std::string &error)
+    {
+        char command[16];
+        int used = 0;
+
+        if (text[strspn(text, " \t")] == '\0' || text[strspn(text, " \t")] == '#') {
+            return true;
+        }
+
+        if (sscanf(text, " %15[a-z] %n", command, &used) != 1) {
+            return samples_line(text, error);
+        }
+
+        const char *args = text + used;
+        if (!strcmp(command, "sensor")) {
+            if (sensor) {
+                error = "the sensor has already been given";
+                return false;
+            }
+            if (!strncmp(args, "current", 7)) {
+                sensor = &current;
+            } else if (!strncmp(args, "vibration", 9)) {
+                vibration.setup();
+                sensor = &vibration;
+            } else {
+                error = "unknown sensor";
+                return false;
+            }
+            Host::set_time(0);
+            sensor -> reset();
+            return true;
+
+        } else if (!strcmp(command, "rate")) {
+            rate = strtod(args, NULL);
+            if (rate <= 0) {
+                error = "the rate must be above zero";
+                return false;
+            }
+            return true;
+
+        } else if (!strcmp(command, "expect")) {
+            char what[16];
+            unsigned long min, max;
+            if (sscanf(args, "%15s %lu %lu", what, &min, &max) != 3 || min > max) {
+                error = "expect needs started or finished, then the earliest and latest times";
+                return false;
+            }
+
+            if (strcmp(what, "started") && strcmp(what, "finished")) {
+                error = "only started and finished can be expected";
+                return false;
+            }
+
+            Expect &expect = strcmp(what, "started") ? expect_finished : expect_started;
+            expect.given = true;
+            expect.min   = min;
+            expect.max   = max;
+            return true;
+
+        } else if (!strcmp(command, "repeat")) {
+            double seconds = strtod(args, NULL);
+            if (block.empty()) {
+                error = "there are no samples to repeat";
+                return false;
+            }
+
+            // Keep going from where the line of samples left off
+            uint64_t end = block_start + (uint64_t)(seconds * rate);
+            for (size_t index = 0; samples < end; index = (index + 1) % block.size()) {
+                feed(block[index]);
+            }
+            return true;
+        }
+
+        error = "unknown command";
+        return false;
+    }
+
+
+    /** Check what the sensor made of the capture, and report it.
+     *
+     * @param name The name of the capture.
+     * @return `true` if it did what the capture expects, `false` if not.
+     */
+    bool check(const char *name)
+    {
+        bool good = true;
+
+        printf("sensor_replay: %s: %llu samples, %.1f s, started ", name,
+               (unsigned long long)samples, rate ? (double)samples / rate : 0.0);
+        if (started) {
+            printf("at %lu ms", (unsigned long)started_at);
+        } else {
+            printf("never");
+        }
+        printf(", finished ");
+        if (finished) {
+            printf("at %lu ms", (unsigned long)finished_at);
+        } else {
+            printf("never");
+        }
+        if (sensor == &current) {
+            printf(", peak RMS %u\n", peak);
+        } else {
+            printf(", %u samples dropped\n", vibration.dropped_samples());
+        }
+
+        if (sensor == &vibration) {
+            printf("sensor_replay: %s: sampling interrupt takes %.1f us at most, %.1f us on average, of each %u us Timer0 tick, budget %u us\n",
+                   name, isr_worst / 16.0, ticks ? isr_cycles / 16.0 / ticks : 0.0, timer0_tick, isr_budget);
+
+            if (isr_worst / 16.0 > isr_budget) {
+                printf("sensor_replay: the sampling interrupt is over budget\n");
+                good = false;
+            }
+            if (vibration.dropped_samples()) {
+                printf("sensor_replay: update() didn't keep up with the sampling interrupt\n");
+                good = false;
+            }
+        }
+
+        good &= check_time("started", expect_started, started, started_at);
+        good &= check_time("finished", expect_finished, finished, finished_at);
+
+        return good;
+    }
+
+private:
+    /** Check that the sensor and rate have been given before any samples.
+     *
+     * @param error Set to what is missing, if anything.
+     * @return `true` if samples can be played, `false` if not.
+     */
+    bool ready(std::string &error)
+    {
+        if (!sensor) {
+            error = "samples come before the sensor is given";
+        } else if (!rate) {
+            error = "samples come before the rate is given";
+        } else if (sensor == &vibration && fabs(rate - 1000000.0 / timer0_tick / ticks_per_sample) > 0.001) {
+            error = "the vibration sensor samples at 97.65625 per second";
+        }
+
+        return error.empty();
+    }
+
+
+    /** Play a line of samples, and keep it in case it is to be repeated.
+     *
+     * @param text  The line of samples.
+     * @param error Set to what is wrong with the line, if anything.
+     * @return `true` if the line was used, `false` if it is wrong.
+     */
+    bool samples_line(const char *text, std::string &error)
+    {
+        if (!ready(error)) {
+            return false;
+        }
+
+        block.clear();
+        block_start = samples;
+
+        char *end;
+        for (unsigned long value = strtoul(text, &end, 10); end != text; value = strtoul(text, &end, 10)) {
+            if (value > 1023) {
+                error = "samples must be from 0 to 1023";
+                return false;
+            }
+            block.push_back(value);
+            feed(value);
+            text = end;
+        }
+
+        if (text[strspn(text, " \t")] != '\0') {
+            error = "only numbers can be given as samples";
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /** Play one sample through the sensor, at the time it was taken.
+     *
+     * @param sample The ADC reading.
+     */
+    void feed(uint16_t sample)
+    {
+        if (sensor == &current) {
+            feed_current(sample);
+        } else {
+            feed_vibration(sample);
+        }
+        ++samples;
+
+        if (!started && sensor -> cycle_started()) {
+            started    = true;
+            started_at = millis();
+        }
+        if (!finished && sensor -> cycle_finished()) {
+            finished    = true;
+            finished_at = millis();
+        }
+    }
+
+
+    /** Play one sample through the current sensor. The main loop runs far
+     *  more often than the sensor needs updating, so update() is called
+     *  after every sample.
+     *
+     * @param sample The ADC reading.
+     */
+    void feed_current(uint16_t sample)
+    {
+        Host::set_time((uint64_t)(samples * 1000000 / rate));
+
+        current.add_sample(sample);
+        current.update();
+
+        if (current.rms() > peak) {
+            peak = current.rms();
+        }
+    }
+
+
+    /** Play one sample through the vibration sensor's interrupt, over the
+     *  Timer0 ticks until it is taken, and charge each tick the path it
+     *  took. update() is called as often as the slowest loop()s the
+     *  scheduler allows would call it.
+     *
+     * @param sample The ADC reading.
+     */
+    void feed_vibration(uint16_t sample)
+    {
+        ADC = sample;
+
+        for (uint8_t tick = 0; tick < ticks_per_sample; ++tick) {
+            Host::set_time((uint64_t)++ticks * timer0_tick);
+
+            // A conversion takes 104 us, so it has always finished by the
+            // next tick; the interrupt only starts one when it takes a sample
+            ADCSRA &= ~_BV(ADSC);
+            uint16_t dropped = vibration.dropped_samples();
+
+            TIMER0_COMPA_vect();
+
+            uint16_t cycles = isr_cycles_divide;
+            if (ADCSRA & _BV(ADSC)) {
+                cycles = (vibration.dropped_samples() != dropped) ? isr_cycles_drop : isr_cycles_sample;
+            }
+            isr_cycles += cycles;
+            if (cycles > isr_worst) {
+                isr_worst = cycles;
+            }
+
+            if (ticks % ticks_per_loop == 0) {
+                vibration.update();
+            }
+        }
+    }
+
+
+    /** Check when something happened against when the capture expects it.
+     *
+     * @param what   What happened, for the report.
+     * @param expect When the capture expects it to happen.
+     * @param seen   Whether it happened.
+     * @param at     When it happened, in milliseconds from the start.
+     * @return `true` if it happened as expected, `false` if not.
+     */
+    static bool check_time(const char *what, const Expect &expect, bool seen, millis_t at)
+    {
+        if (!expect.given || (seen && at >= expect.min && at <= expect.max)) {
+            return true;
+        }
+
+        printf("sensor_replay: %s should be between %lu and %lu ms\n", what,
+               (unsigned long)expect.min, (unsigned long)expect.max);
+        return false;
+    }
+
+    CurrentSensor current;        //!< A current sensor, set up as the sketch sets it up
+    VibrationSensor vibration;    //!< A vibration sensor, with its default thresholds
+    CycleSensor *sensor;          //!< The sensor the capture is played through
+    double rate;                  //!< Samples per second
+    uint64_t samples;             //!< How many samples have been played
+    std::vector<uint16_t> block;  //!< The last line of samples, for repeat
+    uint64_t block_start;         //!< The sample that line started at
+    uint16_t peak;                //!< The highest RMS seen
+    uint64_t ticks;               //!< How many Timer0 ticks have been played
+    uint64_t isr_cycles;          //!< The cycles the sampling interrupt has taken in all
+    uint16_t isr_worst;           //!< The most it took in any one tick
+
+    Expect expect_started;        //!< When the capture expects the cycle to start
+    Expect expect_finished;       //!< When it expects the cycle to finish
+    bool started;                 //!< Whether the sensor has seen the cycle start
+    bool finished;                //!< Whether it has seen the cycle finish
+    millis_t started_at;          //!< When it saw the cycle start
+    millis_t finished_at;         //!< When it saw it finish
+};
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s capture...\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    for (int arg = 1; arg < argc; ++arg) {
+        FILE *in = fopen(argv[arg], "r");
+        if (!in) {
+            perror(argv[arg]);
+            return 1;
+        }
+
+        SensorReplay replay;
+        std::string error;
+        std::string text;
+        unsigned number = 0;
+        char chunk[1024];
+
+        // Lines of samples can be long, so read them in chunks
+        while (error.empty() && fgets(chunk, sizeof(chunk), in)) {
+            text += chunk;
+            if (text.back() != '\n' && !feof(in)) {
+                continue;
+            }
+
+            ++number;
+            text.resize(strcspn(text.c_str(), "\r\n"));
+            if (!replay.line(text.c_str(), error)) {
+                fprintf(stderr, "%s: line %u: %s\n", argv[arg], number, error.c_str());
+                ++failures;
+            }
+            text.clear();
+        }
+        fclose(in);
+
+        if (error.empty() && !replay.check(argv[arg])) {
+            ++failures;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/** @file
+ *  A host tool that soaks the whole sketch across millis() wraparound. The
+ *  sketch is left idle for months of simulated time, a second of it per
+ *  loop(), and near each wrap a copy of it is forked to use the switch with
+ *  the wrap falling at a different point each time. Every copy must trace
+ *  exactly the same states, events and levels at the same times relative to
+ *  its first press as a copy run well away from any wrap.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Host.h"
+#include "Sketch.h"
+
+static const uint64_t wrap_time       = 4294967296ULL * 1000; //!< The time between millis() wraps, in microseconds
+static const uint64_t day             = 86400000000ULL;       //!< A day, in microseconds
+static const uint64_t reference_start = 20 * day;             //!< When the reference copy starts, well clear of any wrap
+static const uint32_t idle_step       = 1000000;              //!< How long each loop() is taken to run for while idle, in microseconds
+static const uint32_t quiet_step      = 50000;                //!< How long each loop() is taken to run for while the timer runs, in microseconds
+static const millis_t give_up         = 24UL * 3600 * 1000;   //!< The longest the timer is waited for, in milliseconds
+
+/** A trace record sent by the sketch, with its time relative to the start
+ *  of the run.
+ */
+struct Record {
+    uint32_t time;   //!< The time since the first press, in milliseconds
+    int      kind;   //!< The Trace::Kind, or -1 for a count of dropped records
+    uint32_t value;  //!< The value recorded, or the number dropped
+};
+
+static std::vector<Record> reference; //!< What the reference copy traced
+
+
+/** Take the trace records the sketch has sent.
+ *
+ * @param start   The time the run started, in millis.
+ * @param records The records to add to.
+ * @return `true` if every line sent was a trace record.
+ */
+static bool take_records(uint32_t start, std::vector<Record> &records)
+{
+    bool good = true;
+    std::string line;
+
+    while (Host::serial_line(line)) {
+        Record record;
+        unsigned long time, kind, value;
+
+        if (sscanf(line.c_str(), "XD%lu", &value) == 1) {
+            record.time  = 0;
+            record.kind  = -1;
+            record.value = value;
+        } else if (sscanf(line.c_str(), "X%lu %lu %lu", &time, &kind, &value) == 3) {
+            record.time  = (uint32_t)(time - start);
+            record.kind  = kind;
+            record.value = value;
+        } else {
+            printf("soak: unexpected line \"%s\"\n", line.c_str());
+            good = false;
+            continue;
+        }
+
+        records.push_back(record);
+    }
+
+    return good;
+}
+
+
+/** Run the sketch for a while, with loop()s as long as they can be without
+ *  changing what it does. While the timer is running there's nothing to
+ *  react to until near its end, so the loop()s are longer then.
+ *
+ * @param time          How long to run for, in milliseconds.
+ * @param timer_started When the timer started, in microseconds.
+ * @param until_waiting Stop early if the machine reaches the wait state?
+ * @return `true` if the time passed, `false` if the machine reached the wait
+ *         state first.
+ */
+static bool run(millis_t time, uint64_t timer_started = 0, bool until_waiting = false)
+{
+    uint64_t end = Host::now() + (uint64_t)time * 1000;
+
+    while (Host::now() < end) {
+        if (until_waiting && fsm.get_state() == State::STATE_WAIT) {
+            return false;
+        }
+
+        uint64_t timed = Host::now() - timer_started;
+        bool quiet = fsm.get_state() == State::STATE_TIMER && timed + 10000000 < (uint64_t)total_time * 1000;
+
+        Sketch::step(quiet ? quiet_step : Sketch::loop_time);
+    }
+
+    return true;
+}
+
+
+/** Press the switch and let it go again.
+ *
+ * @param time How long to hold it for, in milliseconds.
+ */
+static void press(millis_t time)
+{
+    Sketch::set_switch(true);
+    run(time);
+    Sketch::set_switch(false);
+}
+
+
+/** Use the switch as someone doing the laundry would: wake the unit, set a
+ *  program, let the timer run out, and turn the unit off with a long press
+ *  once it has finished.
+ *
+ * @param records Set to what the sketch traced.
+ * @return `true` if the run went as expected.
+ */
+static bool use(std::vector<Record> &records)
+{
+    uint32_t start = Host::now() / 1000;
+
+    press(120);
+    run(2380);
+    press(120);
+    run(580);
+    press(120);
+
+    // Wait for the program to start, then for it to finish
+    for (millis_t waited = 0; waited < 10000 && fsm.get_state() != State::STATE_TIMER; ++waited) {
+        run(1);
+    }
+    run(give_up, Host::now(), true);
+
+    run(5000);
+    press(4000);
+    run(5000);
+
+    bool good = take_records(start, records);
+    if (fsm.get_state() != State::STATE_OFF) {
+        printf("soak: the unit ended in state %d, not off\n", fsm.get_state());
+        good = false;
+    }
+
+    return good;
+}
+
+
+/** Describe a record, for failure messages.
+ */
+static std::string describe(const Record &record)
+{
+    char text[64];
+
+    if (record.kind < 0) {
+        snprintf(text, sizeof(text), "%u dropped", record.value);
+    } else {
+        snprintf(text, sizeof(text), "kind %d value %u at +%u ms", record.kind, record.value, record.time);
+    }
+
+    return text;
+}
+
+
+/** Use the switch, and check the sketch does exactly what it did in the
+ *  reference run.
+ *
+ * @param wrap   Which wrap this run is near, for failure messages.
+ * @param offset How far into the run the wrap falls, in milliseconds.
+ * @return `true` if the run matched the reference run.
+ */
+static bool check(unsigned wrap, millis_t offset)
+{
+    std::vector<Record> records;
+    bool good = use(records);
+
+    size_t length = std::max(records.size(), reference.size());
+    for (size_t index = 0; index < length; ++index) {
+        bool have = index < records.size();
+        bool want = index < reference.size();
+
+        if (have && want && !memcmp(&records[index], &reference[index], sizeof(Record))) {
+            continue;
+        }
+
+        printf("soak: wrap %u at +%u ms: record %u is %s, expected %s\n", wrap, offset, (unsigned)index,
+               have ? describe(records[index]).c_str() : "missing",
+               want ? describe(reference[index]).c_str() : "nothing");
+        return false;
+    }
+
+    return good;
+}
+
+
+/** Run the sketch while it's idle, and make sure it stays that way.
+ *
+ * @param until The time to run until, in microseconds.
+ * @return `true` if it stayed idle.
+ */
+static bool idle(uint64_t until)
+{
+    bool good = true;
+
+    while (Host::now() + idle_step <= until) {
+        Sketch::step(idle_step);
+    }
+    Host::advance(until - Host::now());
+
+    std::vector<Record> records;
+    if (!take_records(0, records) || !records.empty() || fsm.get_state() != State::STATE_OFF) {
+        printf("soak: the unit did something while idle, at %llu ms\n", (unsigned long long)(Host::now() / 1000));
+        good = false;
+    }
+
+    return good;
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-w wraps] [-j jobs] [-q]\n"
+                    "  -w wraps  How many millis() wraps to soak across; defaults to 3\n"
+                    "  -j jobs   How many copies to run at once; defaults to one per core\n"
+                    "  -q        Only put the wrap on each transition, not either side of it\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned wraps = 3;
+    long     jobs  = sysconf(_SC_NPROCESSORS_ONLN);
+    bool     quick = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "w:j:q")) != -1) {
+        switch (option) {
+            case 'w': wraps = atoi(optarg); break;
+            case 'j': jobs  = atol(optarg); break;
+            case 'q': quick = true;         break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (!wraps || jobs < 1) {
+        usage(argv[0]);
+    }
+
+    int failures = 0;
+
+    // Turning tracing on records the bar's level. After that, the idle
+    // sketch should send nothing.
+    Sketch::start();
+    Host::serial_input("X1\n");
+    Sketch::run(1000);
+
+    std::vector<Record> start_records;
+    take_records(0, start_records);
+    if (!idle(reference_start)) {
+        ++failures;
+    }
+
+    // The reference run is made in a copy, so the idle sketch it started
+    // from is still there to copy for the runs near the wraps
+    int ends[2];
+    if (pipe(ends)) {
+        perror("pipe");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (!pid) {
+        std::vector<Record> records;
+        bool good = use(records);
+
+        uint32_t count = records.size();
+        if (write(ends[1], &count, sizeof(count)) != sizeof(count) ||
+            (count && write(ends[1], &records[0], count * sizeof(Record)) != (ssize_t)(count * sizeof(Record)))) {
+            _exit(1);
+        }
+        fflush(stdout);
+        _exit(good ? 0 : 1);
+    }
+    close(ends[1]);
+
+    uint32_t count = 0;
+    if (read(ends[0], &count, sizeof(count)) == sizeof(count)) {
+        reference.resize(count);
+        if (count && read(ends[0], &reference[0], count * sizeof(Record)) != (ssize_t)(count * sizeof(Record))) {
+            reference.clear();
+        }
+    }
+    close(ends[0]);
+
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) || reference.empty()) {
+        printf("soak: the reference run failed\n");
+        return 1;
+    }
+
+    // Put each wrap on every state change and switch event in turn, and
+    // just either side of it, and part way through the timer
+    std::vector<millis_t> offsets;
+    for (size_t index = 0; index < reference.size(); ++index) {
+        const Record &record = reference[index];
+        if (record.kind == Trace::TRACE_STATE || record.kind == Trace::TRACE_EVENT) {
+            offsets.push_back(record.time);
+            if (!quick) {
+                offsets.push_back(record.time - 1);
+                offsets.push_back(record.time + 1);
+            }
+        }
+    }
+    offsets.push_back(reference.back().time / 2);
+    std::sort(offsets.begin(), offsets.end(), std::greater<millis_t>());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    unsigned runs = 0;
+    long running = 0;
+    for (unsigned wrap = 1; wrap <= wraps; ++wrap) {
+        for (size_t index = 0; index < offsets.size(); ++index) {
+            if (!idle(wrap * wrap_time - (uint64_t)offsets[index] * 1000)) {
+                ++failures;
+            }
+
+            if (running == jobs) {
+                if (wait(&status) > 0 && (!WIFEXITED(status) || WEXITSTATUS(status))) {
+                    ++failures;
+                }
+                --running;
+            }
+
+            fflush(stdout);
+            pid = fork();
+            if (!pid) {
+                bool good = check(wrap, offsets[index]);
+                fflush(stdout);
+                _exit(good ? 0 : 1);
+            } else if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+            ++running;
+            ++runs;
+        }
+    }
+
+    // The idle sketch goes on past the last wrap
+    if (!idle(wraps * wrap_time + day)) {
+        ++failures;
+    }
+
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            ++failures;
+        }
+    }
+
+    printf("soak: %u wraps, %u runs of %u records, %.1f days simulated\n",
+           wraps, runs, (unsigned)reference.size(), Host::now() / (double)day);
+
+    if (failures) {
+        printf("soak: %d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
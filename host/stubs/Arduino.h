@@ -0,0 +1,145 @@
+/** @file
+ *  A minimal stand-in for the Arduino core, used by the host build. This
+ *  declares just the parts of the Arduino API the sketch uses; they are
+ *  implemented against a simulated clock and pins in HostArduino.cpp.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef Arduino_H
+#define Arduino_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+#define _BV(bit) (1 << (bit))
+
+#define noInterrupts()
+#define interrupts()
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+// The pin to port mapping of the ATmega328P: pins 0-7 are port D, 8-13 are
+// port B, and A0-A5 are port C.
+#define digitalPinToPort(pin)    ((pin) < 8 ? 4 : (pin) < 14 ? 2 : 3)
+#define digitalPinToBitMask(pin) (1 << ((pin) < 8 ? (pin) : (pin) < 14 ? (pin) - 8 : (pin) - 14))
+#define portInputRegister(port)  (&host_pin_registers[port])
+#define portOutputRegister(port) (&host_port_registers[port])
+
+#if defined(__AVR__)
+// Only needed to syntax check the AVR code paths
+#include <avr/io.h>
+#define digitalPinToPCICR(pin)    (&PCICR)
+#define digitalPinToPCICRbit(pin) ((pin) < 8 ? 2 : (pin) < 14 ? 0 : 1)
+#define digitalPinToPCMSK(pin)    ((pin) < 8 ? &PCMSK2 : (pin) < 14 ? &PCMSK0 : &PCMSK1)
+#define digitalPinToPCMSKbit(pin) ((pin) < 8 ? (pin) : (pin) < 14 ? (pin) - 8 : (pin) - 14)
+#endif
+
+extern volatile uint8_t host_pin_registers[5];
+extern volatile uint8_t host_port_registers[5];
+
+// unsigned long is 32 bits on AVR, so these return a 32 bit type here too,
+// so that arithmetic on them wraps where it does on the device
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int  digitalRead(uint8_t pin);
+int  analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+/** The serial port. Output goes into a buffer that drains at the baud rate
+ *  set with begin(), so a write to a full buffer waits, as it does on the
+ *  device, by moving the simulated clock on.
+ */
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int availableForWrite();
+    size_t write(uint8_t value);
+
+    size_t print(const char *text);
+    size_t print(char value);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+
+    size_t println();
+    template <class T> size_t println(T value) {
+        size_t sent = print(value);
+        return sent + println();
+    }
+    template <class T> size_t println(T value, int base) {
+        size_t sent = print(value, base);
+        return sent + println();
+    }
+
+    operator bool() {
+        return true;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,65 @@
+/** @file
+ *  A stand-in for the Arduino EEPROM library, used by the host build. The
+ *  EEPROM contents are kept in memory by HostArduino.cpp.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value);
+    uint16_t length();
+
+    template <class T> T &get(int address, T &value) {
+        uint8_t *bytes = (uint8_t *)&value;
+        for (size_t index = 0; index < sizeof(T); ++index) {
+            bytes[index] = read(address + index);
+        }
+        return value;
+    }
+
+    template <class T> const T &put(int address, const T &value) {
+        const uint8_t *bytes = (const uint8_t *)&value;
+        for (size_t index = 0; index < sizeof(T); ++index) {
+            update(address + index, bytes[index]);
+        }
+        return value;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,81 @@
+/** @file
+ *  A stand-in for the (modified) Grove_LED_Bar library, used by the host
+ *  build. It sends each frame on the clock and data pins as the library
+ *  does, so that the bar's driver chip can be modelled, and remembers what
+ *  was last drawn, so host tools can see what the bar is showing.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef Grove_LED_Bar_H
+#define Grove_LED_Bar_H
+
+#include <Arduino.h>
+
+enum LedType {
+    LED_BAR_10      = 0,
+    LED_CIRCULAR_24 = 1
+};
+
+class Grove_LED_Bar
+{
+public:
+    Grove_LED_Bar(unsigned char clock_pin, unsigned char data_pin, bool green_to_red, LedType type);
+
+    void begin();
+    void setLevel(float level);
+    void setLeds(uint8_t *leds);
+
+    static const uint8_t max_leds = 24; //!< The most LEDs any supported bar has
+
+    uint8_t count;          //!< The number of LEDs on the bar
+    bool begun;             //!< Has begin() been called?
+    uint32_t frames;        //!< How many times the bar has been drawn
+    uint8_t leds[max_leds]; //!< The brightness of each LED, as last drawn
+
+private:
+    /** Send the LED brightnesses to the bar, a frame per driver chip.
+     */
+    void show();
+
+    /** Send a 16 bit word to the driver chip, most significant bit first.
+     *
+     * @param data The word to send.
+     */
+    void send(uint16_t data);
+
+    /** Latch the words sent since the last latch into the driver chip.
+     */
+    void latch();
+
+    uint8_t clock_pin;      //!< The pin the bar's clock input is connected to
+    uint8_t data_pin;       //!< The pin the bar's data input is connected to
+    bool green_to_red;      //!< Is the first LED at the far end of the bar?
+};
+
+#endif
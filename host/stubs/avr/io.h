@@ -0,0 +1,61 @@
+/** @file
+ *  A stand-in for avr-libc's register definitions, only used to syntax check
+ *  the AVR code paths of the sketch with the host compiler. Only the
+ *  registers and bits the sketch uses are declared.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#ifndef avr_io_H
+#define avr_io_H
+
+#include <stdint.h>
+
+#define HOST_REGISTER8(name)  extern volatile uint8_t name;
+#define HOST_REGISTER16(name) extern volatile uint16_t name;
+
+HOST_REGISTER8(ADCSRA) HOST_REGISTER8(ADCSRB) HOST_REGISTER8(ADMUX) HOST_REGISTER8(DIDR0)
+HOST_REGISTER16(ADC)   HOST_REGISTER8(ADCL)   HOST_REGISTER8(ADCH)
+HOST_REGISTER8(TCCR0A) HOST_REGISTER8(TCCR0B) HOST_REGISTER8(TIMSK0) HOST_REGISTER8(OCR0A) HOST_REGISTER8(OCR0B) HOST_REGISTER8(TCNT0)
+HOST_REGISTER8(TCCR1A) HOST_REGISTER8(TCCR1B) HOST_REGISTER8(TIMSK1) HOST_REGISTER16(OCR1A) HOST_REGISTER16(OCR1B) HOST_REGISTER16(TCNT1)
+HOST_REGISTER8(TCCR2A) HOST_REGISTER8(TCCR2B) HOST_REGISTER8(TIMSK2) HOST_REGISTER8(OCR2A) HOST_REGISTER8(OCR2B) HOST_REGISTER8(TCNT2)
+HOST_REGISTER8(EECR)   HOST_REGISTER16(EEAR)  HOST_REGISTER8(EEDR)
+HOST_REGISTER8(MCUSR)  HOST_REGISTER8(SREG)
+HOST_REGISTER8(PCICR)  HOST_REGISTER8(PCMSK0) HOST_REGISTER8(PCMSK1) HOST_REGISTER8(PCMSK2)
+
+enum {
+    ADEN = 7, ADSC = 6, ADATE = 5, ADIF = 4, ADIE = 3, ADPS2 = 2, ADPS1 = 1, ADPS0 = 0,
+    REFS1 = 7, REFS0 = 6, ADLAR = 5,
+    OCIE0B = 2, OCIE0A = 1,
+    COM1A1 = 7, COM1A0 = 6, WGM12 = 3, CS12 = 2, CS11 = 1, CS10 = 0, OCIE1A = 1,
+    COM2B1 = 5, COM2B0 = 4, WGM21 = 1, WGM20 = 0, CS22 = 2, CS21 = 1, CS20 = 0, TOIE2 = 0,
+    EERIE = 3, EEMPE = 2, EEPE = 1, EERE = 0,
+    WDRF = 3, BORF = 2, EXTRF = 1, PORF = 0
+};
+
+#endif
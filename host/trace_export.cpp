@@ -0,0 +1,298 @@
+/** @file
+ *  A host tool that turns the sketch's trace into a Chrome trace event JSON
+ *  file, for viewing in Perfetto or chrome://tracing. The trace comes from
+ *  running the whole sketch through a script of inputs, or from the serial
+ *  output of a real unit captured with tracing on (X1). States become spans,
+ *  switch events become instant events, and the bar and switch levels
+ *  become counter tracks.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "Host.h"
+#include "Sketch.h"
+#include "Script.h"
+
+static const int state_track = 1; //!< The track the state spans go on
+static const int event_track = 2; //!< The track the switch events go on
+
+
+/** A converter from the console's trace lines to Chrome trace events. The
+ *  events are written as they are converted, through a large output
+ *  buffer, so even very long traces are quick to write.
+ */
+class ChromeTrace
+{
+public:
+    ChromeTrace(FILE *out) : out(out), first(true), started(false), last_raw(0), time(0), state(-1), records(0), dropped(0)
+    {
+        setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+        event("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"laundry\"}}");
+        track(state_track, "state");
+        track(event_track, "switch events");
+    }
+
+    /** Convert a line from the console. Lines that aren't trace records
+     *  are ignored.
+     *
+     * @param line The line, without its line ending.
+     */
+    void line(const std::string &line)
+    {
+        unsigned long raw, kind, value;
+        char text[160];
+
+        if (sscanf(line.c_str(), "XD%lu", &value) == 1) {
+            dropped += value;
+            snprintf(text, sizeof(text), "{\"name\":\"%lu records dropped\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                     value, (unsigned long long)time, event_track);
+            event(text);
+            return;
+        }
+
+        if (sscanf(line.c_str(), "X%lu %lu %lu", &raw, &kind, &value) != 3) {
+            return;
+        }
+
+        // The times are 32-bit millis, so they wrap every 49.7 days
+        if (started) {
+            time += (uint64_t)(uint32_t)(raw - last_raw) * 1000;
+        } else {
+            time = (uint64_t)raw * 1000;
+            started = true;
+        }
+        last_raw = raw;
+        ++records;
+
+        switch (kind) {
+            case Trace::TRACE_STATE:
+                if (state >= 0) {
+                    snprintf(text, sizeof(text), "{\"ph\":\"E\",\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                             (unsigned long long)time, state_track);
+                    event(text);
+                }
+                state = value;
+                snprintf(text, sizeof(text), "{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                         Sketch::state_name(value), (unsigned long long)time, state_track);
+                break;
+
+            case Trace::TRACE_EVENT:
+                snprintf(text, sizeof(text), "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                         Sketch::event_name(value), (unsigned long long)time, event_track);
+                break;
+
+            case Trace::TRACE_SWITCH:
+                snprintf(text, sizeof(text), "{\"name\":\"switch\",\"ph\":\"C\",\"ts\":%llu,\"pid\":1,\"args\":{\"pressed\":%lu}}",
+                         (unsigned long long)time, value);
+                break;
+
+            case Trace::TRACE_LEVEL:
+                snprintf(text, sizeof(text), "{\"name\":\"bar level\",\"ph\":\"C\",\"ts\":%llu,\"pid\":1,\"args\":{\"segments\":%lu.%lu}}",
+                         (unsigned long long)time, value / 10, value % 10);
+                break;
+
+            default:
+                return;
+        }
+
+        event(text);
+    }
+
+    /** End the trace, closing the current state's span.
+     *
+     * @param end The time the run ended, in millis, or 0 to end it at the
+     *            last record.
+     */
+    void finish(uint32_t end)
+    {
+        if (state >= 0) {
+            uint64_t close = time;
+            if (end && started) {
+                close += (uint64_t)(uint32_t)(end - last_raw) * 1000;
+            }
+
+            char text[80];
+            snprintf(text, sizeof(text), "{\"ph\":\"E\",\"ts\":%llu,\"pid\":1,\"tid\":%d}", (unsigned long long)close, state_track);
+            event(text);
+        }
+
+        fputs("]}\n", out);
+        fflush(out);
+    }
+
+    /** Obtain how many trace records have been converted.
+     */
+    uint32_t get_records() { return records; }
+
+    /** Obtain how many trace records the sketch had to drop.
+     */
+    uint32_t get_dropped() { return dropped; }
+
+private:
+    /** Write an event to the output.
+     */
+    void event(const char *text)
+    {
+        if (!first) {
+            fputc(',', out);
+        }
+        fputs("\n", out);
+        fputs(text, out);
+        first = false;
+    }
+
+    /** Write a track's name to the output.
+     */
+    void track(int tid, const char *name)
+    {
+        char text[96];
+        snprintf(text, sizeof(text), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, name);
+        event(text);
+    }
+
+    FILE *out;          //!< Where the events are written
+    bool first;         //!< Is the next event the first?
+    bool started;       //!< Has a record been seen yet?
+    uint32_t last_raw;  //!< The millis of the last record
+    uint64_t time;      //!< The time of the last record, unwrapped, in microseconds
+    long state;         //!< The current state, or -1 before the first state record
+    uint32_t records;   //!< How many records have been converted
+    uint32_t dropped;   //!< How many records the sketch dropped
+};
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s script | -c capture] [-o output]\n"
+                    "  -s script   Run the sketch with the inputs in the script; the default\n"
+                    "              sets a three bar program and lets it run out\n"
+                    "  -c capture  Convert the serial output of a unit instead, - for stdin\n"
+                    "  -o output   Where to write the JSON; defaults to stdout\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *script_name  = NULL;
+    const char *capture_name = NULL;
+    const char *output_name  = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:c:o:")) != -1) {
+        switch (option) {
+            case 's': script_name  = optarg; break;
+            case 'c': capture_name = optarg; break;
+            case 'o': output_name  = optarg; break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (optind != argc || (script_name && capture_name)) {
+        usage(argv[0]);
+    }
+
+    FILE *out = output_name ? fopen(output_name, "w") : stdout;
+    if (!out) {
+        perror(output_name);
+        return 1;
+    }
+
+    ChromeTrace chrome(out);
+
+    if (capture_name) {
+        FILE *in = strcmp(capture_name, "-") ? fopen(capture_name, "r") : stdin;
+        if (!in) {
+            perror(capture_name);
+            return 1;
+        }
+
+        char text[256];
+        while (fgets(text, sizeof(text), in)) {
+            text[strcspn(text, "\r\n")] = '\0';
+            chrome.line(text);
+        }
+        chrome.finish(0);
+
+    } else {
+        Script script;
+        if (script_name) {
+            FILE *in = fopen(script_name, "r");
+            std::string error;
+
+            if (!in) {
+                perror(script_name);
+                return 1;
+            }
+            if (!script.load(in, error)) {
+                fprintf(stderr, "%s: %s\n", script_name, error.c_str());
+                return 1;
+            }
+            fclose(in);
+        } else {
+            script.add_standard_run();
+        }
+
+        // Tracing is turned on before the script starts
+        Sketch::start();
+        Host::serial_input("X1\n");
+        Sketch::run(100);
+
+        uint64_t start = Host::now();
+        size_t next = 0;
+        std::string line;
+        for (uint32_t loops = 0; script.play(next, (Host::now() - start) / 1000); ++loops) {
+            Sketch::step();
+
+            // Take the lines every so often, so they don't pile up
+            if (loops % 1024 == 0) {
+                while (Host::serial_line(line)) {
+                    chrome.line(line);
+                }
+            }
+        }
+
+        while (Host::serial_line(line)) {
+            chrome.line(line);
+        }
+        chrome.finish(Host::now() / 1000);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "trace_export: %u records, %u dropped\n", chrome.get_records(), chrome.get_dropped());
+
+    return chrome.get_records() ? 0 : 1;
+}
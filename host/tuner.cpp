@@ -0,0 +1,619 @@
+/** @file
+ *  A host tool that searches for the best interaction timings. Every
+ *  candidate set of switch and program state timings is tried against a
+ *  library of models of how people press the button, running the real
+ *  SwitchControl and state machine code on the simulated clock, and the
+ *  candidates that best trade how long programming takes against how often
+ *  the wrong program is set are reported.
+ *
+ * @author Chris Page &lt;chris@starforge.co.uk&gt;
+ * @copyright MIT License, 2020 Chris Page
+ */
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Chris Page
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+#include "Host.h"
+#include "Clock.h"
+#include "FSM.h"
+
+static const uint8_t  switch_pin = 2;
+static const uint8_t  led_pin    = 3;
+static const uint32_t bar_time   = 1800;   //!< The seconds each bar is worth, as in the sketch
+static const millis_t give_up    = 30000;  //!< How long to wait for the timer to start before giving up on a trial
+
+/** A set of interaction timings to try, in milliseconds.
+ */
+struct Config {
+    millis_t debounce;   //!< SwitchControl debounce_time
+    millis_t longpress;  //!< SwitchControl longpress_time
+    millis_t hold;       //!< ProgramState hold_time
+    millis_t timeout;    //!< ProgramState timeout
+};
+
+//! The timings the sketch uses at the moment, as set in laundry.ino
+static const Config sketch_config = { 50, 3000, 2000, 4500 };
+
+/** A model of how someone uses the button. All times are in milliseconds,
+ *  and each is picked at random between its minimum and maximum every
+ *  time it is needed.
+ */
+struct PressModel {
+    const char *name;      //!< A name for the model, for reports
+    millis_t press_min;    //!< The shortest time a tap holds the switch down
+    millis_t press_max;    //!< The longest time a tap holds the switch down
+    millis_t gap_min;      //!< The shortest time between taps
+    millis_t gap_max;      //!< The longest time between taps
+    millis_t bounce;       //!< How long the contacts bounce for on each change, 0 for a clean switch
+    uint8_t  pause_chance; //!< The percent chance of stopping to think before each tap
+    millis_t pause_min;    //!< The shortest time spent thinking
+    millis_t pause_max;    //!< The longest time spent thinking
+    millis_t reaction;     //!< How long it takes to react to what the bar shows
+    bool     holds;        //!< Does this person hold the switch to count up, rather than tapping?
+    uint8_t  check_chance; //!< The percent chance of checking the bar, and correcting it, once done
+};
+
+//! The people the timings have to suit
+static const PressModel models[] = {
+    // name            press      gap     bounce pause  thinking   react  holds  check
+    { "steady",       100, 200,  200,  400,   0,   0,    0,    0,   500, false,  50 },
+    { "quick",         40,  90,   80,  180,   0,   0,    0,    0,   350, false,  50 },
+    { "deliberate",   200, 380,  400,  800,   0,   0,    0,    0,   600, false,  80 },
+    { "hesitant",     100, 250,  250,  500,   0,  25, 1500, 6000,   700, false,  50 },
+    { "worn switch",  100, 200,  200,  400,  40,   0,    0,    0,   500, false,  50 },
+    { "holder",       100, 200,  200,  400,   0,   0,    0,    0,   300, true,   90 },
+};
+static const uint8_t model_count = sizeof(models) / sizeof(models[0]);
+
+/** How a set of timings did.
+ */
+struct Result {
+    Config   config;                  //!< The timings tried
+    uint64_t time;                    //!< The total time all the trials took, in milliseconds
+    uint32_t trials;                  //!< How many trials there were
+    uint32_t failures;                //!< How many trials ended with the wrong program set, or not turning off
+    uint32_t model_failures[model_count]; //!< The failures for each model
+
+    /** Obtain the mean time a trial took.
+     *
+     * @return The mean time, in seconds.
+     */
+    double mean_time() const { return trials ? time / 1000.0 / trials : 0; }
+
+    /** Obtain the proportion of trials that failed.
+     *
+     * @return The failure rate, from 0 to 1.
+     */
+    double failure_rate() const { return trials ? (double)failures / trials : 0; }
+};
+
+
+/** A simple, repeatable, random number generator. Every set of timings is
+ *  tried with the same sequence of presses, so differences between them
+ *  come from the timings alone.
+ */
+class Random
+{
+public:
+    Random(uint32_t seed) : state(seed ? seed : 1) { /* fnord */ }
+
+    /** Obtain a number between two limits, inclusive.
+     */
+    uint32_t range(uint32_t low, uint32_t high)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return low + state % (high - low + 1);
+    }
+
+    /** Decide whether something with the given percent chance happens.
+     */
+    bool chance(uint8_t percent)
+    {
+        return range(0, 99) < percent;
+    }
+
+private:
+    uint32_t state;
+};
+
+
+/** A display that remembers what the states drew on it, which is all the
+ *  person pressing the button has to go on.
+ */
+class WatchedDisplay : public BarDisplay
+{
+public:
+    WatchedDisplay() : level(0), lit(0) { /* fnord */ }
+
+    void setLevel(float value)
+    {
+        level = (uint8_t)(value < 0 ? 0 : value);
+        if (level) {
+            lit = level;
+        }
+    }
+
+    void setLeds(uint8_t *leds)
+    {
+        uint8_t count = 0;
+        for (uint8_t led = 0; led < segments; ++led) {
+            if (leds[led]) {
+                ++count;
+            }
+        }
+        setLevel(count);
+    }
+
+    uint8_t level;  //!< The level shown now
+    uint8_t lit;    //!< The last level shown with any segments lit, which is what someone reads off a flashing bar
+};
+
+
+/** One go at setting a program, or turning the timer off, by one model of
+ *  a person, with one set of timings. The person is a script that presses
+ *  and releases the switch while the simulated clock runs on underneath,
+ *  updating the switch and the state machine every millisecond as the
+ *  sketch does.
+ */
+class Trial
+{
+public:
+    Trial(const Config &config, const PressModel &model, uint32_t seed) :
+        model(model), random(seed),
+        button(switch_pin, led_pin, config.debounce, config.longpress),
+        state_off(button, display), state_startup(button, display),
+        state_program(button, display, &total_time, NULL, NULL, NULL, bar_time, config.hold, config.timeout),
+        state_timer(button, display, &total_time),
+        state_wait(button, display),
+        total_time(0), contact(LOW)
+    {
+        Host::reset();
+        Clock::setup(0);
+
+        button.setup();
+        fsm.add_state(&state_off);
+        fsm.add_state(&state_startup);
+        fsm.add_state(&state_program);
+        fsm.add_state(&state_timer);
+        fsm.add_state(&state_wait);
+
+        // The self-test is only shown after a power cycle, not every time
+        state_startup.set_self_test(false);
+    }
+
+    /** Try to set a program, starting with the machine off.
+     *
+     * @param target The number of bars the person wants.
+     * @param time   Set to how long it took, from the first press until the
+     *               timer started or the person gave up, in milliseconds.
+     * @return `true` if the timer started with the right program.
+     */
+    bool program(uint8_t target, millis_t &time)
+    {
+        fsm.set_state(State::STATE_OFF);
+        wait(100);
+
+        uint64_t start = Host::now();
+
+        // Wake it up, then either hold the switch until the bar gets there,
+        // or tap it up one bar at a time
+        tap();
+        if (model.holds && target > 1) {
+            set_switch(HIGH);
+            wait_until([&]() { return display.lit == target || fsm.get_state() != State::STATE_PROGRAM; }, give_up);
+            wait(model.reaction);
+            set_switch(LOW);
+            wait(gap());
+        } else {
+            for (uint8_t bars = 1; bars < target && fsm.get_state() == State::STATE_PROGRAM; ++bars) {
+                if (random.chance(model.pause_chance)) {
+                    think();
+                }
+                tap();
+            }
+        }
+
+        // Some people look to see if it's right, and fix it if not
+        if (random.chance(model.check_chance)) {
+            for (uint8_t fixes = 0; fixes < 2 * BarDisplay::segments && fsm.get_state() == State::STATE_PROGRAM && display.lit != target; ++fixes) {
+                tap();
+            }
+        }
+
+        wait_until([&]() { return fsm.get_state() != State::STATE_PROGRAM; }, give_up);
+        time = (Host::now() - start) / 1000;
+
+        return fsm.get_state() == State::STATE_TIMER && total_time == (millis_t)target * bar_time * 1000;
+    }
+
+    /** Try to turn the timer off, by holding the switch until it goes off.
+     *
+     * @param time Set to how long the switch was held, in milliseconds.
+     * @return `true` if the timer turned off.
+     */
+    bool cancel(millis_t &time)
+    {
+        total_time = (millis_t)BarDisplay::segments * bar_time * 1000;
+        fsm.set_state(State::STATE_TIMER);
+        wait(1000);
+
+        uint64_t start = Host::now();
+
+        set_switch(HIGH);
+        wait_until([&]() { return fsm.get_state() == State::STATE_OFF; }, give_up);
+        time = (Host::now() - start) / 1000;
+        wait(model.reaction);
+        set_switch(LOW);
+        wait(gap());
+
+        return fsm.get_state() == State::STATE_OFF;
+    }
+
+private:
+    /** Run the sketch for one millisecond.
+     */
+    void tick()
+    {
+        Host::advance(1000);
+
+        uint64_t now = Host::now();
+        while (!changes.empty() && changes.front().first <= now) {
+            Host::set_input(switch_pin, changes.front().second);
+            changes.erase(changes.begin());
+        }
+
+        fsm.update(button.update());
+    }
+
+    /** Run the sketch for a while.
+     *
+     * @param time How long to run it for, in milliseconds.
+     */
+    void wait(millis_t time)
+    {
+        for (millis_t elapsed = 0; elapsed < time; ++elapsed) {
+            tick();
+        }
+    }
+
+    /** Run the sketch until something happens, or a limit is reached.
+     *
+     * @param done  A function that returns `true` once it has happened.
+     * @param limit The most time to wait, in milliseconds.
+     * @return `true` if it happened, `false` if the limit was reached.
+     */
+    template<typename Done> bool wait_until(Done done, millis_t limit)
+    {
+        for (millis_t elapsed = 0; elapsed < limit; ++elapsed) {
+            if (done()) {
+                return true;
+            }
+            tick();
+        }
+
+        return done();
+    }
+
+    /** Press or release the switch. A worn switch's contacts bounce for a
+     *  while before settling at the new level.
+     *
+     * @param level HIGH to press the switch, LOW to release it.
+     */
+    void set_switch(uint8_t level)
+    {
+        if (level == contact) {
+            return;
+        }
+        contact = level;
+
+        uint64_t now = Host::now();
+        changes.push_back(std::make_pair(now, level));
+
+        if (model.bounce) {
+            std::vector<uint64_t> times;
+            uint32_t bounces = random.range(0, model.bounce / 10) * 2;
+            for (uint32_t bounce = 0; bounce < bounces; ++bounce) {
+                times.push_back(now + random.range(1, model.bounce) * 1000);
+            }
+            std::sort(times.begin(), times.end());
+
+            for (uint32_t bounce = 0; bounce < bounces; ++bounce) {
+                changes.push_back(std::make_pair(times[bounce], (bounce % 2) ? level : !level));
+            }
+        }
+    }
+
+    /** Press and release the switch once, and wait before the next tap.
+     */
+    void tap()
+    {
+        set_switch(HIGH);
+        wait(random.range(model.press_min, model.press_max));
+        set_switch(LOW);
+        wait(gap());
+    }
+
+    /** Stop to think. Someone who sees the bar start flashing to say the
+     *  timer is about to start carries on, once they have reacted to it.
+     */
+    void think()
+    {
+        millis_t pause = random.range(model.pause_min, model.pause_max);
+
+        if (wait_until([&]() { return fsm.get_state() == State::STATE_PROGRAM && display.level == 0; }, pause)) {
+            wait(model.reaction);
+        }
+    }
+
+    /** Pick a time to wait between taps.
+     */
+    millis_t gap()
+    {
+        return random.range(model.gap_min, model.gap_max);
+    }
+
+    const PressModel &model;
+    Random random;
+
+    WatchedDisplay display;
+    SwitchControl  button;
+    OffState       state_off;
+    StartupState   state_startup;
+    ProgramState   state_program;
+    TimerState     state_timer;
+    WaitState      state_wait;
+    Machine        fsm;
+    millis_t       total_time;
+
+    uint8_t contact;                                     //!< The level the person is holding the switch at
+    std::vector<std::pair<uint64_t, uint8_t> > changes;  //!< Pending changes to the switch pin, with bounce
+};
+
+
+/** Try a set of timings with every model of a person, setting every program
+ *  several times and turning the timer off a few times.
+ *
+ * @param config      The timings to try.
+ * @param repeats     How many times to try each program with each model.
+ * @return How the timings did.
+ */
+static Result evaluate(const Config &config, uint8_t repeats)
+{
+    Result result;
+    memset(&result, 0, sizeof(result));
+    result.config = config;
+
+    for (uint8_t index = 0; index < model_count; ++index) {
+        for (uint8_t repeat = 0; repeat < repeats; ++repeat) {
+            for (uint8_t target = 0; target <= BarDisplay::segments; ++target) {
+                uint32_t seed = ((index * 256u + repeat) * 256u + target) * 2654435761u;
+                Trial trial(config, models[index], seed);
+                millis_t time;
+
+                // Target 0 stands for turning the timer off
+                bool good = target ? trial.program(target, time) : trial.cancel(time);
+
+                result.time += time;
+                ++result.trials;
+                if (!good) {
+                    ++result.failures;
+                    ++result.model_failures[index];
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+/** Check whether one result is at least as good as another on both counts,
+ *  and better on at least one.
+ */
+static bool dominates(const Result &a, const Result &b)
+{
+    return a.time <= b.time && a.failures <= b.failures && (a.time < b.time || a.failures < b.failures);
+}
+
+
+/** Obtain the cost of a result, for picking the best configuration.
+ *
+ * @param result The result to cost.
+ * @param weight How many seconds of programming time one failure is worth.
+ * @return The cost, in seconds per trial.
+ */
+static double cost(const Result &result, double weight)
+{
+    return result.mean_time() + weight * result.failure_rate();
+}
+
+
+static void print_result(const char *label, const Result &result, double weight)
+{
+    printf("%-8s %8u %9u %6u %7u %9.2f %10.2f%% %8.2f\n", label,
+           result.config.debounce, result.config.longpress, result.config.hold, result.config.timeout,
+           result.mean_time(), 100.0 * result.failure_rate(), cost(result, weight));
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-j jobs] [-r repeats] [-w weight] [-q]\n"
+                    "  -j jobs     Worker processes to use; defaults to one per core\n"
+                    "  -r repeats  How many times each model sets each program; defaults to 3\n"
+                    "  -w weight   How many seconds of programming one failure is worth; defaults to 60\n"
+                    "  -q          Search a small grid, to check the tool works\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    long    jobs    = sysconf(_SC_NPROCESSORS_ONLN);
+    uint8_t repeats = 3;
+    double  weight  = 60;
+    bool    quick   = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "j:r:w:q")) != -1) {
+        switch (option) {
+            case 'j': jobs    = atol(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'w': weight  = atof(optarg); break;
+            case 'q': quick   = true;         break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (jobs < 1 || repeats < 1) {
+        usage(argv[0]);
+    }
+
+    // The candidates. The sketch's own timings are always among them.
+    static const millis_t debounces[]  = { 10, 20, 30, 50, 80 };
+    static const millis_t longpresses[] = { 1500, 2000, 3000, 4000 };
+    static const millis_t holds[]      = { 1000, 1500, 2000, 3000 };
+    static const millis_t timeouts[]   = { 2500, 3500, 4500, 6000 };
+
+    std::vector<Config> configs;
+    configs.push_back(sketch_config);
+    if (!quick) {
+        for (size_t debounce = 0; debounce < sizeof(debounces) / sizeof(debounces[0]); ++debounce) {
+            for (size_t longpress = 0; longpress < sizeof(longpresses) / sizeof(longpresses[0]); ++longpress) {
+                for (size_t hold = 0; hold < sizeof(holds) / sizeof(holds[0]); ++hold) {
+                    for (size_t timeout = 0; timeout < sizeof(timeouts) / sizeof(timeouts[0]); ++timeout) {
+                        Config config = { debounces[debounce], longpresses[longpress], holds[hold], timeouts[timeout] };
+                        if (config.hold < config.timeout && memcmp(&config, &sketch_config, sizeof(config))) {
+                            configs.push_back(config);
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        Config quicker = { 20, 2000, 1500, 3500 };
+        configs.push_back(quicker);
+    }
+
+    // Each worker tries every jobs'th candidate, and sends its results back
+    // down a pipe, so all the cores are kept busy.
+    if ((size_t)jobs > configs.size()) {
+        jobs = configs.size();
+    }
+
+    std::vector<int> pipes;
+    for (long job = 0; job < jobs; ++job) {
+        int ends[2];
+        if (pipe(ends)) {
+            perror("pipe");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        if (!pid) {
+            close(ends[0]);
+            for (size_t index = job; index < configs.size(); index += jobs) {
+                Result result = evaluate(configs[index], repeats);
+                if (write(ends[1], &result, sizeof(result)) != sizeof(result)) {
+                    _exit(1);
+                }
+            }
+            _exit(0);
+        }
+
+        close(ends[1]);
+        pipes.push_back(ends[0]);
+    }
+
+    std::vector<Result> results;
+    for (size_t job = 0; job < pipes.size(); ++job) {
+        Result result;
+        while (read(pipes[job], &result, sizeof(result)) == sizeof(result)) {
+            results.push_back(result);
+        }
+        close(pipes[job]);
+    }
+
+    bool workers_ok = true;
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            workers_ok = false;
+        }
+    }
+    if (!workers_ok || results.size() != configs.size()) {
+        fprintf(stderr, "tuner: a worker failed, %u of %u candidates tried\n", (unsigned)results.size(), (unsigned)configs.size());
+        return 1;
+    }
+
+    // The Pareto front is every candidate that nothing beats on both time
+    // and failures; the best is the one on it with the lowest cost.
+    std::vector<Result> front;
+    for (size_t index = 0; index < results.size(); ++index) {
+        bool dominated = false;
+        for (size_t other = 0; other < results.size() && !dominated; ++other) {
+            dominated = dominates(results[other], results[index]);
+        }
+        if (!dominated) {
+            front.push_back(results[index]);
+        }
+    }
+    std::sort(front.begin(), front.end(), [](const Result &a, const Result &b) { return a.time < b.time; });
+
+    const Result *best = &front[0];
+    for (size_t index = 1; index < front.size(); ++index) {
+        if (cost(front[index], weight) < cost(*best, weight)) {
+            best = &front[index];
+        }
+    }
+
+    printf("tuner: %u candidates, %u trials each, %ld workers, a failure costs %.0f s\n",
+           (unsigned)results.size(), results[0].trials, jobs, weight);
+    printf("         debounce longpress   hold timeout  time (s)    failures     cost\n");
+    for (size_t index = 0; index < front.size(); ++index) {
+        print_result("front", front[index], weight);
+    }
+    print_result("best", *best, weight);
+    print_result("sketch", results[0], weight);
+
+    printf("\nFailures by model, best against sketch:\n");
+    for (uint8_t index = 0; index < model_count; ++index) {
+        printf("  %-12s %4u %4u\n", models[index].name, best -> model_failures[index], results[0].model_failures[index]);
+    }
+
+    return 0;
+}
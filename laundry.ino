@@ -28,36 +28,237 @@
  * THE SOFTWARE.
  */
 
+#include "Profile.h"
+
+// The LED bar is drawn through the Grove library by default. Define this to
+// drive it with the built-in MY9221Display instead, which needs much less
+// flash, RAM and time, for parts that can't fit the library. The tiny
+// profile (see Profile.h) always uses it.
+// #define USE_MY9221_DISPLAY
+
+#if defined(USE_MY9221_DISPLAY)
+#include "MY9221Display.h"
+#else
 #include <Grove_LED_Bar.h>
+#include "GroveBarDisplay.h"
+#endif
+#include "LedEffects.h"
 #include "SwitchControl.h"
+#include "Clock.h"
+#include "Console.h"
+#include "HealthLog.h"
+#include "BarDisplay.h"
+#include "CurrentSensor.h"
+#include "CyclePredictor.h"
+#include "ProgramHistory.h"
+#include "EepromWriter.h"
+#include "RotaryEncoder.h"
+#include "Buzzer.h"
 #include "FSM.h"
+#include "Scheduler.h"
+#include "Trace.h"
 
 // Configuration values for the peripherals
 const int switch_pin = 2;
 const int led_pin    = 3;
 const int clock_pin  = 7;
 const int data_pin   = 8;
+const int sensor_pin = A0;
+const int encoder_a_pin = 4;
+const int encoder_b_pin = 5;
+const int buzzer_pin = 9;
+
+// Interaction timings, in milliseconds. These trade how quickly a program
+// can be set against how easily the wrong one is set by accident.
+const millis_t debounce_time   = 50;
+const millis_t longpress_time  = 3000;
+const millis_t hold_time       = 2000;
+const millis_t program_timeout = 4500;
+
+// How much time each bar of a program adds, in seconds
+const unsigned int bar_time = 1800;
+
+// Where persistent data is stored in EEPROM
+const int predictor_eeprom = 0;
+const int history_eeprom   = predictor_eeprom + sizeof(CyclePredictor::Stats) + EepromWriter::overhead;
+const int clock_eeprom     = history_eeprom + sizeof(ProgramHistory::History) + EepromWriter::overhead;
+const int health_eeprom    = clock_eeprom + sizeof(Clock::Calibration) + EepromWriter::overhead;
 
 // A variable to store the time the bar should fill over
-unsigned long total_time = 0;
+millis_t total_time = 0;
+
+// A marker in memory that isn't cleared on reset, so that it only fails to
+// match boot_magic after a power cycle, when the RAM contents are random.
+#if defined(__AVR__)
+uint16_t boot_marker __attribute__ ((section (".noinit")));
+#else
+uint16_t boot_marker;
+#endif
+const uint16_t boot_magic = 0x1aad;
+
+// How long, in millis since reset, setup took to get the switch working
+millis_t boot_time = 0;
 
 // The switch and led bar peripherals have objects to control them
-SwitchControl control_switch(switch_pin, led_pin);
+#if defined(USE_TINY_PROFILE)
+SwitchControl control_switch(switch_pin, led_pin, debounce_time, longpress_time, 400, 300, 400);
+#else
+LedEffects led_effects(led_pin);
+SwitchControl control_switch(switch_pin, led_pin, debounce_time, longpress_time, 400, 300, 400, &led_effects);
+#endif
+// The bar type must have BarDisplay::segments segments
+#if defined(USE_MY9221_DISPLAY)
+MY9221Display bar_display(clock_pin, data_pin, true);
+#else
 Grove_LED_Bar bar(clock_pin, data_pin, true, LED_BAR_10);
+GroveBarDisplay bar_display(bar);
+#endif
+
+#if defined(USE_TINY_PROFILE)
+// The tiny profile has no trace, so the states draw on the bar directly
+MY9221Display &display = bar_display;
+#else
+// A timeline of state changes, switch events and bar levels, for debugging
+Trace trace;
+TraceDisplay display(bar_display, trace);
+
+// The current transformer lets the timer finish when the machine really does.
+// A VibrationSensor on the same pin can be used instead, but not both, as
+// they each need the ADC to themselves. Neither is part of the standard
+// circuit, and a floating input can look like a running machine, so the
+// sensor is only used once one is fitted: point cycle_sensor at it then.
+CurrentSensor current_sensor(sensor_pin);
+CycleSensor *cycle_sensor = NULL;
+
+// Learn how long programs really take, and which the user normally picks
+CyclePredictor predictor(predictor_eeprom);
+
+// The encoder is a quicker alternative to pressing the button to program
+RotaryEncoder encoder(encoder_a_pin, encoder_b_pin);
+
+// Tell the user when the cycle has finished
+Buzzer buzzer(buzzer_pin);
+
+// Remember recent programs, so the last one can be restarted with a double press
+ProgramHistory history(history_eeprom);
+
+// Keep track of the switch's health over its whole life
+HealthLog health_log(control_switch, health_eeprom);
+#endif
 
 // Create the state objects the FSM will use, and the FSM itself
-OffState     state_off    (control_switch, bar);
-StartupState state_startup(control_switch, bar);
-ProgramState state_program(control_switch, bar, &total_time);
-TimerState   state_timer  (control_switch, bar, &total_time);
-WaitState    state_wait   (control_switch, bar);
+OffState     state_off    (control_switch, display);
+StartupState state_startup(control_switch, display);
+#if defined(USE_TINY_PROFILE)
+ProgramState state_program(control_switch, display, &total_time, NULL, NULL, NULL, bar_time, hold_time, program_timeout);
+TimerState   state_timer  (control_switch, display, &total_time);
+WaitState    state_wait   (control_switch, display);
 Machine fsm;
+#else
+ProgramState state_program(control_switch, display, &total_time, &predictor, &history, &encoder, bar_time, hold_time, program_timeout);
+TimerState   state_timer  (control_switch, display, &total_time, cycle_sensor, &predictor);
+WaitState    state_wait   (control_switch, display, &buzzer);
+Machine fsm(&trace);
+
+// The main loop work is split into tasks, so that background work can't
+// hold up responding to the switch
+Scheduler scheduler;
+
+// Commands from a host, used to calibrate the clock and read telemetry
+Console console(control_switch, fsm, 9600, &scheduler, &trace, &boot_time);
+#endif
+
+// The most recent event from the switch, passed from the input task to the FSM
+SwitchControl::Event switch_event = SwitchControl::EVENT_NONE;
+
+// The scheduler's tasks. All the work of updating the bar is done in the FSM,
+// based on events generated by the control switch.
+void input_task() {
+    switch_event = control_switch.update();
+
+#if !defined(USE_TINY_PROFILE)
+    // Switch events are instants in the trace, and the level is a counter
+    if (switch_event != SwitchControl::EVENT_NONE) {
+        trace.record(Trace::TRACE_EVENT, switch_event);
+    }
+    if (switch_event == SwitchControl::EVENT_PRESSED || switch_event == SwitchControl::EVENT_DOUBLEPRESS) {
+        trace.record(Trace::TRACE_SWITCH, 1);
+    } else if (switch_event == SwitchControl::EVENT_RELEASED) {
+        trace.record(Trace::TRACE_SWITCH, 0);
+    }
+#endif
+}
+
+#if !defined(USE_TINY_PROFILE)
+void console_task() { console.update(); }
+void health_task()  { health_log.update(); }
+#endif
+
+// The FSM is started on its first tick, rather than in setup(), as going into
+// the off state draws on the bar, and the bar isn't set up until then.
+void fsm_task() {
+    if (fsm.get_state() == State::StateID::STATE_NONE) {
+        fsm.set_state(State::StateID::STATE_OFF);
+    }
+
+    fsm.update(switch_event);
+}
+
+#if !defined(USE_TINY_PROFILE)
+/** Save or restore the runtime context of the sketch, so that a replay can
+ *  be restarted from a checkpoint. The Clock goes first, as everything else
+ *  keeps its times in its terms. Use Snapshot::save() and restore() with
+ *  this, so that a snapshot that doesn't match is never half restored.
+ *
+ * @param snapshot The snapshot to save the context to or restore it from.
+ */
+void snapshot(Snapshot &snapshot) {
+    Clock::snapshot(snapshot);
+    control_switch.snapshot(snapshot);
+    led_effects.snapshot(snapshot);
+    trace.snapshot(snapshot);
+    display.snapshot(snapshot);
+    current_sensor.snapshot(snapshot);
+    if (cycle_sensor && cycle_sensor != &current_sensor) {
+        cycle_sensor -> snapshot(snapshot);
+    }
+    predictor.snapshot(snapshot);
+    encoder.snapshot(snapshot);
+    buzzer.snapshot(snapshot);
+    history.snapshot(snapshot);
+    health_log.snapshot(snapshot);
+    fsm.snapshot(snapshot);
+    scheduler.snapshot(snapshot);
+    console.snapshot(snapshot);
+    EepromWriter::snapshot(snapshot);
+    snapshot.field(total_time);
+    snapshot.field(boot_time);
+    snapshot.field(switch_event);
+}
+#endif
 
 void setup() {
+    // Only show the startup self-test after a power cycle
+    bool cold_boot = (boot_marker != boot_magic);
+    boot_marker = boot_magic;
 
-    // Ensure the switch and bar are in a sane initial state
+    // The clock needs to be calibrated before anything starts timing
+    Clock::setup(clock_eeprom);
+
+    // Ensure the switch is in a sane initial state. The bar is set up when
+    // it is first drawn on, so setup doesn't wait for it.
     control_switch.setup();
-    bar.begin();
+#if !defined(USE_TINY_PROFILE)
+    if (cycle_sensor) {
+        cycle_sensor -> setup();
+    }
+    predictor.setup();
+    history.setup();
+    encoder.setup();
+    buzzer.setup();
+    health_log.setup();
+    console.setup();
+#endif
 
     // Add the possible states to the FSM.
     fsm.add_state(&state_off);
@@ -65,12 +266,27 @@ void setup() {
     fsm.add_state(&state_program);
     fsm.add_state(&state_timer);
     fsm.add_state(&state_wait);
-    fsm.set_state(State::StateID::STATE_OFF);
+    state_startup.set_self_test(cold_boot);
+
+#if !defined(USE_TINY_PROFILE)
+    // Input and the FSM run every tick, everything else fits around them.
+    // An FSM tick can send a whole bar frame, which takes about 2.4ms
+    // through the Grove library, as it drives the pins with digitalWrite().
+    scheduler.add_task(input_task, Scheduler::PRIORITY_HIGH, 500);
+    scheduler.add_task(fsm_task, Scheduler::PRIORITY_HIGH, 3000);
+    scheduler.add_task(console_task, Scheduler::PRIORITY_BACKGROUND, 1000);
+    scheduler.add_task(health_task, Scheduler::PRIORITY_BACKGROUND, 500);
+#endif
+
+    boot_time = millis();
 }
 
 void loop() {
-    // All the work of updating the bar is done in the FSM,
-    // based on events generated by the control switch
-    SwitchControl::Event event = control_switch.update();
-    fsm.update(event);
+#if defined(USE_TINY_PROFILE)
+    // Input and the FSM are all there is, so they just run every tick
+    input_task();
+    fsm_task();
+#else
+    scheduler.run();
+#endif
 }